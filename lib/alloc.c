@@ -0,0 +1,212 @@
+#define _GNU_SOURCE
+#include "zcut.h"
+
+#include <errno.h>
+#include <malloc.h>
+#include <unistd.h>
+
+/*
+ * Heap accounting of the running case. Defining malloc and friends in the test binary interposes them for the
+ * whole process, libc included, and they forward to the glibc allocator. Sizes are the sizes asked for: every block
+ * is allocated a size tag longer, and the tag is kept at the end of the usable block, where free finds it again
+ * without moving the pointer libc knows. The counters are thread local, so every -t thread accounts its own case.
+ * Build with -DZCUT_NO_ALLOC_HOOK to leave the allocator alone, for example under a sanitizer.
+ */
+typedef struct alloc_counter_t
+{
+    uint64_t    alloc_count;
+    uint64_t    free_count;
+    uint64_t    alloc_bytes;
+    int64_t     live_bytes;
+    int64_t     peak_live_bytes;
+}alloc_counter_t;
+
+static __thread alloc_counter_t _alloc_counter_ __attribute__((tls_model("initial-exec")));
+
+#ifndef ZCUT_NO_ALLOC_HOOK
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void  __libc_free(void* ptr);
+
+/* The check tells the tag from whatever ends a block allocated before the hook, or overwritten past its size. */
+typedef struct size_tag_t
+{
+    size_t  size;
+    size_t  check;
+}size_tag_t;
+
+static const size_t SIZE_TAG_MAGIC = (size_t)0x5a43555441474d31ULL;
+
+static size_tag_t* get_size_tag(void* ptr)
+{
+    return (size_tag_t*)((char*)ptr + malloc_usable_size(ptr) - sizeof(size_tag_t));
+}
+
+static bool get_tag_size(size_t size, size_t *tag_size)
+{
+    if (size > SIZE_MAX - sizeof(size_tag_t))
+        return false;
+
+    *tag_size = size + sizeof(size_tag_t);
+    return true;
+}
+
+static void* tag_alloc(void* ptr, size_t size)
+{
+    if (ptr == NULL)
+        return NULL;
+
+    size_tag_t tag = {size, size ^ SIZE_TAG_MAGIC};
+    memcpy(get_size_tag(ptr), &tag, sizeof(tag));
+    return ptr;
+}
+
+static size_t get_alloc_size(void* ptr)
+{
+    size_t usable_size = malloc_usable_size(ptr);
+    if (usable_size < sizeof(size_tag_t))
+        return usable_size;
+
+    size_tag_t tag;
+    memcpy(&tag, get_size_tag(ptr), sizeof(tag));
+    return ((tag.size ^ SIZE_TAG_MAGIC) == tag.check && tag.size <= usable_size - sizeof(tag))
+           ? tag.size : usable_size;
+}
+
+static void count_alloc(size_t size)
+{
+    alloc_counter_t *counter = &_alloc_counter_;
+    counter->alloc_count++;
+    counter->alloc_bytes += size;
+    counter->live_bytes += size;
+    if (counter->live_bytes > counter->peak_live_bytes)
+        counter->peak_live_bytes = counter->live_bytes;
+}
+
+static void count_free(size_t size)
+{
+    alloc_counter_t *counter = &_alloc_counter_;
+    counter->free_count++;
+    counter->live_bytes -= size;
+}
+
+static void* count_tagged_alloc(void* ptr, size_t size)
+{
+    if (ptr != NULL)
+        count_alloc(size);
+    return tag_alloc(ptr, size);
+}
+
+void* malloc(size_t size)
+{
+    size_t tag_size;
+    if (!get_tag_size(size, &tag_size))
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return count_tagged_alloc(__libc_malloc(tag_size), size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    size_t tag_size;
+    if ((size != 0 && count > SIZE_MAX / size) || !get_tag_size(count * size, &tag_size))
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return count_tagged_alloc(__libc_calloc(1, tag_size), count * size);
+}
+
+void free(void* ptr)
+{
+    if (ptr != NULL)
+        count_free(get_alloc_size(ptr));
+    __libc_free(ptr);
+}
+
+/* A moved or resized block counts as a new allocation, which is what a hot path must not do either. */
+void* realloc(void* ptr, size_t size)
+{
+    if (ptr == NULL)
+        return malloc(size);
+    if (size == 0)
+    {
+        free(ptr);
+        return NULL;
+    }
+
+    size_t tag_size;
+    if (!get_tag_size(size, &tag_size))
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    size_t old_size = get_alloc_size(ptr);
+    void* new_ptr = __libc_realloc(ptr, tag_size);
+    if (new_ptr == NULL)
+        return NULL;
+
+    count_free(old_size);
+    return count_tagged_alloc(new_ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    size_t tag_size;
+    if (!get_tag_size(size, &tag_size))
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return count_tagged_alloc(__libc_memalign(alignment, tag_size), size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+    if (alignment == 0 || alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+
+    void* new_ptr = memalign(alignment, size);
+    if (new_ptr == NULL)
+        return ENOMEM;
+
+    *ptr = new_ptr;
+    return 0;
+}
+
+void* valloc(size_t size)
+{
+    return memalign(sysconf(_SC_PAGESIZE), size);
+}
+#endif
+
+void begin_alloc_count(void)
+{
+    memset(&_alloc_counter_, 0, sizeof(_alloc_counter_));
+}
+
+void end_alloc_count(case_result_t *result)
+{
+    alloc_counter_t counter = _alloc_counter_;
+    result->alloc_count = counter.alloc_count;
+    result->alloc_bytes = counter.alloc_bytes;
+    result->peak_alloc_bytes = (counter.peak_live_bytes > 0) ? counter.peak_live_bytes : 0;
+    result->unfreed_alloc_count = (counter.alloc_count > counter.free_count)
+                                  ? counter.alloc_count - counter.free_count : 0;
+    result->unfreed_alloc_bytes = (counter.live_bytes > 0) ? counter.live_bytes : 0;
+}
+
+uint64_t get_alloc_count(void)
+{
+    return _alloc_counter_.alloc_count;
+}
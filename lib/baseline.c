@@ -0,0 +1,384 @@
+#define _GNU_SOURCE
+#include "zcut.h"
+
+#include <math.h>
+#include <unistd.h>
+
+#define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
+
+static const char* BASELINE_MAGIC = "zcut-benchmark";
+static const int BASELINE_VERSION = 1;
+static const double SIGNIFICANCE_LEVEL = 0.05;
+
+char UT_FLAG(benchmark_baseline)[MAX_STR_LEN];
+char UT_FLAG(benchmark_save)[MAX_STR_LEN];
+int  UT_FLAG(benchmark_threshold) = 5;
+
+typedef struct baseline_entry_t
+{
+    char*       name;
+    int         line;
+    uint64_t    iteration_count;
+    int         sample_count;
+    double      *sample_list;
+}baseline_entry_t;
+
+typedef struct baseline_t
+{
+    baseline_entry_t    *entry_list;
+    int                 entry_count;
+    int                 capacity;
+}baseline_t;
+
+static baseline_t _baseline_;
+
+static int compare_baseline_entry_name(const void* a, const void* b)
+{
+    return strcmp(((const baseline_entry_t*)a)->name, ((const baseline_entry_t*)b)->name);
+}
+
+static baseline_entry_t* add_baseline_entry(void)
+{
+    if (_baseline_.entry_count == _baseline_.capacity)
+    {
+        int capacity = (_baseline_.capacity == 0) ? 64 : _baseline_.capacity * 2;
+        baseline_entry_t *list = (baseline_entry_t*)realloc(_baseline_.entry_list,
+                                                            capacity * sizeof(baseline_entry_t));
+        if (list == NULL)
+        {
+            PRINT_INTERNAL_ERROR("realloc(%d): %m", capacity * sizeof(baseline_entry_t));
+            return NULL;
+        }
+        _baseline_.entry_list = list;
+        _baseline_.capacity = capacity;
+    }
+
+    baseline_entry_t *entry = &_baseline_.entry_list[_baseline_.entry_count];
+    memset(entry, 0, sizeof(*entry));
+    return entry;
+}
+
+/* `suite.case iteration_count sample_count sample...', samples in ns/op. */
+static bool parse_baseline_entry(char* line, int line_number)
+{
+    char* save_ptr = NULL;
+    char* name = strtok_r(line, " \t\n", &save_ptr);
+    char* iteration_count = strtok_r(NULL, " \t\n", &save_ptr);
+    char* sample_count = strtok_r(NULL, " \t\n", &save_ptr);
+    if (name == NULL || iteration_count == NULL || sample_count == NULL || atoi(sample_count) <= 0)
+        return true;
+
+    baseline_entry_t *entry = add_baseline_entry();
+    if (entry == NULL)
+        return false;
+
+    int count = atoi(sample_count);
+    entry->name = strdup(name);
+    entry->sample_list = (double*)malloc(count * sizeof(double));
+    if (entry->name == NULL || entry->sample_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("malloc(%d): %m", count * sizeof(double));
+        free(entry->name);
+        free(entry->sample_list);
+        return false;
+    }
+
+    entry->line = line_number;
+    entry->iteration_count = strtoull(iteration_count, NULL, 10);
+    char* sample;
+    while (entry->sample_count < count && (sample = strtok_r(NULL, " \t\n", &save_ptr)) != NULL)
+        entry->sample_list[entry->sample_count++] = strtod(sample, NULL);
+
+    if (entry->sample_count == 0)
+    {
+        free(entry->name);
+        free(entry->sample_list);
+        return true;
+    }
+
+    _baseline_.entry_count++;
+    return true;
+}
+
+bool load_benchmark_baseline(void)
+{
+    FILE *file = fopen(UT_FLAG(benchmark_baseline), "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "fopen(%s, r): %m\n", UT_FLAG(benchmark_baseline));
+        return false;
+    }
+
+    bool ret = true;
+    char magic[64];
+    int version = 0;
+    if (fscanf(file, "%63s %d\n", magic, &version) != 2 || strcmp(magic, BASELINE_MAGIC) != 0
+        || version != BASELINE_VERSION)
+    {
+        fprintf(stderr, "%s: not a zCUT benchmark baseline\n", UT_FLAG(benchmark_baseline));
+        ret = false;
+    }
+
+    char* line = NULL;
+    size_t len = 0;
+    int line_number = 1;
+    while (ret && getline(&line, &len, file) != -1)
+    {
+        line_number++;
+        ret = parse_baseline_entry(line, line_number);
+    }
+    free(line);
+    fclose(file);
+
+    qsort(_baseline_.entry_list, _baseline_.entry_count, sizeof(baseline_entry_t), compare_baseline_entry_name);
+    return ret;
+}
+
+static const baseline_entry_t* find_baseline_entry(const char* name)
+{
+    if (_baseline_.entry_count == 0)
+        return NULL;
+
+    baseline_entry_t key;
+    key.name = (char*)name;
+    return (const baseline_entry_t*)bsearch(&key, _baseline_.entry_list, _baseline_.entry_count,
+                                            sizeof(baseline_entry_t), compare_baseline_entry_name);
+}
+
+static int compare_double(const void* a, const void* b)
+{
+    double value_a = *(const double*)a;
+    double value_b = *(const double*)b;
+    return (value_a > value_b) - (value_a < value_b);
+}
+
+typedef struct ranked_sample_t
+{
+    double  value;
+    bool    is_new;
+}ranked_sample_t;
+
+static int compare_ranked_sample(const void* a, const void* b)
+{
+    double value_a = ((const ranked_sample_t*)a)->value;
+    double value_b = ((const ranked_sample_t*)b)->value;
+    return (value_a > value_b) - (value_a < value_b);
+}
+
+/*
+ * One-sided Mann-Whitney U test of "the new samples are larger than the baseline samples slowed down by the
+ * threshold", with the normal approximation and tie correction. Unlike a percentage on the means, it is not
+ * fooled by a few outliers of a noisy host. Returns the p-value.
+ */
+static double test_regression(const double *new_list, int new_count, const double *base_list, int base_count,
+                              double scale)
+{
+    int count = new_count + base_count;
+    ranked_sample_t *sample_list = (ranked_sample_t*)malloc(count * sizeof(ranked_sample_t));
+    if (sample_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("malloc(%d): %m", count * sizeof(ranked_sample_t));
+        return 1;
+    }
+
+    int i;
+    for (i = 0; i < new_count; i++)
+    {
+        sample_list[i].value = new_list[i];
+        sample_list[i].is_new = true;
+    }
+    for (i = 0; i < base_count; i++)
+    {
+        sample_list[new_count + i].value = base_list[i] * scale;
+        sample_list[new_count + i].is_new = false;
+    }
+    qsort(sample_list, count, sizeof(ranked_sample_t), compare_ranked_sample);
+
+    double new_rank_sum = 0;
+    double tie_sum = 0;
+    i = 0;
+    while (i < count)
+    {
+        int j = i;
+        while (j < count && sample_list[j].value == sample_list[i].value)
+            j++;
+
+        double rank = (i + 1 + j) / 2.0;
+        int k;
+        for (k = i; k < j; k++)
+        {
+            if (sample_list[k].is_new)
+                new_rank_sum += rank;
+        }
+        double tie_count = j - i;
+        tie_sum += tie_count * tie_count * tie_count - tie_count;
+        i = j;
+    }
+    free(sample_list);
+
+    double u = new_rank_sum - new_count * (new_count + 1) / 2.0;
+    double mean = new_count * (double)base_count / 2;
+    double variance = new_count * (double)base_count / 12 * ((count + 1) - tie_sum / ((double)count * (count - 1)));
+    if (variance <= 0)
+        return (u > mean) ? 0 : 1;
+
+    double z = (u - mean - 0.5) / sqrt(variance);
+    return 0.5 * erfc(z / sqrt(2));
+}
+
+static double get_median(const double *list, int count)
+{
+    double *sorted_list = (double*)malloc(count * sizeof(double));
+    if (sorted_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("malloc(%d): %m", count * sizeof(double));
+        return 0;
+    }
+
+    memcpy(sorted_list, list, count * sizeof(double));
+    qsort(sorted_list, count, sizeof(double), compare_double);
+
+    double median = (count % 2 == 1) ? sorted_list[count / 2]
+                                     : (sorted_list[count / 2 - 1] + sorted_list[count / 2]) / 2;
+    free(sorted_list);
+    return median;
+}
+
+void compare_benchmark_baseline(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    benchmark_result_t *benchmark = test_case->benchmark;
+    case_result_t *result = test_case->result;
+    if (benchmark->sample_count == 0)
+        return;
+
+    char name[MAX_STR_LEN];
+    snprintf(name, sizeof(name), "%s.%s", test_suite->name, test_case->name);
+    const baseline_entry_t *entry = find_baseline_entry(name);
+    if (entry == NULL)
+        return;
+
+    double scale = 1 + UT_FLAG(benchmark_threshold) / 100.0;
+    benchmark->compared = true;
+    benchmark->baseline_median = get_median(entry->sample_list, entry->sample_count);
+    benchmark->p_value = test_regression(benchmark->sample_list, benchmark->sample_count, entry->sample_list,
+                                         entry->sample_count, scale);
+
+    result->assertion_count++;
+    if (benchmark->p_value >= SIGNIFICANCE_LEVEL)
+    {
+        result->succ_assertion_count++;
+        return;
+    }
+
+    char expected[MAX_STR_LEN];
+    char actual[MAX_STR_LEN];
+    snprintf(expected, sizeof(expected), "%s <= baseline %.3f ns/op + %d%%", test_case->name,
+             benchmark->baseline_median, UT_FLAG(benchmark_threshold));
+    snprintf(actual, sizeof(actual), "%s == %.3f ns/op (p = %.4f)", test_case->name, benchmark->median,
+             benchmark->p_value);
+
+    result->fail_assertion_count++;
+    result->passed = false;
+    save_assertion_info(result, UT_FLAG(benchmark_baseline), entry->line, expected, actual, "benchmark regression");
+}
+
+static void write_benchmark_entry(FILE *file, const char* name, uint64_t iteration_count, const double *sample_list,
+                                  int sample_count)
+{
+    fprintf(file, "%s %llu %d", name, (unsigned long long)iteration_count, sample_count);
+    int i;
+    for (i = 0; i < sample_count; i++)
+        fprintf(file, " %.4f", sample_list[i]);
+    fprintf(file, "\n");
+}
+
+static bool is_benchmark_saved(const test_runner_t *test_runner, const char* name)
+{
+    int i;
+    for (i = 0; i < test_runner->suite_count; i++)
+    {
+        const test_suite_t *test_suite = test_runner->suite_list[i];
+        size_t suite_len = strlen(test_suite->name);
+        if (strncmp(name, test_suite->name, suite_len) != 0 || name[suite_len] != '.')
+            continue;
+
+        int j;
+        for (j = 0; j < test_suite->case_count; j++)
+        {
+            const test_case_t *test_case = test_suite->case_list[j];
+            if (test_case->benchmark != NULL && test_case->benchmark->sample_count > 0
+                && strcmp(name + suite_len + 1, test_case->name) == 0)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+/* Benchmarks of the baseline which did not run this time, filtered out or on another shard, are kept. */
+bool save_benchmark_baseline(const test_runner_t *test_runner)
+{
+    if (strlen(UT_FLAG(benchmark_save)) == 0)
+        return true;
+
+    char tmp_path[MAX_STR_LEN + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", UT_FLAG(benchmark_save), (int)getpid());
+    FILE *file = fopen(tmp_path, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "fopen(%s, w): %m\n", tmp_path);
+        return false;
+    }
+
+    fprintf(file, "%s %d\n", BASELINE_MAGIC, BASELINE_VERSION);
+    int i;
+    for (i = 0; i < test_runner->suite_count; i++)
+    {
+        const test_suite_t *test_suite = test_runner->suite_list[i];
+        int j;
+        for (j = 0; j < test_suite->case_count; j++)
+        {
+            const test_case_t *test_case = test_suite->case_list[j];
+            const benchmark_result_t *benchmark = test_case->benchmark;
+            if (benchmark == NULL || benchmark->sample_count == 0)
+                continue;
+
+            char name[MAX_STR_LEN];
+            snprintf(name, sizeof(name), "%s.%s", test_suite->name, test_case->name);
+            write_benchmark_entry(file, name, benchmark->iteration_count, benchmark->sample_list,
+                                  benchmark->sample_count);
+        }
+    }
+
+    for (i = 0; i < _baseline_.entry_count; i++)
+    {
+        const baseline_entry_t *entry = &_baseline_.entry_list[i];
+        if (!is_benchmark_saved(test_runner, entry->name))
+            write_benchmark_entry(file, entry->name, entry->iteration_count, entry->sample_list,
+                                  entry->sample_count);
+    }
+
+    bool ret = (fflush(file) == 0 && fsync(fileno(file)) == 0);
+    if (fclose(file) != 0)
+        ret = false;
+    if (!ret || rename(tmp_path, UT_FLAG(benchmark_save)) == -1)
+    {
+        fprintf(stderr, "write benchmark baseline %s: %m\n", UT_FLAG(benchmark_save));
+        unlink(tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+void free_benchmark_baseline(void)
+{
+    int i;
+    for (i = 0; i < _baseline_.entry_count; i++)
+    {
+        free(_baseline_.entry_list[i].name);
+        free(_baseline_.entry_list[i].sample_list);
+    }
+    free(_baseline_.entry_list);
+    memset(&_baseline_, 0, sizeof(_baseline_));
+}
@@ -0,0 +1,196 @@
+#include "zcut.h"
+
+#include <math.h>
+
+#define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
+
+static const int MIN_SAMPLE_COUNT = 10;
+static const int TARGET_SAMPLE_COUNT = 50;
+static const uint64_t MIN_SAMPLE_TIME = 100000ULL;
+static const uint64_t MAX_ITERATION_COUNT = 1000000000ULL;
+static const uint64_t NSEC_PER_MSEC = 1000000ULL;
+
+int UT_FLAG(benchmark_time) = 500;
+
+/*
+ * State of the benchmark running on this thread. A body which does not use BENCHMARK_LOOP is one operation, and
+ * is called in a loop by the framework instead.
+ */
+typedef struct benchmark_state_t
+{
+    uint64_t    iteration_count;
+    bool        loop_entered;
+    uint64_t    pause_begin;
+    uint64_t    paused_time;
+}benchmark_state_t;
+
+static __thread benchmark_state_t _benchmark_state_;
+
+uint64_t get_benchmark_iteration_count(void)
+{
+    _benchmark_state_.loop_entered = true;
+    return _benchmark_state_.iteration_count;
+}
+
+void pause_benchmark_timing(void)
+{
+    _benchmark_state_.pause_begin = get_monotonic_time();
+}
+
+void resume_benchmark_timing(void)
+{
+    _benchmark_state_.paused_time += get_monotonic_time() - _benchmark_state_.pause_begin;
+}
+
+static uint64_t run_benchmark_batch(const test_case_t *test_case, uint64_t iteration_count)
+{
+    _benchmark_state_.iteration_count = iteration_count;
+    _benchmark_state_.paused_time = 0;
+
+    uint64_t begin = get_monotonic_time();
+    if (_benchmark_state_.loop_entered)
+    {
+        test_case->test(test_case->result);
+    }
+    else
+    {
+        uint64_t i;
+        for (i = 0; i < iteration_count; i++)
+            test_case->test(test_case->result);
+    }
+    uint64_t time = get_monotonic_time() - begin;
+
+    return (time > _benchmark_state_.paused_time) ? time - _benchmark_state_.paused_time : 0;
+}
+
+static bool is_benchmark_failed(const test_case_t *test_case)
+{
+    return test_case->result->fail_assertion_count > 0;
+}
+
+/* Warm-up: grow the iteration count until one batch lasts a sample time. None of these batches is kept. */
+static uint64_t calibrate_iteration_count(const test_case_t *test_case, uint64_t sample_time)
+{
+    uint64_t iteration_count = 1;
+    while (iteration_count < MAX_ITERATION_COUNT && !is_benchmark_failed(test_case))
+    {
+        uint64_t time = run_benchmark_batch(test_case, iteration_count);
+        if (time >= sample_time)
+            break;
+
+        uint64_t next_count = (time == 0) ? iteration_count * 10
+                                          : (uint64_t)(iteration_count * 1.4 * sample_time / time);
+        if (next_count > iteration_count * 10)
+            next_count = iteration_count * 10;
+        if (next_count <= iteration_count)
+            next_count = iteration_count + 1;
+
+        iteration_count = (next_count < MAX_ITERATION_COUNT) ? next_count : MAX_ITERATION_COUNT;
+    }
+
+    return iteration_count;
+}
+
+static int compare_double(const void* a, const void* b)
+{
+    double value_a = *(const double*)a;
+    double value_b = *(const double*)b;
+    return (value_a > value_b) - (value_a < value_b);
+}
+
+static void calc_benchmark_result(benchmark_result_t *result, double *sorted_list)
+{
+    int count = result->sample_count;
+    memcpy(sorted_list, result->sample_list, count * sizeof(double));
+    qsort(sorted_list, count, sizeof(double), compare_double);
+
+    double sum = 0;
+    int i;
+    for (i = 0; i < count; i++)
+        sum += sorted_list[i];
+    result->mean = sum / count;
+
+    double square_sum = 0;
+    for (i = 0; i < count; i++)
+        square_sum += (sorted_list[i] - result->mean) * (sorted_list[i] - result->mean);
+    result->stddev = (count > 1) ? sqrt(square_sum / (count - 1)) : 0;
+
+    result->min = sorted_list[0];
+    result->median = (count % 2 == 1) ? sorted_list[count / 2]
+                                      : (sorted_list[count / 2 - 1] + sorted_list[count / 2]) / 2;
+    result->p99 = sorted_list[(int)ceil(count * 0.99) - 1];
+}
+
+static bool alloc_benchmark_sample_list(benchmark_result_t *result, int capacity)
+{
+    if (result->sample_list != NULL)
+        return true;
+
+    result->sample_list = (double*)malloc(capacity * sizeof(double));
+    if (result->sample_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("malloc(%d): %m", capacity * sizeof(double));
+        return false;
+    }
+
+    return true;
+}
+
+void run_benchmark_case(const test_case_t *test_case)
+{
+    benchmark_result_t *result = test_case->benchmark;
+    double *sample_list = result->sample_list;
+    memset(result, 0, sizeof(*result));
+    result->sample_list = sample_list;
+    memset(&_benchmark_state_, 0, sizeof(_benchmark_state_));
+
+    uint64_t target_time = (uint64_t)UT_FLAG(benchmark_time) * NSEC_PER_MSEC;
+    uint64_t sample_time = target_time / TARGET_SAMPLE_COUNT;
+    if (sample_time < MIN_SAMPLE_TIME)
+        sample_time = MIN_SAMPLE_TIME;
+
+    int capacity = TARGET_SAMPLE_COUNT * 4;
+    double *sorted_list = (double*)malloc(capacity * sizeof(double));
+    if (sorted_list == NULL || !alloc_benchmark_sample_list(result, capacity))
+    {
+        if (sorted_list == NULL)
+            PRINT_INTERNAL_ERROR("malloc(%d): %m", capacity * sizeof(double));
+        free(sorted_list);
+        return;
+    }
+
+    run_benchmark_batch(test_case, 1);
+    result->iteration_count = calibrate_iteration_count(test_case, sample_time);
+
+    uint64_t elapsed_time = 0;
+    while (result->sample_count < capacity && !is_benchmark_failed(test_case)
+           && (elapsed_time < target_time || result->sample_count < MIN_SAMPLE_COUNT))
+    {
+        uint64_t time = run_benchmark_batch(test_case, result->iteration_count);
+        result->sample_list[result->sample_count++] = (double)time / result->iteration_count;
+        elapsed_time += time;
+    }
+
+    if (result->sample_count > 0)
+        calc_benchmark_result(result, sorted_list);
+    free(sorted_list);
+}
+
+void free_benchmark_result(const test_runner_t *test_runner)
+{
+    int i;
+    for (i = 0; i < test_runner->suite_count; i++)
+    {
+        const test_suite_t *test_suite = test_runner->suite_list[i];
+        int j;
+        for (j = 0; j < test_suite->case_count; j++)
+        {
+            benchmark_result_t *result = test_suite->case_list[j]->benchmark;
+            if (result == NULL)
+                continue;
+
+            free(result->sample_list);
+            result->sample_list = NULL;
+        }
+    }
+}
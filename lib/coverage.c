@@ -0,0 +1,855 @@
+#define _GNU_SOURCE
+#include "zcut.h"
+
+#include <ftw.h>
+#include <unistd.h>
+
+#define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
+
+bool UT_FLAG(coverage_map);
+char UT_FLAG(coverage_map_path)[MAX_STR_LEN];
+char UT_FLAG(changed_files)[MAX_STR_LEN];
+
+/* Weak, so that a binary built without --coverage still links; see ZCUT_COVERAGE in zcut.h. */
+extern void __gcov_reset(void) __attribute__((weak));
+extern void __gcov_dump(void) __attribute__((weak));
+
+static const char* COVERAGE_MAGIC = "zcut-coverage";
+static const int COVERAGE_VERSION = 1;
+static const char CHANGED_FILES_LIST_PREFIX = '@';
+
+static const uint32_t GCOV_DATA_MAGIC = 0x67636461;
+static const uint32_t GCOV_NOTE_MAGIC = 0x67636e6f;
+static const uint32_t GCOV_TAG_FUNCTION = 0x01000000;
+static const uint32_t GCOV_TAG_ARCS = 0x01a10000;
+static const int MIN_GCOV_MAJOR_VERSION = 12;
+
+/* A function of an object file as its notes name it, with its index in the map once a case covered it. */
+typedef struct coverage_function_t
+{
+    uint32_t    ident;
+    char*       name;
+    char*       source;
+    int         index;
+}coverage_function_t;
+
+typedef struct coverage_object_t
+{
+    char*               path;
+    coverage_function_t *function_list;
+    int                 function_count;
+    int                 function_capacity;
+}coverage_object_t;
+
+typedef struct map_function_t
+{
+    int     source_index;
+    char*   name;
+}map_function_t;
+
+typedef struct coverage_case_t
+{
+    char*   name;
+    int     *function_index_list;
+    int     function_count;
+}coverage_case_t;
+
+typedef struct impacted_case_t
+{
+    char*   name;
+    bool    impacted;
+}impacted_case_t;
+
+/*
+ * Recording keeps the map as tables of sources, functions and cases, every case referring to the functions it
+ * covered by index. Selecting keeps only the case names, sorted, with whether their functions meet a changed file.
+ */
+typedef struct coverage_t
+{
+    bool                recording;
+    bool                selecting;
+    char                path[PATH_MAX];
+    char                dump_dir[PATH_MAX];
+    char*               *source_list;
+    int                 source_count;
+    int                 source_capacity;
+    map_function_t      *function_list;
+    int                 function_count;
+    int                 function_capacity;
+    coverage_object_t   *object_list;
+    int                 object_count;
+    int                 object_capacity;
+    coverage_case_t     *case_list;
+    int                 case_count;
+    int                 case_capacity;
+    int                 *covered_list;
+    int                 covered_count;
+    int                 covered_capacity;
+    char*               *changed_list;
+    int                 changed_count;
+    int                 changed_capacity;
+    impacted_case_t     *impacted_case_list;
+    int                 impacted_case_count;
+    int                 impacted_case_capacity;
+    bool                dump_failed;
+}coverage_t;
+
+static coverage_t _coverage_;
+
+static bool grow_list(void** list, int *capacity, int count, size_t size)
+{
+    if (count < *capacity)
+        return true;
+
+    int new_capacity = (*capacity == 0) ? 64 : *capacity * 2;
+    void* new_list = realloc(*list, new_capacity * size);
+    if (new_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("realloc(%d): %m", new_capacity * size);
+        return false;
+    }
+
+    *list = new_list;
+    *capacity = new_capacity;
+    return true;
+}
+
+static char* dup_str(const char* string)
+{
+    char* dup = strdup(string);
+    if (dup == NULL)
+        PRINT_INTERNAL_ERROR("strdup(%s): %m", string);
+    return dup;
+}
+
+static bool add_changed_file(const char* path)
+{
+    while (strncmp(path, "./", 2) == 0)
+        path += 2;
+    if (*path == '\0')
+        return true;
+
+    if (!grow_list((void**)&_coverage_.changed_list, &_coverage_.changed_capacity, _coverage_.changed_count,
+                   sizeof(char*)))
+        return false;
+
+    char* changed = dup_str(path);
+    if (changed == NULL)
+        return false;
+
+    _coverage_.changed_list[_coverage_.changed_count++] = changed;
+    return true;
+}
+
+/* `,' separated paths, or `@FILE' with one path per line, as `git diff --name-only' prints them. */
+static bool parse_changed_files(const char* value)
+{
+    if (*value != CHANGED_FILES_LIST_PREFIX)
+    {
+        char changed_files[MAX_STR_LEN];
+        snprintf(changed_files, sizeof(changed_files), "%s", value);
+
+        char* save_ptr = NULL;
+        char* path;
+        for (path = strtok_r(changed_files, ",", &save_ptr); path != NULL; path = strtok_r(NULL, ",", &save_ptr))
+        {
+            if (!add_changed_file(path))
+                return false;
+        }
+        return true;
+    }
+
+    FILE *file = fopen(value + 1, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "fopen(%s, r): %m\n", value + 1);
+        return false;
+    }
+
+    bool ret = true;
+    char line[PATH_MAX];
+    while (ret && fgets(line, sizeof(line), file) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        ret = add_changed_file(line);
+    }
+    fclose(file);
+    return ret;
+}
+
+/* A relative changed path, from the top of the repository, matches the sources it is a trailing part of. */
+static bool is_changed_source(const char* source)
+{
+    size_t source_len = strlen(source);
+    int i;
+    for (i = 0; i < _coverage_.changed_count; i++)
+    {
+        const char* changed = _coverage_.changed_list[i];
+        size_t len = strlen(changed);
+        if (strcmp(source, changed) == 0)
+            return true;
+        if (changed[0] != '/' && source_len > len && source[source_len - len - 1] == '/'
+            && strcmp(source + source_len - len, changed) == 0)
+            return true;
+    }
+    return false;
+}
+
+static int compare_impacted_case_name(const void* a, const void* b)
+{
+    return strcmp(((const impacted_case_t*)a)->name, ((const impacted_case_t*)b)->name);
+}
+
+static bool add_impacted_case(const char* name, bool impacted)
+{
+    if (!grow_list((void**)&_coverage_.impacted_case_list, &_coverage_.impacted_case_capacity,
+                   _coverage_.impacted_case_count, sizeof(impacted_case_t)))
+        return false;
+
+    impacted_case_t *impacted_case = &_coverage_.impacted_case_list[_coverage_.impacted_case_count];
+    impacted_case->name = dup_str(name);
+    if (impacted_case->name == NULL)
+        return false;
+
+    impacted_case->impacted = impacted;
+    _coverage_.impacted_case_count++;
+    return true;
+}
+
+/* Only whether a source changed matters, so sources and functions are read as flags in the order of the map. */
+static bool read_coverage_map(FILE *file)
+{
+    bool *changed_source_list = NULL;
+    bool *changed_function_list = NULL;
+    int source_count = 0;
+    int source_capacity = 0;
+    int function_count = 0;
+    int function_capacity = 0;
+    bool ret = true;
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t len;
+    while (ret && (len = getline(&line, &line_size, file)) != -1)
+    {
+        if (len > 0 && line[len - 1] == '\n')
+            line[len - 1] = '\0';
+
+        if (strncmp(line, "s ", 2) == 0)
+        {
+            ret = grow_list((void**)&changed_source_list, &source_capacity, source_count, sizeof(bool));
+            if (ret)
+                changed_source_list[source_count++] = is_changed_source(line + 2);
+        }
+        else if (strncmp(line, "f ", 2) == 0)
+        {
+            int source_index = atoi(line + 2);
+            ret = grow_list((void**)&changed_function_list, &function_capacity, function_count, sizeof(bool));
+            if (ret)
+                changed_function_list[function_count++] = source_index >= 0 && source_index < source_count
+                                                          && changed_source_list[source_index];
+        }
+        else if (strncmp(line, "c ", 2) == 0)
+        {
+            char* name = line + 2;
+            char* index_list = name + strcspn(name, " ");
+            if (*index_list != '\0')
+                *index_list++ = '\0';
+
+            bool impacted = false;
+            char* end;
+            long index;
+            for (index = strtol(index_list, &end, 10); end != index_list; index = strtol(index_list, &end, 10))
+            {
+                if (index >= 0 && index < function_count && changed_function_list[index])
+                    impacted = true;
+                index_list = end;
+            }
+            ret = add_impacted_case(name, impacted);
+        }
+    }
+
+    free(line);
+    free(changed_source_list);
+    free(changed_function_list);
+    qsort(_coverage_.impacted_case_list, _coverage_.impacted_case_count, sizeof(impacted_case_t),
+          compare_impacted_case_name);
+    return ret;
+}
+
+static bool load_coverage_map(void)
+{
+    FILE *file = fopen(_coverage_.path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "fopen(%s, r): %m\n", _coverage_.path);
+        return false;
+    }
+
+    char magic[64];
+    int version = 0;
+    bool ret;
+    if (fscanf(file, "%63s %d\n", magic, &version) == 2 && strcmp(magic, COVERAGE_MAGIC) == 0
+        && version == COVERAGE_VERSION)
+    {
+        ret = read_coverage_map(file);
+    }
+    else
+    {
+        fprintf(stderr, "`%s' is not a coverage map of version %d.\n", _coverage_.path, COVERAGE_VERSION);
+        ret = false;
+    }
+
+    fclose(file);
+    return ret;
+}
+
+/*
+ * gcov counters are global to the process, so the map is recorded with the cases run serially: counters are reset
+ * before a case and dumped after it, into a private directory with GCOV_PREFIX, where the .gcda files are read and
+ * removed again. This replaces the .gcda files the test binary would otherwise write at its exit.
+ */
+static bool init_coverage_recording(void)
+{
+    if (__gcov_reset == NULL || __gcov_dump == NULL)
+    {
+        fprintf(stderr, "--coverage-map needs a test binary built with --coverage -DZCUT_COVERAGE.\n");
+        return false;
+    }
+
+    const char* tmp_dir = getenv("TMPDIR");
+    snprintf(_coverage_.dump_dir, sizeof(_coverage_.dump_dir), "%s/zcut-coverage-XXXXXX",
+             (tmp_dir != NULL && strlen(tmp_dir) > 0) ? tmp_dir : "/tmp");
+    if (mkdtemp(_coverage_.dump_dir) == NULL)
+    {
+        fprintf(stderr, "mkdtemp(%s): %m\n", _coverage_.dump_dir);
+        _coverage_.dump_dir[0] = '\0';
+        return false;
+    }
+
+    if (setenv("GCOV_PREFIX", _coverage_.dump_dir, 1) == -1 || unsetenv("GCOV_PREFIX_STRIP") == -1)
+    {
+        PRINT_INTERNAL_ERROR("setenv(GCOV_PREFIX): %m");
+        return false;
+    }
+
+    _coverage_.recording = true;
+    return true;
+}
+
+bool init_coverage(const test_runner_t *test_runner)
+{
+    if (strlen(UT_FLAG(coverage_map_path)) > 0)
+        snprintf(_coverage_.path, sizeof(_coverage_.path), "%s", UT_FLAG(coverage_map_path));
+    else
+        snprintf(_coverage_.path, sizeof(_coverage_.path), "%s.coverage", test_runner->test_bin_name);
+
+    if (strlen(UT_FLAG(changed_files)) == 0)
+        return init_coverage_recording();
+
+    _coverage_.selecting = true;
+    return parse_changed_files(UT_FLAG(changed_files)) && load_coverage_map();
+}
+
+bool is_recording_coverage(void)
+{
+    return _coverage_.recording;
+}
+
+/* Cases missing from the map are new, they run whatever changed. */
+bool is_case_impacted(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    if (!_coverage_.selecting)
+        return true;
+
+    char name[MAX_STR_LEN];
+    snprintf(name, sizeof(name), "%s.%s", test_suite->name, test_case->name);
+    impacted_case_t key;
+    key.name = name;
+    const impacted_case_t *impacted_case = (const impacted_case_t*)bsearch(&key, _coverage_.impacted_case_list,
+                                                                          _coverage_.impacted_case_count,
+                                                                          sizeof(impacted_case_t),
+                                                                          compare_impacted_case_name);
+    return impacted_case == NULL || impacted_case->impacted;
+}
+
+void begin_case_coverage(void)
+{
+    if (_coverage_.recording)
+        __gcov_reset();
+}
+
+typedef struct gcov_reader_t
+{
+    const unsigned char *data;
+    size_t              size;
+    size_t              pos;
+}gcov_reader_t;
+
+static bool read_gcov_word(gcov_reader_t *reader, uint32_t *value)
+{
+    if (reader->pos + 4 > reader->size)
+        return false;
+
+    memcpy(value, reader->data + reader->pos, 4);
+    reader->pos += 4;
+    return true;
+}
+
+/* A string is its length in bytes, with the terminating NUL, and its bytes; a length of 0 is the empty string. */
+static const char* read_gcov_string(gcov_reader_t *reader)
+{
+    uint32_t len;
+    if (!read_gcov_word(reader, &len) || reader->pos + len > reader->size)
+        return NULL;
+    if (len == 0)
+        return EMPTY_STR;
+
+    const char* string = (const char*)reader->data + reader->pos;
+    reader->pos += len;
+    return (string[len - 1] == '\0') ? string : NULL;
+}
+
+static int get_gcov_major_version(uint32_t version)
+{
+    return ((version >> 24) - 'A') * 10 + (int)(((version >> 16) & 0xff) - '0');
+}
+
+/* Header of GCC 12 on: magic, version, stamp and checksum. Earlier versions count lengths in words. */
+static bool read_gcov_header(gcov_reader_t *reader, uint32_t magic, const char* path)
+{
+    uint32_t word_list[4];
+    int i;
+    for (i = 0; i < 4; i++)
+    {
+        if (!read_gcov_word(reader, &word_list[i]))
+            break;
+    }
+
+    if (i < 4 || word_list[0] != magic)
+    {
+        fprintf(stderr, "`%s' is not a gcov file.\n", path);
+        return false;
+    }
+    if ((word_list[1] >> 24) < 'A' || get_gcov_major_version(word_list[1]) < MIN_GCOV_MAJOR_VERSION)
+    {
+        fprintf(stderr, "`%s': gcov version %08x is not supported, --coverage-map needs GCC %d or later.\n", path,
+                word_list[1], MIN_GCOV_MAJOR_VERSION);
+        return false;
+    }
+
+    return true;
+}
+
+static bool read_gcov_file(const char* path, unsigned char **data, size_t *size)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return false;
+
+    bool ret = false;
+    long len;
+    if (fseek(file, 0, SEEK_END) == 0 && (len = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0)
+    {
+        *data = (unsigned char*)malloc(len + 1);
+        if (*data == NULL)
+            PRINT_INTERNAL_ERROR("malloc(%d): %m", len + 1);
+        else if (fread(*data, 1, len, file) == (size_t)len)
+            ret = true;
+        else
+            fprintf(stderr, "fread(%s): %m\n", path);
+        *size = len;
+    }
+
+    fclose(file);
+    if (!ret)
+    {
+        free(*data);
+        *data = NULL;
+    }
+    return ret;
+}
+
+static bool add_object_function(coverage_object_t *object, uint32_t ident, const char* name, const char* source)
+{
+    if (!grow_list((void**)&object->function_list, &object->function_capacity, object->function_count,
+                   sizeof(coverage_function_t)))
+        return false;
+
+    coverage_function_t *function = &object->function_list[object->function_count];
+    function->ident = ident;
+    function->index = -1;
+    function->name = dup_str(name);
+    function->source = dup_str(source);
+    if (function->name == NULL || function->source == NULL)
+    {
+        free(function->name);
+        free(function->source);
+        return false;
+    }
+
+    object->function_count++;
+    return true;
+}
+
+/*
+ * The .gcno notes next to the object name every function and its source, relative to the directory it was compiled
+ * in. Without notes a function is named by its ident, and its source is the object path without `.gcda', which
+ * still ends with the source name in CMake builds.
+ */
+static bool read_object_notes(coverage_object_t *object)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%.*s.gcno", (int)(strlen(object->path) - strlen(".gcda")), object->path);
+
+    unsigned char *data = NULL;
+    size_t size = 0;
+    if (!read_gcov_file(path, &data, &size))
+        return true;
+
+    gcov_reader_t reader = {data, size, 0};
+    bool ret = read_gcov_header(&reader, GCOV_NOTE_MAGIC, path);
+    const char* cwd = ret ? read_gcov_string(&reader) : NULL;
+    uint32_t value;
+    if (cwd == NULL || !read_gcov_word(&reader, &value))
+        ret = false;
+
+    uint32_t tag;
+    uint32_t len;
+    while (ret && read_gcov_word(&reader, &tag) && tag != 0 && read_gcov_word(&reader, &len))
+    {
+        size_t end = reader.pos + len;
+        if (end > reader.size)
+            break;
+
+        if (tag == GCOV_TAG_FUNCTION)
+        {
+            uint32_t ident;
+            const char* name = NULL;
+            const char* source = NULL;
+            if (read_gcov_word(&reader, &ident) && read_gcov_word(&reader, &value) && read_gcov_word(&reader, &value)
+                && (name = read_gcov_string(&reader)) != NULL && read_gcov_word(&reader, &value))
+                source = read_gcov_string(&reader);
+            if (source != NULL)
+            {
+                char full_source[PATH_MAX];
+                if (source[0] != '/' && strlen(cwd) > 0)
+                    snprintf(full_source, sizeof(full_source), "%s/%s", cwd, source);
+                else
+                    snprintf(full_source, sizeof(full_source), "%s", source);
+                ret = add_object_function(object, ident, name, full_source);
+            }
+        }
+        reader.pos = end;
+    }
+
+    free(data);
+    return ret;
+}
+
+static coverage_object_t* get_coverage_object(const char* path)
+{
+    int i;
+    for (i = 0; i < _coverage_.object_count; i++)
+    {
+        if (strcmp(_coverage_.object_list[i].path, path) == 0)
+            return &_coverage_.object_list[i];
+    }
+
+    if (!grow_list((void**)&_coverage_.object_list, &_coverage_.object_capacity, _coverage_.object_count,
+                   sizeof(coverage_object_t)))
+        return NULL;
+
+    coverage_object_t *object = &_coverage_.object_list[_coverage_.object_count];
+    memset(object, 0, sizeof(*object));
+    object->path = dup_str(path);
+    if (object->path == NULL)
+        return NULL;
+
+    _coverage_.object_count++;
+    if (!read_object_notes(object))
+        return NULL;
+    return object;
+}
+
+static int get_source_index(const char* source)
+{
+    int i;
+    for (i = 0; i < _coverage_.source_count; i++)
+    {
+        if (strcmp(_coverage_.source_list[i], source) == 0)
+            return i;
+    }
+
+    if (!grow_list((void**)&_coverage_.source_list, &_coverage_.source_capacity, _coverage_.source_count,
+                   sizeof(char*)))
+        return -1;
+
+    char* dup = dup_str(source);
+    if (dup == NULL)
+        return -1;
+
+    _coverage_.source_list[_coverage_.source_count] = dup;
+    return _coverage_.source_count++;
+}
+
+/* Functions and sources enter the map when a case first covers them, so it holds no code that no case runs. */
+static int get_function_index(coverage_object_t *object, uint32_t ident)
+{
+    coverage_function_t *function = NULL;
+    int i;
+    for (i = 0; i < object->function_count; i++)
+    {
+        if (object->function_list[i].ident == ident)
+            function = &object->function_list[i];
+    }
+
+    if (function == NULL)
+    {
+        char name[32];
+        char source[PATH_MAX];
+        snprintf(name, sizeof(name), "%u", ident);
+        snprintf(source, sizeof(source), "%.*s", (int)(strlen(object->path) - strlen(".gcda")), object->path);
+        if (!add_object_function(object, ident, name, source))
+            return -1;
+        function = &object->function_list[object->function_count - 1];
+    }
+    if (function->index >= 0)
+        return function->index;
+
+    int source_index = get_source_index(function->source);
+    if (source_index < 0)
+        return -1;
+
+    if (!grow_list((void**)&_coverage_.function_list, &_coverage_.function_capacity, _coverage_.function_count,
+                   sizeof(map_function_t)))
+        return -1;
+
+    _coverage_.function_list[_coverage_.function_count].source_index = source_index;
+    _coverage_.function_list[_coverage_.function_count].name = function->name;
+    function->index = _coverage_.function_count++;
+    return function->index;
+}
+
+static bool add_covered_function(coverage_object_t *object, uint32_t ident)
+{
+    int index = get_function_index(object, ident);
+    if (index < 0)
+        return false;
+
+    if (!grow_list((void**)&_coverage_.covered_list, &_coverage_.covered_capacity, _coverage_.covered_count,
+                   sizeof(int)))
+        return false;
+
+    _coverage_.covered_list[_coverage_.covered_count++] = index;
+    return true;
+}
+
+static bool is_zero_counter_list(const unsigned char *data, size_t len)
+{
+    size_t i;
+    for (i = 0; i < len; i++)
+    {
+        if (data[i] != 0)
+            return false;
+    }
+    return true;
+}
+
+/* A function is covered when any of its arc counters is not 0; counters all 0 come as a negative length. */
+static bool read_dumped_object(const char* dump_path, const char* path)
+{
+    unsigned char *data = NULL;
+    size_t size = 0;
+    if (!read_gcov_file(dump_path, &data, &size))
+    {
+        fprintf(stderr, "fopen(%s, r): %m\n", dump_path);
+        return false;
+    }
+
+    gcov_reader_t reader = {data, size, 0};
+    bool ret = read_gcov_header(&reader, GCOV_DATA_MAGIC, dump_path);
+    coverage_object_t *object = ret ? get_coverage_object(path) : NULL;
+    if (object == NULL)
+        ret = false;
+
+    uint32_t ident = 0;
+    uint32_t tag;
+    uint32_t len;
+    while (ret && read_gcov_word(&reader, &tag) && tag != 0 && read_gcov_word(&reader, &len))
+    {
+        if ((int32_t)len < 0)
+            continue;
+        if (reader.pos + len > reader.size)
+            break;
+
+        if (tag == GCOV_TAG_FUNCTION && len >= 4)
+            memcpy(&ident, reader.data + reader.pos, 4);
+        else if (tag == GCOV_TAG_ARCS && !is_zero_counter_list(reader.data + reader.pos, len))
+            ret = add_covered_function(object, ident);
+        reader.pos += len;
+    }
+
+    free(data);
+    return ret;
+}
+
+static int read_dumped_file(const char* file_path, const struct stat *file_stat ATTRIBUTE_UNUSED, int type,
+                            struct FTW *ftw ATTRIBUTE_UNUSED)
+{
+    size_t len = strlen(file_path);
+    if (type != FTW_F || len < strlen(".gcda") || strcmp(file_path + len - strlen(".gcda"), ".gcda") != 0)
+        return 0;
+
+    bool ret = read_dumped_object(file_path, file_path + strlen(_coverage_.dump_dir));
+    unlink(file_path);
+    return ret ? 0 : -1;
+}
+
+static bool add_coverage_case(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    if (!grow_list((void**)&_coverage_.case_list, &_coverage_.case_capacity, _coverage_.case_count,
+                   sizeof(coverage_case_t)))
+        return false;
+
+    char name[MAX_STR_LEN];
+    snprintf(name, sizeof(name), "%s.%s", test_suite->name, test_case->name);
+    coverage_case_t *coverage_case = &_coverage_.case_list[_coverage_.case_count];
+    coverage_case->name = dup_str(name);
+    coverage_case->function_count = _coverage_.covered_count;
+    coverage_case->function_index_list = (int*)malloc((_coverage_.covered_count + 1) * sizeof(int));
+    if (coverage_case->name == NULL || coverage_case->function_index_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("malloc(%d): %m", (_coverage_.covered_count + 1) * sizeof(int));
+        free(coverage_case->name);
+        free(coverage_case->function_index_list);
+        return false;
+    }
+
+    memcpy(coverage_case->function_index_list, _coverage_.covered_list, _coverage_.covered_count * sizeof(int));
+    _coverage_.case_count++;
+    return true;
+}
+
+/* Covers the case together with its case setup and teardown, so that a fixture change selects its cases. */
+void end_case_coverage(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    const case_result_t *result = test_case->result;
+    if (!_coverage_.recording || _coverage_.dump_failed || !result->accessed || result->is_filtered_out)
+        return;
+
+    __gcov_dump();
+    _coverage_.covered_count = 0;
+    if (nftw(_coverage_.dump_dir, read_dumped_file, 16, FTW_PHYS) != 0 || !add_coverage_case(test_suite, test_case))
+    {
+        fprintf(stderr, "record coverage of %s.%s failed, no coverage map is written.\n", test_suite->name,
+                test_case->name);
+        _coverage_.dump_failed = true;
+    }
+}
+
+static int compare_coverage_case_name(const void* a, const void* b)
+{
+    return strcmp(((const coverage_case_t*)a)->name, ((const coverage_case_t*)b)->name);
+}
+
+static void write_coverage_map(FILE *file)
+{
+    fprintf(file, "%s %d\n", COVERAGE_MAGIC, COVERAGE_VERSION);
+    int i;
+    for (i = 0; i < _coverage_.source_count; i++)
+        fprintf(file, "s %s\n", _coverage_.source_list[i]);
+    for (i = 0; i < _coverage_.function_count; i++)
+        fprintf(file, "f %d %s\n", _coverage_.function_list[i].source_index, _coverage_.function_list[i].name);
+
+    /* With -r a case is recorded once per repeat, its line has the functions of all of them. */
+    qsort(_coverage_.case_list, _coverage_.case_count, sizeof(coverage_case_t), compare_coverage_case_name);
+    for (i = 0; i < _coverage_.case_count; i++)
+    {
+        const coverage_case_t *coverage_case = &_coverage_.case_list[i];
+        if (i == 0 || strcmp(coverage_case->name, _coverage_.case_list[i - 1].name) != 0)
+            fprintf(file, "%sc %s", (i == 0) ? EMPTY_STR : "\n", coverage_case->name);
+
+        int j;
+        for (j = 0; j < coverage_case->function_count; j++)
+            fprintf(file, " %d", coverage_case->function_index_list[j]);
+    }
+    if (_coverage_.case_count > 0)
+        fprintf(file, "\n");
+}
+
+bool save_coverage_map(void)
+{
+    if (!_coverage_.recording)
+        return true;
+    if (_coverage_.dump_failed)
+        return false;
+
+    char tmp_path[PATH_MAX + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", _coverage_.path, (int)getpid());
+    FILE *file = fopen(tmp_path, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "fopen(%s, w): %m\n", tmp_path);
+        return false;
+    }
+
+    write_coverage_map(file);
+    bool ret = (fflush(file) == 0 && fsync(fileno(file)) == 0);
+    if (fclose(file) != 0)
+        ret = false;
+    if (!ret || rename(tmp_path, _coverage_.path) == -1)
+    {
+        fprintf(stderr, "write coverage map %s: %m\n", _coverage_.path);
+        unlink(tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+static int remove_dumped_file(const char* file_path, const struct stat *file_stat ATTRIBUTE_UNUSED,
+                              int type ATTRIBUTE_UNUSED, struct FTW *ftw ATTRIBUTE_UNUSED)
+{
+    remove(file_path);
+    return 0;
+}
+
+void free_coverage(void)
+{
+    if (strlen(_coverage_.dump_dir) > 0)
+        nftw(_coverage_.dump_dir, remove_dumped_file, 16, FTW_DEPTH | FTW_PHYS);
+
+    int i;
+    for (i = 0; i < _coverage_.source_count; i++)
+        free(_coverage_.source_list[i]);
+    for (i = 0; i < _coverage_.object_count; i++)
+    {
+        coverage_object_t *object = &_coverage_.object_list[i];
+        int j;
+        for (j = 0; j < object->function_count; j++)
+        {
+            free(object->function_list[j].name);
+            free(object->function_list[j].source);
+        }
+        free(object->function_list);
+        free(object->path);
+    }
+    for (i = 0; i < _coverage_.case_count; i++)
+    {
+        free(_coverage_.case_list[i].name);
+        free(_coverage_.case_list[i].function_index_list);
+    }
+    for (i = 0; i < _coverage_.changed_count; i++)
+        free(_coverage_.changed_list[i]);
+    for (i = 0; i < _coverage_.impacted_case_count; i++)
+        free(_coverage_.impacted_case_list[i].name);
+
+    free(_coverage_.source_list);
+    free(_coverage_.function_list);
+    free(_coverage_.object_list);
+    free(_coverage_.case_list);
+    free(_coverage_.covered_list);
+    free(_coverage_.changed_list);
+    free(_coverage_.impacted_case_list);
+    memset(&_coverage_, 0, sizeof(_coverage_));
+}
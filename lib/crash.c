@@ -0,0 +1,193 @@
+#define _GNU_SOURCE
+#include "zcut.h"
+
+#include <pthread.h>
+#include <signal.h>
+
+#define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
+#define ASSERTION_TRAIL_COUNT   8
+
+bool UT_FLAG(catch_crashes);
+
+/* The signal stack must hold the handler even when the case overflowed its own stack. */
+static const size_t CRASH_STACK_SIZE = 64 * 1024;
+static const int CRASH_SIGNAL_LIST[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+static const int CRASH_SIGNAL_COUNT = sizeof(CRASH_SIGNAL_LIST) / sizeof(CRASH_SIGNAL_LIST[0]);
+
+typedef struct assertion_trace_t
+{
+    const char* file;
+    int         line;
+    const char* condition;
+}assertion_trace_t;
+
+/*
+ * Everything is per thread, a case crashes on the thread which runs it. The trail is a ring of the last assertions
+ * the case reached, the newest at `trail_count - 1'.
+ */
+typedef struct crash_context_t
+{
+    sigjmp_buf              jmp_buf;
+    volatile sig_atomic_t   armed;
+    volatile sig_atomic_t   signal_number;
+    void*                   volatile addr;
+    assertion_trace_t       trail[ASSERTION_TRAIL_COUNT];
+    unsigned int            trail_count;
+    void*                   stack;
+}crash_context_t;
+
+static __thread crash_context_t _crash_context_;
+static pthread_once_t _crash_stack_key_once_ = PTHREAD_ONCE_INIT;
+static pthread_key_t _crash_stack_key_;
+
+bool trace_assertion(const char* file, int line, const char* condition)
+{
+    assertion_trace_t *trace = &_crash_context_.trail[_crash_context_.trail_count % ASSERTION_TRAIL_COUNT];
+    trace->file = file;
+    trace->line = line;
+    trace->condition = condition;
+    _crash_context_.trail_count++;
+    return true;
+}
+
+/* Outside of a case the signal keeps its default action, raised again when the handler returns. */
+static void recover_crash(int signal_number, siginfo_t *info, void* context ATTRIBUTE_UNUSED)
+{
+    if (!_crash_context_.armed)
+    {
+        signal(signal_number, SIG_DFL);
+        raise(signal_number);
+        return;
+    }
+
+    _crash_context_.armed = false;
+    _crash_context_.signal_number = signal_number;
+    _crash_context_.addr = info->si_addr;
+    siglongjmp(_crash_context_.jmp_buf, 1);
+}
+
+static void free_crash_stack(void* stack)
+{
+    stack_t alt_stack;
+    memset(&alt_stack, 0, sizeof(alt_stack));
+    alt_stack.ss_flags = SS_DISABLE;
+    sigaltstack(&alt_stack, NULL);
+    free(stack);
+}
+
+static void create_crash_stack_key(void)
+{
+    pthread_key_create(&_crash_stack_key_, free_crash_stack);
+}
+
+/* Every thread which runs cases needs its own signal stack, freed when the thread exits. */
+static bool set_crash_stack(void)
+{
+    if (_crash_context_.stack != NULL)
+        return true;
+
+    pthread_once(&_crash_stack_key_once_, create_crash_stack_key);
+    void* stack = malloc(CRASH_STACK_SIZE);
+    if (stack == NULL)
+    {
+        PRINT_INTERNAL_ERROR("malloc(%d): %m", CRASH_STACK_SIZE);
+        return false;
+    }
+
+    stack_t alt_stack;
+    alt_stack.ss_sp = stack;
+    alt_stack.ss_size = CRASH_STACK_SIZE;
+    alt_stack.ss_flags = 0;
+    if (sigaltstack(&alt_stack, NULL) == -1)
+    {
+        PRINT_INTERNAL_ERROR("sigaltstack(): %m");
+        free(stack);
+        return false;
+    }
+
+    pthread_setspecific(_crash_stack_key_, stack);
+    _crash_context_.stack = stack;
+    return true;
+}
+
+/* Aborting on a failure is for the debugger, a recovered SIGABRT would not stop there. */
+bool init_crash_recovery(void)
+{
+    if (!UT_FLAG(catch_crashes) || UT_FLAG(break_on_failure))
+    {
+        UT_FLAG(catch_crashes) = false;
+        return true;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = recover_crash;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    int i;
+    for (i = 0; i < CRASH_SIGNAL_COUNT; i++)
+    {
+        if (sigaction(CRASH_SIGNAL_LIST[i], &action, NULL) == -1)
+        {
+            PRINT_INTERNAL_ERROR("sigaction(%s): %m", strsignal(CRASH_SIGNAL_LIST[i]));
+            return false;
+        }
+    }
+    return true;
+}
+
+/* NULL if crashes are not caught, otherwise the caller must sigsetjmp() on the buffer right away. */
+sigjmp_buf* arm_crash_recovery(void)
+{
+    if (!UT_FLAG(catch_crashes) || !set_crash_stack())
+        return NULL;
+
+    _crash_context_.trail_count = 0;
+    _crash_context_.armed = true;
+    return &_crash_context_.jmp_buf;
+}
+
+void disarm_crash_recovery(void)
+{
+    _crash_context_.armed = false;
+}
+
+static void format_assertion_trail(char* trail, size_t size)
+{
+    unsigned int trail_count = _crash_context_.trail_count;
+    if (trail_count == 0)
+    {
+        snprintf(trail, size, "crashed before any assertion");
+        return;
+    }
+
+    int len = snprintf(trail, size, "crashed after ");
+    unsigned int i;
+    for (i = 0; i < trail_count && i < ASSERTION_TRAIL_COUNT && len < (int)size; i++)
+    {
+        const assertion_trace_t *trace = &_crash_context_.trail[(trail_count - 1 - i) % ASSERTION_TRAIL_COUNT];
+        len += snprintf(trail + len, size - len, "%s%s:%d `%s'", (i == 0) ? EMPTY_STR : " <- ",
+                        trace->file, trace->line, trace->condition);
+    }
+}
+
+/* Back on the case thread after siglongjmp(): the signal, where it hit, and the assertions the case last reached. */
+void save_case_crash(const test_case_t *test_case)
+{
+    case_result_t *result = test_case->result;
+    result->is_crashed = true;
+    result->fail_assertion_count++;
+
+    int signal_number = _crash_context_.signal_number;
+    char expected[MAX_STR_LEN];
+    char actual[MAX_STR_LEN];
+    char trail[MAX_STR_LEN];
+    snprintf(expected, sizeof(expected), "%s finished", test_case->name);
+    if (signal_number == SIGABRT)
+        snprintf(actual, sizeof(actual), "signal %d (%s)", signal_number, strsignal(signal_number));
+    else
+        snprintf(actual, sizeof(actual), "signal %d (%s) at %p", signal_number, strsignal(signal_number),
+                 _crash_context_.addr);
+    format_assertion_trail(trail, sizeof(trail));
+    save_assertion_info(result, test_case->file, test_case->line, expected, actual, "%s", trail);
+}
@@ -0,0 +1,173 @@
+#include "zcut.h"
+
+#include <pthread.h>
+#include <sys/mman.h>
+
+#define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
+
+static const int MAX_CASE_FAILURE_COUNT = 100;
+static const size_t ARENA_BLOCK_SIZE = 64 * 1024;
+
+/*
+ * Failure records of a run live in a list of blocks which is allocated on the first failure, rewound before every
+ * run and only freed by ut_fini(). Passing cases cost nothing, and a case keeps at most MAX_CASE_FAILURE_COUNT
+ * records; fail_assertion_count still counts all of them. Blocks are mapped rather than malloc'ed to stay out of
+ * the heap accounting of the failing case.
+ */
+typedef struct arena_block_t
+{
+    struct arena_block_t    *next;
+    size_t                  size;
+    size_t                  used;
+    char                    data[];
+}arena_block_t;
+
+typedef struct failure_arena_t
+{
+    pthread_mutex_t lock;
+    arena_block_t   *block_list;
+    arena_block_t   *current;
+}failure_arena_t;
+
+static failure_arena_t _failure_arena_ = {PTHREAD_MUTEX_INITIALIZER, NULL, NULL};
+
+static arena_block_t* new_arena_block(size_t size)
+{
+    if (size < ARENA_BLOCK_SIZE)
+        size = ARENA_BLOCK_SIZE;
+
+    arena_block_t *block = (arena_block_t*)mmap(NULL, sizeof(arena_block_t) + size, PROT_READ | PROT_WRITE,
+                                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED)
+    {
+        PRINT_INTERNAL_ERROR("mmap(%d): %m", sizeof(arena_block_t) + size);
+        return NULL;
+    }
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+/* Rewound blocks are reused in order before a new one is appended. */
+static void* alloc_arena(size_t size)
+{
+    size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    arena_block_t *block = _failure_arena_.current;
+    while (block != NULL && block->size - block->used < size)
+    {
+        block = block->next;
+        if (block != NULL)
+            block->used = 0;
+    }
+
+    if (block == NULL)
+    {
+        block = new_arena_block(size);
+        if (block == NULL)
+            return NULL;
+
+        block->next = NULL;
+        if (_failure_arena_.current == NULL)
+        {
+            block->next = _failure_arena_.block_list;
+            _failure_arena_.block_list = block;
+        }
+        else
+        {
+            arena_block_t *last = _failure_arena_.current;
+            while (last->next != NULL)
+                last = last->next;
+            last->next = block;
+        }
+    }
+
+    _failure_arena_.current = block;
+    void* ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+static char* copy_arena_str(char* dest, const char* src, size_t len)
+{
+    memcpy(dest, src, len);
+    dest[len] = '\0';
+    return dest;
+}
+
+void add_assertion_failure(case_result_t *result, const char* file, int line, const char* expected,
+                           const char* actual, const char* user_msg)
+{
+    if (result->failure_count >= MAX_CASE_FAILURE_COUNT)
+        return;
+
+    size_t file_len = strlen(file);
+    size_t expected_len = strlen(expected);
+    size_t actual_len = strlen(actual);
+    size_t user_msg_len = strlen(user_msg);
+
+    pthread_mutex_lock(&_failure_arena_.lock);
+    char* data = (char*)alloc_arena(sizeof(assertion_failure_t) + file_len + expected_len + actual_len
+                                    + user_msg_len + 4);
+    pthread_mutex_unlock(&_failure_arena_.lock);
+    if (data == NULL)
+        return;
+
+    assertion_failure_t *failure = (assertion_failure_t*)data;
+    data += sizeof(assertion_failure_t);
+    failure->next = NULL;
+    failure->line = line;
+    failure->file = copy_arena_str(data, file, file_len);
+    data += file_len + 1;
+    failure->expected = copy_arena_str(data, expected, expected_len);
+    data += expected_len + 1;
+    failure->actual = copy_arena_str(data, actual, actual_len);
+    data += actual_len + 1;
+    failure->user_msg = copy_arena_str(data, user_msg, user_msg_len);
+
+    if (result->last_failure == NULL)
+        result->failure_list = failure;
+    else
+        result->last_failure->next = failure;
+    result->last_failure = failure;
+    result->failure_count++;
+}
+
+/* Records of the previous run are gone after this, so no case may still point into them. */
+void reset_failure_arena(const test_runner_t *test_runner)
+{
+    int i;
+    for (i = 0; i < test_runner->suite_count; i++)
+    {
+        const test_suite_t *test_suite = test_runner->suite_list[i];
+        int j;
+        for (j = 0; j < test_suite->case_count; j++)
+        {
+            case_result_t *result = test_suite->case_list[j]->result;
+            result->failure_count = 0;
+            result->failure_list = NULL;
+            result->last_failure = NULL;
+        }
+    }
+
+    pthread_mutex_lock(&_failure_arena_.lock);
+    _failure_arena_.current = _failure_arena_.block_list;
+    if (_failure_arena_.current != NULL)
+        _failure_arena_.current->used = 0;
+    pthread_mutex_unlock(&_failure_arena_.lock);
+}
+
+void free_failure_arena(void)
+{
+    arena_block_t *block = _failure_arena_.block_list;
+    while (block != NULL)
+    {
+        arena_block_t *next = block->next;
+        munmap(block, sizeof(arena_block_t) + block->size);
+        block = next;
+    }
+
+    _failure_arena_.block_list = NULL;
+    _failure_arena_.current = NULL;
+}
@@ -0,0 +1,393 @@
+#include "zcut.h"
+
+#define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
+#define CHAR_COUNT              256
+#define MAX_FILTER_WORD_COUNT   ((MAX_STR_LEN * 2 + 63) / 64)
+
+char UT_FLAG(filter_file)[MAX_STR_LEN];
+char UT_FLAG(quarantine)[MAX_STR_LEN];
+
+static const char PATTERN_SEPARATOR = ':';
+static const char NEGATIVE_PREFIX   = '-';
+static const int MIN_NAME_SET_CAPACITY = 1024;
+
+/*
+ * All the patterns of a filter are compiled into one NFA, simulated bit-parallel, so a name is matched in one pass
+ * whatever the patterns are. A pattern of k non-`*' characters has the states 0..k, state j meaning its first j
+ * characters matched; a `*' between them is a self loop on its state. States of all patterns are bits of one
+ * bitset, a step shifts the set by one and keeps the bits whose character matches, plus the looping ones.
+ */
+typedef struct filter_t
+{
+    int         word_count;
+    bool        has_include;
+    uint64_t    *mask_list;
+    uint64_t    *start_mask;
+    uint64_t    *loop_mask;
+    uint64_t    *last_mask;
+    uint64_t    *include_mask;
+    uint64_t    *exclude_mask;
+    uint64_t    *char_mask_list;
+}filter_t;
+
+/* `suite.case' names of --filter-file or --quarantine, open addressing with linear probing. */
+typedef struct name_set_t
+{
+    char*   *name_list;
+    int     capacity;
+    int     count;
+}name_set_t;
+
+static filter_t _suite_filter_;
+static filter_t _case_filter_;
+static name_set_t _filter_name_set_;
+static name_set_t _quarantine_name_set_;
+
+static void set_state_bit(uint64_t *mask, int state)
+{
+    mask[state / 64] |= 1ULL << (state % 64);
+}
+
+/* A pattern has one state more than characters, so characters plus patterns is enough. */
+static int count_filter_state(const char* filter)
+{
+    int count = strlen(filter) + 1;
+    const char* c;
+    for (c = filter; *c != '\0'; c++)
+    {
+        if (*c == PATTERN_SEPARATOR)
+            count++;
+    }
+    return count;
+}
+
+static bool alloc_filter(filter_t *filter, int state_count)
+{
+    int word_count = (state_count + 63) / 64;
+    uint64_t *mask_list = (uint64_t*)calloc((5 + CHAR_COUNT) * word_count, sizeof(uint64_t));
+    if (mask_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("calloc(%d): %m", (5 + CHAR_COUNT) * word_count * sizeof(uint64_t));
+        return false;
+    }
+
+    filter->word_count = word_count;
+    filter->mask_list = mask_list;
+    filter->start_mask = mask_list;
+    filter->loop_mask = mask_list + word_count;
+    filter->last_mask = mask_list + word_count * 2;
+    filter->include_mask = mask_list + word_count * 3;
+    filter->exclude_mask = mask_list + word_count * 4;
+    filter->char_mask_list = mask_list + word_count * 5;
+    return true;
+}
+
+static uint64_t* get_char_mask(const filter_t *filter, unsigned char c)
+{
+    return filter->char_mask_list + c * filter->word_count;
+}
+
+/* Adds the pattern in [begin, end) with its first state at `state', returns the first state after it. */
+static int compile_pattern(filter_t *filter, const char* begin, const char* end, int state)
+{
+    bool negative = (*begin == NEGATIVE_PREFIX);
+    if (negative)
+        begin++;
+
+    set_state_bit(filter->start_mask, state);
+    const char* c;
+    for (c = begin; c < end; c++)
+    {
+        if (*c == '*')
+        {
+            set_state_bit(filter->loop_mask, state);
+            continue;
+        }
+
+        state++;
+        if (*c == '?')
+        {
+            int i;
+            for (i = 1; i < CHAR_COUNT; i++)
+                set_state_bit(get_char_mask(filter, (unsigned char)i), state);
+        }
+        else
+        {
+            set_state_bit(get_char_mask(filter, (unsigned char)*c), state);
+        }
+    }
+
+    set_state_bit(filter->last_mask, state);
+    set_state_bit(negative ? filter->exclude_mask : filter->include_mask, state);
+    if (!negative)
+        filter->has_include = true;
+    return state + 1;
+}
+
+static bool compile_filter(filter_t *filter, const char* value)
+{
+    memset(filter, 0, sizeof(*filter));
+    if (*value == '\0')
+        return true;
+
+    if (!alloc_filter(filter, count_filter_state(value)))
+        return false;
+
+    int state = 0;
+    const char* begin = value;
+    while (true)
+    {
+        const char* end = strchr(begin, PATTERN_SEPARATOR);
+        if (end == NULL)
+            end = begin + strlen(begin);
+
+        if (end > begin)
+            state = compile_pattern(filter, begin, end, state);
+        if (*end == '\0')
+            break;
+        begin = end + 1;
+    }
+
+    return true;
+}
+
+static bool match_filter(const filter_t *filter, const char* name)
+{
+    if (filter->mask_list == NULL)
+        return true;
+
+    int word_count = filter->word_count;
+    uint64_t state[MAX_FILTER_WORD_COUNT];
+    memcpy(state, filter->start_mask, word_count * sizeof(uint64_t));
+
+    const unsigned char *c;
+    for (c = (const unsigned char*)name; *c != '\0'; c++)
+    {
+        const uint64_t *char_mask = get_char_mask(filter, *c);
+        uint64_t carry = 0;
+        uint64_t active = 0;
+        int i;
+        for (i = 0; i < word_count; i++)
+        {
+            uint64_t moving = state[i] & ~filter->last_mask[i];
+            uint64_t next = (((moving << 1) | carry) & char_mask[i]) | (state[i] & filter->loop_mask[i]);
+            carry = moving >> 63;
+            state[i] = next;
+            active |= next;
+        }
+
+        if (active == 0)
+            return !filter->has_include;
+    }
+
+    bool included = !filter->has_include;
+    int i;
+    for (i = 0; i < word_count; i++)
+    {
+        if ((state[i] & filter->exclude_mask[i]) != 0)
+            return false;
+        if ((state[i] & filter->include_mask[i]) != 0)
+            included = true;
+    }
+    return included;
+}
+
+/* FNV-1a of `suite.case', without building the string. */
+static uint64_t hash_case_name(const char* suite_name, const char* case_name)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const char* c;
+    for (c = suite_name; *c != '\0'; c++)
+        hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+    hash = (hash ^ (unsigned char)'.') * 1099511628211ULL;
+    for (c = case_name; *c != '\0'; c++)
+        hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+    return hash;
+}
+
+static bool is_case_name(const char* name, const char* suite_name, const char* case_name)
+{
+    size_t suite_len = strlen(suite_name);
+    return strncmp(name, suite_name, suite_len) == 0 && name[suite_len] == '.'
+           && strcmp(name + suite_len + 1, case_name) == 0;
+}
+
+static char** find_name_slot(const name_set_t *set, const char* suite_name, const char* case_name)
+{
+    int mask = set->capacity - 1;
+    int index = (int)(hash_case_name(suite_name, case_name) & mask);
+    while (set->name_list[index] != NULL && !is_case_name(set->name_list[index], suite_name, case_name))
+        index = (index + 1) & mask;
+    return &set->name_list[index];
+}
+
+static bool resize_name_set(name_set_t *set, int capacity)
+{
+    char** name_list = (char**)calloc(capacity, sizeof(char*));
+    if (name_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("calloc(%d): %m", capacity * sizeof(char*));
+        return false;
+    }
+
+    name_set_t new_set = {name_list, capacity, set->count};
+    int i;
+    for (i = 0; i < set->capacity; i++)
+    {
+        char* name = set->name_list[i];
+        if (name == NULL)
+            continue;
+
+        /* A stored name is `suite.case' with a non-empty suite, so splitting at its first `.' finds it again. */
+        char* dot = strchr(name, '.');
+        *dot = '\0';
+        *find_name_slot(&new_set, name, dot + 1) = name;
+        *dot = '.';
+    }
+
+    free(set->name_list);
+    *set = new_set;
+    return true;
+}
+
+static bool add_filter_name(name_set_t *set, char* name)
+{
+    char* dot = strchr(name, '.');
+    if (dot == NULL || dot == name)
+    {
+        fprintf(stderr, "line `%s' is not `suite.case'.\n", name);
+        return false;
+    }
+
+    if ((set->count + 1) * 2 > set->capacity
+        && !resize_name_set(set, (set->capacity == 0) ? MIN_NAME_SET_CAPACITY : set->capacity * 2))
+        return false;
+
+    *dot = '\0';
+    char** slot = find_name_slot(set, name, dot + 1);
+    *dot = '.';
+    if (*slot != NULL)
+        return true;
+
+    *slot = strdup(name);
+    if (*slot == NULL)
+    {
+        PRINT_INTERNAL_ERROR("strdup(%s): %m", name);
+        return false;
+    }
+
+    set->count++;
+    return true;
+}
+
+/* One `suite.case' per line, blank lines and lines starting with `#' are skipped. */
+static bool load_filter_file(const char* path, name_set_t *set)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "fopen(%s, r): %m\n", path);
+        return false;
+    }
+
+    bool ret = true;
+    char line[MAX_STR_LEN * 2];
+    while (ret && fgets(line, sizeof(line), file) != NULL)
+    {
+        size_t len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' || line[len - 1] == ' '
+                           || line[len - 1] == '\t'))
+            line[--len] = '\0';
+
+        char* name = line + strspn(line, " \t");
+        if (*name == '\0' || *name == '#')
+            continue;
+
+        ret = add_filter_name(set, name);
+    }
+
+    if (ferror(file))
+    {
+        fprintf(stderr, "fgets(%s): %m\n", path);
+        ret = false;
+    }
+    fclose(file);
+    return ret;
+}
+
+bool init_filters(void)
+{
+    if (!compile_filter(&_suite_filter_, UT_FLAG(suite_filter)))
+        return false;
+    if (!compile_filter(&_case_filter_, UT_FLAG(case_filter)))
+        return false;
+    if (strlen(UT_FLAG(filter_file)) > 0 && !load_filter_file(UT_FLAG(filter_file), &_filter_name_set_))
+        return false;
+    if (strlen(UT_FLAG(quarantine)) > 0 && !load_filter_file(UT_FLAG(quarantine), &_quarantine_name_set_))
+        return false;
+
+    return true;
+}
+
+static void free_name_set(name_set_t *set)
+{
+    int i;
+    for (i = 0; i < set->capacity; i++)
+        free(set->name_list[i]);
+    free(set->name_list);
+    memset(set, 0, sizeof(*set));
+}
+
+void fini_filters(void)
+{
+    free(_suite_filter_.mask_list);
+    free(_case_filter_.mask_list);
+    memset(&_suite_filter_, 0, sizeof(_suite_filter_));
+    memset(&_case_filter_, 0, sizeof(_case_filter_));
+
+    free_name_set(&_filter_name_set_);
+    free_name_set(&_quarantine_name_set_);
+}
+
+static bool has_case_name(const name_set_t *set, const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    return set->count > 0 && *find_name_slot(set, test_suite->name, test_case->name) != NULL;
+}
+
+static bool is_case_listed(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    if (_filter_name_set_.count == 0)
+        return strlen(UT_FLAG(filter_file)) == 0;
+
+    return has_case_name(&_filter_name_set_, test_suite, test_case);
+}
+
+/* With a filter file or changed files, a suite none of whose cases is selected does not run its SUITE_SETUP either. */
+bool is_suite_filtered_out(const test_suite_t *test_suite)
+{
+    if (!match_filter(&_suite_filter_, test_suite->name))
+        return true;
+    if (strlen(UT_FLAG(filter_file)) == 0 && strlen(UT_FLAG(changed_files)) == 0)
+        return false;
+
+    int i;
+    for (i = 0; i < test_suite->case_count; i++)
+    {
+        if (is_case_listed(test_suite, test_suite->case_list[i])
+            && is_case_impacted(test_suite, test_suite->case_list[i]))
+            return false;
+    }
+    return true;
+}
+
+bool is_case_filtered_out(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    return !match_filter(&_case_filter_, test_case->name) || !is_case_listed(test_suite, test_case)
+           || !is_case_impacted(test_suite, test_case);
+}
+
+/* A quarantined case still runs and reports, but its failure fails neither its suite nor the runner. */
+bool is_case_quarantined(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    return has_case_name(&_quarantine_name_set_, test_suite, test_case);
+}
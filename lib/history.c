@@ -0,0 +1,400 @@
+#include "zcut.h"
+
+#include <unistd.h>
+
+#define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
+
+static const char* HISTORY_MAGIC = "zcut-history";
+static const int HISTORY_VERSION = 1;
+static const double MEAN_TIME_WEIGHT = 0.3;
+static const unsigned RECENT_OUTCOME_MASK = 0xff;
+static const double RECENT_FAIL_ORDER_KEY = 2e12;
+static const double NEW_CASE_ORDER_KEY = 1e12;
+static const uint64_t NSEC_PER_SEC = 1000000000ULL;
+
+typedef struct history_t
+{
+    bool            loaded;
+    char            path[PATH_MAX];
+    int             run_count;
+    case_history_t  *case_history_list;
+    int             case_count;
+    int             capacity;
+}history_t;
+
+static history_t _history_;
+static uint64_t _time_budget_deadline_;
+
+static int compare_case_history_name(const void* a, const void* b)
+{
+    return strcmp(((const case_history_t*)a)->name, ((const case_history_t*)b)->name);
+}
+
+static int compare_case_history_mean_time(const void* a, const void* b)
+{
+    const case_history_t *history_a = *(const case_history_t* const*)a;
+    const case_history_t *history_b = *(const case_history_t* const*)b;
+    if (history_a->mean_time != history_b->mean_time)
+        return (history_a->mean_time > history_b->mean_time) ? -1 : 1;
+
+    return strcmp(history_a->name, history_b->name);
+}
+
+static case_history_t* add_case_history(const char* name)
+{
+    if (_history_.case_count == _history_.capacity)
+    {
+        int capacity = (_history_.capacity == 0) ? 256 : _history_.capacity * 2;
+        case_history_t *list = (case_history_t*)realloc(_history_.case_history_list,
+                                                        capacity * sizeof(case_history_t));
+        if (list == NULL)
+        {
+            PRINT_INTERNAL_ERROR("realloc(%d): %m", capacity * sizeof(case_history_t));
+            return NULL;
+        }
+        _history_.case_history_list = list;
+        _history_.capacity = capacity;
+    }
+
+    case_history_t *case_history = &_history_.case_history_list[_history_.case_count];
+    memset(case_history, 0, sizeof(*case_history));
+    case_history->name = strdup(name);
+    if (case_history->name == NULL)
+    {
+        PRINT_INTERNAL_ERROR("strdup(%s): %m", name);
+        return NULL;
+    }
+
+    _history_.case_count++;
+    return case_history;
+}
+
+static void get_history_path(const test_runner_t *test_runner, char path[PATH_MAX])
+{
+    if (strlen(UT_FLAG(history_path)) > 0)
+        snprintf(path, PATH_MAX, "%s", UT_FLAG(history_path));
+    else
+        snprintf(path, PATH_MAX, "%s.history", test_runner->test_bin_name);
+}
+
+static bool read_case_history_list(FILE *file)
+{
+    char line[MAX_STR_LEN * 2];
+    char name[MAX_STR_LEN];
+    case_history_t entry;
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if (sscanf(line, "%1023s %d %d %d %x %lf %lf", name, &entry.run_count, &entry.fail_count,
+                   &entry.last_fail_run, &entry.outcome_bits, &entry.last_time, &entry.mean_time) != 7)
+            continue;
+
+        case_history_t *case_history = add_case_history(name);
+        if (case_history == NULL)
+            return false;
+
+        entry.name = case_history->name;
+        *case_history = entry;
+    }
+
+    qsort(_history_.case_history_list, _history_.case_count, sizeof(case_history_t), compare_case_history_name);
+    return true;
+}
+
+bool load_case_history(const test_runner_t *test_runner)
+{
+    get_history_path(test_runner, _history_.path);
+    _history_.loaded = true;
+
+    FILE *file = fopen(_history_.path, "r");
+    if (file == NULL)
+        return true;
+
+    char magic[64];
+    int version = 0;
+    bool ret = true;
+    if (fscanf(file, "%63s %d %d\n", magic, &version, &_history_.run_count) == 3
+        && strcmp(magic, HISTORY_MAGIC) == 0 && version == HISTORY_VERSION)
+        ret = read_case_history_list(file);
+    else
+        _history_.run_count = 0;
+
+    fclose(file);
+    return ret;
+}
+
+const case_history_t* find_case_history(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    if (_history_.case_count == 0)
+        return NULL;
+
+    char name[MAX_STR_LEN];
+    snprintf(name, sizeof(name), "%s.%s", test_suite->name, test_case->name);
+    case_history_t key;
+    key.name = name;
+    return (const case_history_t*)bsearch(&key, _history_.case_history_list, _history_.case_count,
+                                          sizeof(case_history_t), compare_case_history_name);
+}
+
+static void update_one_case_history(case_history_t *case_history, const case_result_t *result)
+{
+    double time = result->time / 1e6;
+    case_history->mean_time = (case_history->run_count == 0)
+                              ? time : (1 - MEAN_TIME_WEIGHT) * case_history->mean_time + MEAN_TIME_WEIGHT * time;
+    case_history->last_time = time;
+    case_history->run_count++;
+    case_history->outcome_bits <<= 1;
+    if (!result->passed)
+    {
+        case_history->fail_count++;
+        case_history->last_fail_run = _history_.run_count;
+        case_history->outcome_bits |= 1;
+    }
+}
+
+static case_history_t* get_or_add_case_history(const char* name, int sorted_count)
+{
+    case_history_t key;
+    key.name = (char*)name;
+    case_history_t *case_history = (case_history_t*)bsearch(&key, _history_.case_history_list, sorted_count,
+                                                            sizeof(case_history_t), compare_case_history_name);
+    if (case_history != NULL)
+        return case_history;
+
+    int i;
+    for (i = sorted_count; i < _history_.case_count; i++)
+    {
+        if (strcmp(_history_.case_history_list[i].name, name) == 0)
+            return &_history_.case_history_list[i];
+    }
+
+    return add_case_history(name);
+}
+
+void update_case_history(const test_runner_t *test_runner)
+{
+    if (!_history_.loaded)
+        return;
+
+    _history_.run_count++;
+    int sorted_count = _history_.case_count;
+    int i;
+    for (i = 0; i < test_runner->suite_count; i++)
+    {
+        const test_suite_t *test_suite = test_runner->suite_list[i];
+        int j;
+        for (j = 0; j < test_suite->case_count; j++)
+        {
+            const test_case_t *test_case = test_suite->case_list[j];
+            const case_result_t *result = test_case->result;
+            if (!result->accessed || result->is_filtered_out)
+                continue;
+
+            char name[MAX_STR_LEN];
+            snprintf(name, sizeof(name), "%s.%s", test_suite->name, test_case->name);
+            case_history_t *case_history = get_or_add_case_history(name, sorted_count);
+            if (case_history != NULL)
+                update_one_case_history(case_history, result);
+        }
+    }
+
+    qsort(_history_.case_history_list, _history_.case_count, sizeof(case_history_t), compare_case_history_name);
+}
+
+bool save_case_history(void)
+{
+    if (!_history_.loaded)
+        return true;
+
+    char tmp_path[PATH_MAX + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", _history_.path, (int)getpid());
+    FILE *file = fopen(tmp_path, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "fopen(%s, w): %m\n", tmp_path);
+        return false;
+    }
+
+    fprintf(file, "%s %d %d\n", HISTORY_MAGIC, HISTORY_VERSION, _history_.run_count);
+    int i;
+    for (i = 0; i < _history_.case_count; i++)
+    {
+        const case_history_t *case_history = &_history_.case_history_list[i];
+        fprintf(file, "%s %d %d %d %x %.6f %.6f\n", case_history->name, case_history->run_count,
+                case_history->fail_count, case_history->last_fail_run, case_history->outcome_bits,
+                case_history->last_time, case_history->mean_time);
+    }
+
+    bool ret = (fflush(file) == 0 && fsync(fileno(file)) == 0);
+    if (fclose(file) != 0)
+        ret = false;
+    if (!ret || rename(tmp_path, _history_.path) == -1)
+    {
+        fprintf(stderr, "write history %s: %m\n", _history_.path);
+        unlink(tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+void free_case_history(void)
+{
+    int i;
+    for (i = 0; i < _history_.case_count; i++)
+        free(_history_.case_history_list[i].name);
+    free(_history_.case_history_list);
+    memset(&_history_, 0, sizeof(_history_));
+}
+
+void print_slowest_case_history(int count)
+{
+    if (count <= 0 || _history_.case_count == 0)
+        return;
+
+    const case_history_t* *sorted_list = (const case_history_t**)malloc(_history_.case_count *
+                                                                          sizeof(case_history_t*));
+    if (sorted_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("malloc(%d): %m", _history_.case_count * sizeof(case_history_t*));
+        return;
+    }
+
+    int i;
+    for (i = 0; i < _history_.case_count; i++)
+        sorted_list[i] = &_history_.case_history_list[i];
+    qsort(sorted_list, _history_.case_count, sizeof(case_history_t*), compare_case_history_mean_time);
+
+    print_slowest_case_list(sorted_list, count < _history_.case_count ? count : _history_.case_count);
+    free(sorted_list);
+}
+
+/*
+ * Value first, for --time-budget: cases which failed in the last 8 runs, the latest failure on top, then cases
+ * without history, new or renamed since, then the others cheapest first, which fits the most cases in.
+ */
+static double get_case_value_order_key(const case_history_t *case_history)
+{
+    if (case_history == NULL)
+        return NEW_CASE_ORDER_KEY;
+    if ((case_history->outcome_bits & RECENT_OUTCOME_MASK) != 0)
+        return RECENT_FAIL_ORDER_KEY + case_history->last_fail_run;
+    return -case_history->mean_time;
+}
+
+/*
+ * Ordering keys, larger runs first. Longest first helps the worker pools finish together, failed first gives the
+ * fastest feedback on a fix.
+ */
+static double get_case_order_key(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    const case_history_t *case_history = find_case_history(test_suite, test_case);
+    if (UT_FLAG(order) == VALUE_ORDER)
+        return get_case_value_order_key(case_history);
+
+    if (case_history == NULL)
+        return (UT_FLAG(order) == LONGEST_FIRST_ORDER) ? 0 : -1;
+
+    if (UT_FLAG(order) == LONGEST_FIRST_ORDER)
+        return case_history->mean_time;
+
+    return (case_history->fail_count > 0) ? case_history->last_fail_run : -1;
+}
+
+typedef struct order_item_t
+{
+    void*   item;
+    int     index;
+    double  key;
+}order_item_t;
+
+static int compare_order_item(const void* a, const void* b)
+{
+    const order_item_t *item_a = (const order_item_t*)a;
+    const order_item_t *item_b = (const order_item_t*)b;
+    if (item_a->key != item_b->key)
+        return (item_a->key > item_b->key) ? -1 : 1;
+
+    return item_a->index - item_b->index;
+}
+
+static void sort_order_item_list(order_item_t *item_list, void** list, int count)
+{
+    qsort(item_list, count, sizeof(order_item_t), compare_order_item);
+
+    int i;
+    for (i = 0; i < count; i++)
+        list[i] = item_list[i].item;
+}
+
+static double order_suite_case_list(test_suite_t *test_suite, order_item_t *item_list)
+{
+    double suite_key = (UT_FLAG(order) == LONGEST_FIRST_ORDER) ? 0 : -1;
+    int i;
+    for (i = 0; i < test_suite->case_count; i++)
+    {
+        item_list[i].item = test_suite->case_list[i];
+        item_list[i].index = i;
+        item_list[i].key = get_case_order_key(test_suite, test_suite->case_list[i]);
+        if (UT_FLAG(order) == LONGEST_FIRST_ORDER)
+            suite_key += item_list[i].key;
+        else if (item_list[i].key > suite_key || (i == 0 && UT_FLAG(order) == VALUE_ORDER))
+            suite_key = item_list[i].key;
+    }
+
+    sort_order_item_list(item_list, (void**)test_suite->case_list, test_suite->case_count);
+    return suite_key;
+}
+
+bool order_test_runner(test_runner_t *test_runner)
+{
+    int max_count = test_runner->suite_count;
+    int i;
+    for (i = 0; i < test_runner->suite_count; i++)
+    {
+        if (test_runner->suite_list[i]->case_count > max_count)
+            max_count = test_runner->suite_list[i]->case_count;
+    }
+
+    order_item_t *item_list = (order_item_t*)malloc((max_count + 1) * sizeof(order_item_t));
+    order_item_t *suite_item_list = (order_item_t*)malloc((test_runner->suite_count + 1) * sizeof(order_item_t));
+    if (item_list == NULL || suite_item_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("malloc(%d): %m", (max_count + 1) * sizeof(order_item_t));
+        free(item_list);
+        free(suite_item_list);
+        return false;
+    }
+
+    for (i = 0; i < test_runner->suite_count; i++)
+    {
+        suite_item_list[i].item = test_runner->suite_list[i];
+        suite_item_list[i].index = i;
+        suite_item_list[i].key = order_suite_case_list(test_runner->suite_list[i], item_list);
+    }
+    sort_order_item_list(suite_item_list, (void**)test_runner->suite_list, test_runner->suite_count);
+
+    free(item_list);
+    free(suite_item_list);
+    return true;
+}
+
+/* The mean duration of the case by history, 0 when it has none. */
+uint64_t get_case_expected_time(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    const case_history_t *case_history = find_case_history(test_suite, test_case);
+    return (case_history != NULL) ? (uint64_t)(case_history->mean_time * 1e6) : 0;
+}
+
+void begin_time_budget(void)
+{
+    _time_budget_deadline_ = get_monotonic_time() + (uint64_t)UT_FLAG(time_budget) * NSEC_PER_SEC;
+}
+
+/*
+ * A case starts only if it is expected to end within the budget. Later cases are still tried, a cheaper one may
+ * fit; a case without history is expected to take no time.
+ */
+bool fits_time_budget(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    return get_monotonic_time() + get_case_expected_time(test_suite, test_case) <= _time_budget_deadline_;
+}
@@ -0,0 +1,203 @@
+#include "zcut.h"
+
+/*
+ * JSON Lines, one object per event in the order of the run, for tools which follow a run as it goes. The file is
+ * flushed after every failed case.
+ */
+typedef struct json_report_t
+{
+    char    path[MAX_STR_LEN];
+    FILE    *file;
+}json_report_t;
+
+static json_report_t _json_report_;
+
+static const char* const TEST_TYPE_NAME_LIST[] =
+{
+    "runner",
+    "suite",
+    "case"
+};
+
+static double get_time_ms(uint64_t time)
+{
+    return time / 1000000.0;
+}
+
+static void write_json_event(FILE *file, const char* event)
+{
+    fprintf(file, "{\"event\":\"%s\"", event);
+}
+
+static void write_json_str_field(FILE *file, const char* name, const char* value)
+{
+    fprintf(file, ",\"%s\":", name);
+    write_report_str(file, value);
+}
+
+static bool init_json_report(const char* path)
+{
+    snprintf(_json_report_.path, sizeof(_json_report_.path), "%s", path);
+    return true;
+}
+
+static void fini_json_report(void)
+{
+    if (_json_report_.file != NULL)
+        close_report_file(_json_report_.file);
+    _json_report_.file = NULL;
+}
+
+static void begin_json_runner(const test_runner_t *test_runner, int repeat)
+{
+    FILE *file = open_report_file(_json_report_.path, ".jsonl", test_runner, repeat);
+    _json_report_.file = file;
+    if (file == NULL)
+        return;
+
+    write_json_event(file, "runner_begin");
+    write_json_str_field(file, "runner", test_runner->name);
+    fprintf(file, ",\"repeat\":%d}\n", repeat);
+}
+
+static void end_json_runner(const test_runner_t *test_runner)
+{
+    FILE *file = _json_report_.file;
+    if (file == NULL)
+        return;
+
+    write_json_event(file, "runner_end");
+    write_json_str_field(file, "runner", test_runner->name);
+    fprintf(file, "}\n");
+}
+
+static bool write_json_runner_result(const test_runner_t *test_runner)
+{
+    FILE *file = _json_report_.file;
+    if (file == NULL)
+        return false;
+
+    const runner_result_t *result = test_runner->result;
+    write_json_event(file, "runner_result");
+    write_json_str_field(file, "runner", test_runner->name);
+    fprintf(file, ",\"accessed\":%s,\"passed\":%s,\"suite\":%d,\"failed_suite\":%d,\"skipped_suite\":%d,"
+            "\"case\":%d,\"failed_case\":%d,\"skipped_case\":%d,\"filtered_out_case\":%d,\"flaky_case\":%d,"
+            "\"quarantined_case\":%d,\"assertion\":%d,\"time_ms\":%.6f}\n", result->accessed ? "true" : "false",
+            result->passed ? "true" : "false", result->suite_count, result->fail_suite_count, result->skip_suite_count,
+            result->case_count, result->fail_case_count, result->skip_case_count, result->filtered_out_case_count,
+            result->flaky_case_count, result->quarantined_case_count, result->assertion_count,
+            get_time_ms(result->time));
+
+    bool ret = close_report_file(file);
+    _json_report_.file = NULL;
+    return ret;
+}
+
+static void begin_json_suite(const test_suite_t *test_suite)
+{
+    FILE *file = _json_report_.file;
+    if (file == NULL)
+        return;
+
+    write_json_event(file, "suite_begin");
+    write_json_str_field(file, "suite", test_suite->name);
+    fprintf(file, "}\n");
+}
+
+static void end_json_suite(const test_suite_t *test_suite, const suite_result_t *result)
+{
+    FILE *file = _json_report_.file;
+    if (file == NULL)
+        return;
+
+    write_json_event(file, "suite_end");
+    write_json_str_field(file, "suite", test_suite->name);
+    fprintf(file, ",\"passed\":%s,\"assertion\":%d,\"time_ms\":%.6f}\n", result->passed ? "true" : "false",
+            result->assertion_count, get_time_ms(result->time));
+}
+
+static void begin_json_case(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    FILE *file = _json_report_.file;
+    if (file == NULL)
+        return;
+
+    write_json_event(file, "case_begin");
+    write_json_str_field(file, "suite", test_suite->name);
+    write_json_str_field(file, "case", test_case->name);
+    fprintf(file, "}\n");
+}
+
+static void write_json_assertion_failure(const assertion_failure_t *failure)
+{
+    FILE *file = _json_report_.file;
+    if (file == NULL)
+        return;
+
+    write_json_event(file, "assertion_failure");
+    write_json_str_field(file, "file", failure->file);
+    fprintf(file, ",\"line\":%d", failure->line);
+    write_json_str_field(file, "expected", failure->expected);
+    write_json_str_field(file, "actual", failure->actual);
+    write_json_str_field(file, "user_msg", failure->user_msg);
+    fprintf(file, "}\n");
+}
+
+static void end_json_case(const test_suite_t *test_suite, const test_case_t *test_case, const case_result_t *result)
+{
+    FILE *file = _json_report_.file;
+    if (file == NULL)
+        return;
+
+    write_json_event(file, "case_end");
+    write_json_str_field(file, "suite", test_suite->name);
+    write_json_str_field(file, "case", test_case->name);
+    fprintf(file, ",\"passed\":%s,\"flaky\":%s,\"quarantined\":%s,\"timed_out\":%s,\"crashed\":%s,\"retry\":%d,"
+            "\"assertion\":%d,\"failed_assertion\":%d,\"time_ms\":%.6f,\"alloc_count\":%llu,\"leaked_bytes\":%llu}\n",
+            result->passed ? "true" : "false", result->is_flaky ? "true" : "false",
+            result->is_quarantined ? "true" : "false", result->is_timed_out ? "true" : "false",
+            result->is_crashed ? "true" : "false", result->retry_count,
+            result->assertion_count, result->fail_assertion_count, get_time_ms(result->time),
+            (unsigned long long)result->alloc_count, (unsigned long long)result->unfreed_alloc_bytes);
+    if (!result->passed)
+        fflush(file);
+}
+
+static void write_json_setup_teardown_end(const char* event, test_type_t test_type, bool passed, uint64_t time)
+{
+    FILE *file = _json_report_.file;
+    if (file == NULL)
+        return;
+
+    write_json_event(file, event);
+    fprintf(file, ",\"type\":\"%s\",\"passed\":%s,\"time_ms\":%.6f}\n", TEST_TYPE_NAME_LIST[test_type],
+            passed ? "true" : "false", get_time_ms(time));
+}
+
+static void end_json_setup(test_type_t test_type, bool passed, uint64_t time)
+{
+    write_json_setup_teardown_end("setup_end", test_type, passed, time);
+}
+
+static void end_json_teardown(test_type_t test_type, bool passed, uint64_t time)
+{
+    write_json_setup_teardown_end("teardown_end", test_type, passed, time);
+}
+
+const reporter_t JSON_REPORTER =
+{
+    .name               = "json",
+    .background         = true,
+    .init               = init_json_report,
+    .fini               = fini_json_report,
+    .runner_begin       = begin_json_runner,
+    .runner_end         = end_json_runner,
+    .runner_result      = write_json_runner_result,
+    .suite_begin        = begin_json_suite,
+    .suite_end          = end_json_suite,
+    .case_begin         = begin_json_case,
+    .assertion_failure  = write_json_assertion_failure,
+    .case_end           = end_json_case,
+    .setup_end          = end_json_setup,
+    .teardown_end       = end_json_teardown
+};
@@ -0,0 +1,298 @@
+#define _GNU_SOURCE
+#include "zcut.h"
+
+#define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
+
+static const int INDENT = 2;
+
+/*
+ * JUnit XML as read by CI servers. The counts of a <testsuite> are attributes of its opening tag, so the cases of
+ * the running suite collect in a memory stream and the suite is written out whole at its end. Cases of a suite
+ * which did not report, filtered out or skipped after a failed setup, are written as skipped.
+ */
+typedef struct junit_report_t
+{
+    char                path[MAX_STR_LEN];
+    FILE                *file;
+    FILE                *suite_stream;
+    char                *suite_buffer;
+    size_t              suite_buffer_len;
+    bool                *reported_case_list;
+    int                 reported_case_capacity;
+    int                 test_count;
+    int                 failure_count;
+    int                 skipped_count;
+    bool                failed;
+}junit_report_t;
+
+static junit_report_t _junit_report_;
+
+static double get_time_s(uint64_t time)
+{
+    return time / 1000000000.0;
+}
+
+static void write_junit_escaped(FILE *file, const char* string)
+{
+    while (*string)
+    {
+        size_t len = strcspn(string, "<>&'\"");
+        fwrite(string, 1, len, file);
+        string += len;
+
+        switch (*string)
+        {
+        case '<':
+            fputs("&lt;", file);
+            break;
+        case '>':
+            fputs("&gt;", file);
+            break;
+        case '&':
+            fputs("&amp;", file);
+            break;
+        case '\'':
+            fputs("&apos;", file);
+            break;
+        case '\"':
+            fputs("&quot;", file);
+            break;
+        default:
+            return;
+        }
+
+        string++;
+    }
+}
+
+static void write_junit_attr(FILE *file, const char* name, const char* value)
+{
+    fprintf(file, " %s=\"", name);
+    write_junit_escaped(file, value);
+    fputc('\"', file);
+}
+
+static bool init_junit_report(const char* path)
+{
+    snprintf(_junit_report_.path, sizeof(_junit_report_.path), "%s", path);
+    return true;
+}
+
+static void fini_junit_report(void)
+{
+    junit_report_t *report = &_junit_report_;
+    if (report->suite_stream != NULL)
+        fclose(report->suite_stream);
+    free(report->suite_buffer);
+    report->suite_stream = NULL;
+    report->suite_buffer = NULL;
+
+    free(report->reported_case_list);
+    report->reported_case_list = NULL;
+    report->reported_case_capacity = 0;
+
+    if (report->file != NULL)
+        close_report_file(report->file);
+    report->file = NULL;
+}
+
+static void begin_junit_runner(const test_runner_t *test_runner, int repeat)
+{
+    junit_report_t *report = &_junit_report_;
+    report->file = open_report_file(report->path, ".junit.xml", test_runner, repeat);
+    report->failed = report->file == NULL;
+    if (report->file == NULL)
+        return;
+
+    fprintf(report->file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites");
+    write_junit_attr(report->file, "name", test_runner->name);
+    fprintf(report->file, ">\n");
+}
+
+static bool reset_reported_case_list(int case_count)
+{
+    junit_report_t *report = &_junit_report_;
+    if (case_count > report->reported_case_capacity)
+    {
+        bool *reported_case_list = (bool*)realloc(report->reported_case_list, case_count * sizeof(bool));
+        if (reported_case_list == NULL)
+        {
+            PRINT_INTERNAL_ERROR("realloc(%d): %m", case_count * sizeof(bool));
+            return false;
+        }
+        report->reported_case_list = reported_case_list;
+        report->reported_case_capacity = case_count;
+    }
+
+    memset(report->reported_case_list, 0, case_count * sizeof(bool));
+    return true;
+}
+
+static void begin_junit_suite(const test_suite_t *test_suite)
+{
+    junit_report_t *report = &_junit_report_;
+    if (report->file == NULL)
+        return;
+
+    if (!reset_reported_case_list(test_suite->case_count))
+    {
+        report->failed = true;
+        return;
+    }
+
+    report->suite_stream = open_memstream(&report->suite_buffer, &report->suite_buffer_len);
+    if (report->suite_stream == NULL)
+    {
+        PRINT_INTERNAL_ERROR("open_memstream(): %m");
+        report->failed = true;
+        return;
+    }
+
+    report->test_count = 0;
+    report->failure_count = 0;
+    report->skipped_count = 0;
+}
+
+static void mark_case_reported(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    bool *reported_case_list = _junit_report_.reported_case_list;
+    int i;
+    for (i = 0; i < test_suite->case_count; i++)
+    {
+        if (test_suite->case_list[i] == test_case && !reported_case_list[i])
+        {
+            reported_case_list[i] = true;
+            return;
+        }
+    }
+}
+
+static void write_junit_case_begin(FILE *stream, const test_suite_t *test_suite, const test_case_t *test_case,
+                                   uint64_t time)
+{
+    fprintf(stream, "%*c<testcase", INDENT * 2, ' ');
+    write_junit_attr(stream, "classname", test_suite->name);
+    write_junit_attr(stream, "name", test_case->name);
+    fprintf(stream, " time=\"%.6f\"", get_time_s(time));
+}
+
+static void write_junit_failure(FILE *stream, const assertion_failure_t *failure, const char* type)
+{
+    fprintf(stream, "%*c<failure", INDENT * 3, ' ');
+    write_junit_attr(stream, "message", (strlen(failure->user_msg) > 0) ? failure->user_msg : "assertion failed");
+    fprintf(stream, " type=\"%s\">", type);
+    fprintf(stream, "%s: %d", failure->file, failure->line);
+    if (strlen(failure->expected) > 0)
+    {
+        fprintf(stream, "\nexpected: ");
+        write_junit_escaped(stream, failure->expected);
+    }
+    if (strlen(failure->actual) > 0)
+    {
+        fprintf(stream, "\nactual: ");
+        write_junit_escaped(stream, failure->actual);
+    }
+    fprintf(stream, "</failure>\n");
+}
+
+static void end_junit_case(const test_suite_t *test_suite, const test_case_t *test_case,
+                           const case_result_t *result)
+{
+    junit_report_t *report = &_junit_report_;
+    FILE *stream = report->suite_stream;
+    if (stream == NULL)
+        return;
+
+    mark_case_reported(test_suite, test_case);
+    report->test_count++;
+    write_junit_case_begin(stream, test_suite, test_case, result->time);
+    if (result->passed)
+    {
+        fprintf(stream, "/>\n");
+        return;
+    }
+
+    /* A quarantined failure must not fail the CI job, it is reported as skipped. */
+    if (result->is_quarantined)
+    {
+        report->skipped_count++;
+        fprintf(stream, ">\n%*c<skipped message=\"quarantined\"/>\n%*c</testcase>\n", INDENT * 3, ' ',
+                INDENT * 2, ' ');
+        return;
+    }
+
+    report->failure_count++;
+    fprintf(stream, ">\n");
+    /* The watchdog adds the timeout, and crash recovery the signal, as the last failure of the case. */
+    const char* last_type = result->is_timed_out ? "timeout" : (result->is_crashed ? "crash" : "assertion");
+    const assertion_failure_t *failure;
+    for (failure = result->failure_list; failure != NULL; failure = failure->next)
+        write_junit_failure(stream, failure, (failure->next == NULL) ? last_type : "assertion");
+    if (result->failure_list == NULL)
+        fprintf(stream, "%*c<failure message=\"case failed\" type=\"assertion\"/>\n", INDENT * 3, ' ');
+    fprintf(stream, "%*c</testcase>\n", INDENT * 2, ' ');
+}
+
+static void end_junit_suite(const test_suite_t *test_suite, const suite_result_t *result)
+{
+    junit_report_t *report = &_junit_report_;
+    FILE *stream = report->suite_stream;
+    if (stream == NULL)
+        return;
+
+    int skipped_count = 0;
+    int i;
+    for (i = 0; i < test_suite->case_count; i++)
+    {
+        if (report->reported_case_list[i])
+            continue;
+
+        skipped_count++;
+        write_junit_case_begin(stream, test_suite, test_suite->case_list[i], 0);
+        fprintf(stream, ">\n%*c<skipped/>\n%*c</testcase>\n", INDENT * 3, ' ', INDENT * 2, ' ');
+    }
+
+    report->suite_stream = NULL;
+    if (fclose(stream) != 0)
+    {
+        PRINT_INTERNAL_ERROR("fclose(memstream): %m");
+        report->failed = true;
+    }
+
+    fprintf(report->file, "%*c<testsuite", INDENT, ' ');
+    write_junit_attr(report->file, "name", test_suite->name);
+    fprintf(report->file, " tests=\"%d\" failures=\"%d\" errors=\"0\" skipped=\"%d\" time=\"%.6f\">\n",
+            report->test_count + skipped_count, report->failure_count, report->skipped_count + skipped_count,
+            get_time_s(result->time));
+    if (report->suite_buffer != NULL)
+        fwrite(report->suite_buffer, 1, report->suite_buffer_len, report->file);
+    fprintf(report->file, "%*c</testsuite>\n", INDENT, ' ');
+
+    free(report->suite_buffer);
+    report->suite_buffer = NULL;
+}
+
+static bool end_junit_runner(const test_runner_t *test_runner ATTRIBUTE_UNUSED)
+{
+    junit_report_t *report = &_junit_report_;
+    if (report->file == NULL)
+        return !report->failed;
+
+    fprintf(report->file, "</testsuites>\n");
+    bool ret = close_report_file(report->file);
+    report->file = NULL;
+    return ret && !report->failed;
+}
+
+const reporter_t JUNIT_REPORTER =
+{
+    .name           = "junit",
+    .background     = true,
+    .init           = init_junit_report,
+    .fini           = fini_junit_report,
+    .runner_begin   = begin_junit_runner,
+    .runner_result  = end_junit_runner,
+    .suite_begin    = begin_junit_suite,
+    .suite_end      = end_junit_suite,
+    .case_end       = end_junit_case
+};
@@ -0,0 +1,220 @@
+#define _GNU_SOURCE
+#include "zcut.h"
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+int UT_FLAG(perf_counters);
+
+static const char* const PERF_COUNTER_NAME_LIST[] =
+{
+    "cycles",
+    "instructions",
+    "cache-misses",
+    "branch-misses"
+};
+static const uint64_t PERF_COUNTER_CONFIG_LIST[] =
+{
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+/*
+ * One counter group per thread, opened on its first case and counting user space of that thread only, which is
+ * what perf_event_paranoid 2 still allows. Counters which cannot be opened are left out of the group.
+ */
+typedef struct perf_counter_group_t
+{
+    bool    opened;
+    int     leader_fd;
+    int     fd_list[PERF_COUNTER_COUNT];
+    int     read_index_list[PERF_COUNTER_COUNT];
+    int     open_count;
+    int     open_mask;
+}perf_counter_group_t;
+
+typedef struct perf_counter_read_t
+{
+    uint64_t    count;
+    uint64_t    time_enabled;
+    uint64_t    time_running;
+    uint64_t    value_list[PERF_COUNTER_COUNT];
+}perf_counter_read_t;
+
+static __thread perf_counter_group_t _perf_counter_group_;
+static int _is_perf_counter_warned_;
+
+bool parse_perf_counters(const char* value, int *mask)
+{
+    char counter_list[MAX_STR_LEN];
+    snprintf(counter_list, sizeof(counter_list), "%s", value);
+
+    int counter_mask = 0;
+    char* save_ptr = NULL;
+    char* name;
+    for (name = strtok_r(counter_list, ",", &save_ptr); name != NULL; name = strtok_r(NULL, ",", &save_ptr))
+    {
+        int i;
+        for (i = 0; i < PERF_COUNTER_COUNT; i++)
+        {
+            if (strcmp(name, PERF_COUNTER_NAME_LIST[i]) == 0)
+                break;
+        }
+        if (i == PERF_COUNTER_COUNT)
+            return false;
+
+        counter_mask |= 1 << i;
+    }
+
+    if (counter_mask == 0)
+        return false;
+
+    *mask = counter_mask;
+    return true;
+}
+
+const char* get_perf_counter_name(perf_counter_t counter)
+{
+    return PERF_COUNTER_NAME_LIST[counter];
+}
+
+static void warn_perf_counter_unavailable(perf_counter_t counter)
+{
+    if (!__sync_bool_compare_and_swap(&_is_perf_counter_warned_, 0, 1))
+        return;
+
+    fprintf(stderr, "perf counter `%s' is unavailable: %m, see /proc/sys/kernel/perf_event_paranoid\n",
+            PERF_COUNTER_NAME_LIST[counter]);
+}
+
+static int open_perf_counter(perf_counter_t counter, int group_fd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNTER_CONFIG_LIST[counter];
+    attr.disabled = (group_fd == -1);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+static void open_perf_counter_group(perf_counter_group_t *group)
+{
+    group->opened = true;
+    group->leader_fd = -1;
+
+    int i;
+    for (i = 0; i < PERF_COUNTER_COUNT; i++)
+    {
+        group->fd_list[i] = -1;
+        if ((UT_FLAG(perf_counters) & (1 << i)) == 0)
+            continue;
+
+        int fd = open_perf_counter((perf_counter_t)i, group->leader_fd);
+        if (fd == -1)
+        {
+            warn_perf_counter_unavailable((perf_counter_t)i);
+            continue;
+        }
+
+        if (group->leader_fd == -1)
+            group->leader_fd = fd;
+        group->fd_list[i] = fd;
+        group->read_index_list[i] = group->open_count++;
+        group->open_mask |= 1 << i;
+    }
+}
+
+static perf_counter_group_t* get_perf_counter_group(void)
+{
+    perf_counter_group_t *group = &_perf_counter_group_;
+    if (UT_FLAG(perf_counters) == 0)
+        return NULL;
+
+    if (!group->opened)
+        open_perf_counter_group(group);
+
+    return (group->leader_fd == -1) ? NULL : group;
+}
+
+/* Counters are multiplexed when the PMU is short of registers, scale them up to the enabled time. */
+static bool read_perf_counter_group(const perf_counter_group_t *group, uint64_t value_list[PERF_COUNTER_COUNT])
+{
+    perf_counter_read_t data;
+    ssize_t len = read(group->leader_fd, &data, sizeof(data));
+    if (len < (ssize_t)(3 * sizeof(uint64_t)) || (int)data.count != group->open_count)
+        return false;
+
+    double scale = (data.time_running > 0 && data.time_running < data.time_enabled)
+                   ? (double)data.time_enabled / data.time_running : 1;
+    int i;
+    for (i = 0; i < PERF_COUNTER_COUNT; i++)
+    {
+        value_list[i] = ((group->open_mask & (1 << i)) != 0)
+                        ? (uint64_t)(data.value_list[group->read_index_list[i]] * scale) : 0;
+    }
+
+    return true;
+}
+
+void begin_perf_counters(void)
+{
+    perf_counter_group_t *group = get_perf_counter_group();
+    if (group == NULL)
+        return;
+
+    ioctl(group->leader_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(group->leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void end_perf_counters(case_result_t *result)
+{
+    perf_counter_group_t *group = get_perf_counter_group();
+    if (group == NULL)
+        return;
+
+    ioctl(group->leader_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    if (read_perf_counter_group(group, result->perf_counter_list))
+        result->perf_counter_mask = group->open_mask;
+}
+
+bool is_perf_counter_open(perf_counter_t counter)
+{
+    perf_counter_group_t *group = get_perf_counter_group();
+    return group != NULL && (group->open_mask & (1 << counter)) != 0;
+}
+
+uint64_t read_perf_counter(perf_counter_t counter)
+{
+    perf_counter_group_t *group = get_perf_counter_group();
+    uint64_t value_list[PERF_COUNTER_COUNT];
+    if (group == NULL || !read_perf_counter_group(group, value_list))
+        return 0;
+
+    return value_list[counter];
+}
+
+/* Also called by a forked worker, whose inherited descriptors still count the parent thread. */
+void close_perf_counters(void)
+{
+    perf_counter_group_t *group = &_perf_counter_group_;
+    if (!group->opened)
+        return;
+
+    int i;
+    for (i = 0; i < PERF_COUNTER_COUNT; i++)
+    {
+        if (group->fd_list[i] != -1)
+            close(group->fd_list[i]);
+    }
+    memset(group, 0, sizeof(*group));
+}
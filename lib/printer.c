@@ -1,17 +1,20 @@
 #include "zcut.h"
 
 #include <stdarg.h>
-#include <sys/stat.h>
 #include <unistd.h>
 
 #define COLOR_FORMAT        "\033[%d;3%dm"
 #define UNDERLINE_FORMAT    "\033[4m"
 #define RESET_COLOR_FORMAT  "\033[0m"
+#define CLEAR_LINE_FORMAT   "\r\033[K"
+#define TIME_STR_LEN        32
+#define CONSOLE_BUFFER_SIZE (256 * 1024)
 
 bool UT_FLAG(no_color);
 bool UT_FLAG(no_filtered_out_result);
 bool UT_FLAG(highlight);
-char UT_FLAG(xml_path)[MAX_STR_LEN];
+bool UT_FLAG(progress);
+bool UT_FLAG(quiet);
 
 static char* const COLOR_TERM_LIST[] =
 {
@@ -42,13 +45,19 @@ static char* USER_MESSAGE_LABEL = "user message";
 static char* PASSED_LABEL       = "   PASSED   ";
 static char* FAILED_LABEL       = "   FAILED   ";
 static char* TIME_LABEL         = "    TIME    ";
+static char* SLOWEST_LABEL      = "  SLOWEST   ";
+static char* REPEAT_LABEL       = "   REPEAT   ";
+static char* FLAKY_LABEL        = "   FLAKY    ";
+static char* QUARANTINED_LABEL  = "QUARANTINED ";
+static char* TIMED_OUT_LABEL    = " TIMED OUT  ";
+static char* CRASHED_LABEL      = "  CRASHED   ";
+static char* BUDGET_LABEL       = "   BUDGET   ";
+static char* BENCHMARK_LABEL    = " BENCHMARK  ";
+static char* PERF_LABEL         = "    PERF    ";
+static char* ALLOC_LABEL        = "   ALLOC    ";
 static char* RUNNER_NAME        = "Runner";
 static char* SUITE_NAME         = "Suite";
 static char* CASE_NAME          = "Case";
-static char* SKIPPED            = "SKIPPED";
-static char* FILTERED_OUT       = "FILTERED_OUT";
-static char* PASSED             = "PASSED";
-static char* FAILED             = "FAILED";
 
 static char** const LABEL_LIST[] =
 {
@@ -68,31 +77,82 @@ static char** const TEST_TYPE_NAME_LIST[] =
 static char* ZCUT       = "zCUT";
 static char* VERSION    = "0";
 static char* HELP = \
-"Usage: test_bin [-bC] [-fF FILTER_EXPRESSION] [-Hkl] [-r REPEAT_COUNT] [-s] [-x [XML_PATH]] [-hv]\n"
+"Usage: test_bin [-bC] [-fF FILTER_EXPRESSION] [-H] [-j JOBS] [-klq] [-r REPEAT_COUNT] [-s] [-t THREADS] [-x [XML_PATH]] [-hv]\n"
 "  -b, --break-on-failure           Exit unit test when a assertion failed.\n"
 "  -C, --no-color                   Disabled colored output. Default is enabled.\n"
-"  -f, --case-filter                Choose test case to run with simple regular expression.\n"
-"  -F, --suite-filter               Choose test suite to run with simple regular expression.\n"
+"  -f, --case-filter                Choose test cases to run by `:' separated globs, a `-' glob excludes.\n"
+"  -F, --suite-filter               Choose test suites to run by `:' separated globs, a `-' glob excludes.\n"
 "  -H, --highlight                  Enable highlighted output. Default is disabled.\n"
+"  -j, --jobs                       Run test cases in JOBS forked worker processes, `auto' follows the CPU quota.\n"
 "  -k, --keep-going                 When repeat count is larger than 0, keep unit test going when error occur.\n"
 "  -l, --list                       Just list out all the test suite and test case instead of running them.\n"
+"  -q, --quiet                      Print only failed cases, setups and teardowns, and the result.\n"
 "  -r, --repeat                     Run unit test for a repeat count, in range [0, INT_MAX].\n"
 "  -R, --no-filtered-out-result     Do not output filterd out case or suite result.\n"
 "  -s, --shuffle                    Randomize the order of test suite and test case.\n"
+"  -t, --threads                    Run cases of THREAD_SAFE_SUITE suites on THREADS threads, `auto' follows the CPU quota.\n"
 "  -x, --xml-path                   Generate an XML report with detail informaion of the unit test.\n"
+"      --repeat-stats[=STATS_PATH]  Report all repeats once with per case statistics, default `test_bin.repeat.json'.\n"
+"      --shard-index                Run only the shard with this index, in range [0, SHARD_COUNT).\n"
+"      --shard-count                Split test cases into SHARD_COUNT deterministic shards.\n"
+"      --shard-weights              Balance shards by the `suite.case weight' lines of this file.\n"
+"      --shard-split-suites         Allow splitting suites which have SUITE_SETUP across shards.\n"
+"      --history[=HISTORY_PATH]     Record case durations and outcomes, default is `test_bin.history'.\n"
+"      --order                      Case order from history: `declared', `longest' or recently `failed' first, or by `value'.\n"
+"      --slowest                    Print the SLOWEST count of cases by history after the run.\n"
+"      --benchmark                  Run the BENCHMARK_CASE cases instead of the test cases, serially.\n"
+"      --benchmark-time             Measurement time of every benchmark in milliseconds, default is 500.\n"
+"      --benchmark-baseline         Fail benchmarks significantly slower than in this saved baseline file.\n"
+"      --benchmark-save             Save the benchmark samples as a new baseline file.\n"
+"      --benchmark-threshold        Percent a benchmark may be slower than its baseline, default is 5.\n"
+"      --perf-counters[=COUNTERS]   Count `cycles,instructions,cache-misses,branch-misses' of every case.\n"
+"      --progress                   Like --quiet, with a status line of the running case on a terminal.\n"
+"      --list-format                Format of --list, `text' or `json' with the source file and line.\n"
+"      --filter-file                Run only the `suite.case' names listed in this file, one per line.\n"
+"      --reporter                   Also report to `junit', `json' or `tap' files, as `NAME[:PATH],...'.\n"
+"      --retry-failed               Run a failed case again up to RETRY_FAILED times, passing on a retry is FLAKY.\n"
+"      --quarantine                 Failures of the `suite.case' names listed in this file do not fail the run.\n"
+"      --coverage-map[=MAP_PATH]    Record the functions every case runs, built with --coverage, default `test_bin.coverage'.\n"
+"      --changed-files              Run only cases whose recorded coverage meets these `,' separated files, or `@FILE'.\n"
+"      --timeout                    Fail a case running longer than TIMEOUT ms, CASE_TIMEOUT overrides it per case.\n"
+"      --time-budget                Start only cases expected to end within TIME_BUDGET seconds, by `value' order.\n"
+"      --catch-crashes              Report a case killed by SIGSEGV, SIGBUS, SIGFPE, SIGILL or SIGABRT as CRASHED, go on.\n"
 "  -h, --help                       Display this help and exit.\n"
 "  -v, --version                    Display version and exit.\n";
 
 static const int INDENT = 2;
 
-static bool should_use_color(void)
-{
-    if (UT_FLAG(no_color))
-        return false;
-
-    if (isatty(fileno(stdout)) == 0)
-        return false;
+static const uint64_t CONSOLE_FLUSH_INTERVAL = 100000000ULL;
 
+/*
+ * The terminal is looked at once. stdout is fully buffered in CONSOLE_BUFFER_SIZE and written out on a failure, at
+ * the end of the runner, and at a case boundary at most every CONSOLE_FLUSH_INTERVAL, so passing cases cost no
+ * write; on a terminal also when a case begins. --quiet prints a case only when it fails, --progress also keeps a
+ * status line on a terminal.
+ */
+typedef struct console_t
+{
+    bool                detected;
+    bool                is_terminal;
+    bool                use_color;
+    uint64_t            flush_time;
+    uint64_t            progress_time;
+    bool                is_progress_shown;
+    const test_case_t   *test_case;
+    bool                is_case_printed;
+    int                 done_case_count;
+    int                 fail_case_count;
+}console_t;
+
+static console_t _console_;
+static char _console_buffer_[CONSOLE_BUFFER_SIZE];
+static __thread bool _is_print_muted_;
+static FILE *_spare_stdout_;
+static FILE *_spare_stderr_;
+static char _spare_stdout_buffer_[BUFSIZ];
+
+static bool is_color_term(void)
+{
     const char* term = getenv("TERM");
     if (term == NULL)
         return false;
@@ -107,16 +167,37 @@ static bool should_use_color(void)
     return false;
 }
 
-static void color_print(color_t color, const char* string)
+static void detect_console(void)
 {
-    if (!should_use_color())
-    {
-        printf("%s ", string);
+    _console_.is_terminal = isatty(fileno(stdout)) != 0;
+    _console_.use_color = !UT_FLAG(no_color) && _console_.is_terminal && is_color_term();
+    _console_.detected = true;
+}
+
+static bool should_use_color(void)
+{
+    if (!_console_.detected)
+        detect_console();
+    return _console_.use_color;
+}
+
+static bool is_quiet(void)
+{
+    return UT_FLAG(quiet) || UT_FLAG(progress);
+}
+
+static bool should_show_progress(void)
+{
+    return UT_FLAG(progress) && _console_.is_terminal;
+}
+
+static void clear_progress(void)
+{
+    if (!_console_.is_progress_shown)
         return;
-    }
 
-    printf(COLOR_FORMAT "%s " RESET_COLOR_FORMAT, UT_FLAG(highlight), color, string);
-    fflush(stdout);
+    printf(CLEAR_LINE_FORMAT);
+    _console_.is_progress_shown = false;
 }
 
 static void color_underline_print(color_t color, const char* string, char placeholder)
@@ -129,14 +210,17 @@ static void color_underline_print(color_t color, const char* string, char placeh
 
     printf(COLOR_FORMAT "%c" UNDERLINE_FORMAT "%s" RESET_COLOR_FORMAT COLOR_FORMAT "%c " RESET_COLOR_FORMAT,
             UT_FLAG(highlight), color, placeholder, string, UT_FLAG(highlight), color, placeholder);
-    fflush(stdout);
 }
 
 static void print_label(color_t color, const char* label)
 {
-    char string[MAX_STR_LEN];
-    snprintf(string, MAX_STR_LEN, "%c%s%c", BORDER, label, BORDER);
-    color_print(color, string);
+    if (!should_use_color())
+    {
+        printf("%c%s%c ", BORDER, label, BORDER);
+        return;
+    }
+
+    printf(COLOR_FORMAT "%c%s%c " RESET_COLOR_FORMAT, UT_FLAG(highlight), color, BORDER, label, BORDER);
 }
 
 static void print_underline_label(color_t color, const char* string)
@@ -189,6 +273,21 @@ static void print_end_label(bool passed, const char* msg)
     printf("%s\n", msg);
 }
 
+/* Times are kept in nanoseconds, print them in the largest unit that still shows at least 1. */
+static const char* format_time(uint64_t time, char* buf)
+{
+    if (time < 1000ULL)
+        snprintf(buf, TIME_STR_LEN, "%llu ns", (unsigned long long)time);
+    else if (time < 1000000ULL)
+        snprintf(buf, TIME_STR_LEN, "%.3f us", time / 1e3);
+    else if (time < 1000000000ULL)
+        snprintf(buf, TIME_STR_LEN, "%.3f ms", time / 1e6);
+    else
+        snprintf(buf, TIME_STR_LEN, "%.3f s", time / 1e9);
+
+    return buf;
+}
+
 void print_runner_begin(const test_runner_t *test_runner)
 {
     print_underline_blank(GREEN);
@@ -208,8 +307,10 @@ void print_runner_end(const test_runner_t *test_runner, setup_teardown_func_t te
     }
 
     char msg[MAX_STR_LEN];
-    snprintf(msg, sizeof(msg), "Test runner \"%s\" end [(%d suite) (%d case) (%d assertsion) (%d ms)]",
-            test_runner->name, result->suite_count, result->case_count, result->assertion_count, result->time);
+    char time[TIME_STR_LEN];
+    snprintf(msg, sizeof(msg), "Test runner \"%s\" end [(%d suite) (%d case) (%d assertsion) (%s)]",
+            test_runner->name, result->suite_count, result->case_count, result->assertion_count,
+            format_time(result->time, time));
     print_end_label(result->passed, msg);
 }
 
@@ -226,8 +327,9 @@ void print_suite_end(const test_suite_t *test_suite)
 {
     const suite_result_t *result = test_suite->result;
     char msg[MAX_STR_LEN];
-    snprintf(msg, sizeof(msg), "Test suite \"%s\" end [(%d case) (%d assertion) (%d ms)]",
-            test_suite->name, result->case_count, result->assertion_count, result->time);
+    char time[TIME_STR_LEN];
+    snprintf(msg, sizeof(msg), "Test suite \"%s\" end [(%d case) (%d assertion) (%s)]",
+            test_suite->name, result->case_count, result->assertion_count, format_time(result->time, time));
     print_end_label(result->passed, msg);
 }
 
@@ -236,13 +338,92 @@ void print_case_begin(const test_case_t *test_case)
     print_begin_label(CASE, test_case->name);
 }
 
+static void print_perf_counter_result(const case_result_t *result)
+{
+    if (result->perf_counter_mask == 0)
+        return;
+
+    print_label(GREEN, PERF_LABEL);
+    const char* separator = "";
+    int i;
+    for (i = 0; i < PERF_COUNTER_COUNT; i++)
+    {
+        if ((result->perf_counter_mask & (1 << i)) == 0)
+            continue;
+
+        printf("%s%s %llu", separator, get_perf_counter_name((perf_counter_t)i),
+               (unsigned long long)result->perf_counter_list[i]);
+        separator = ", ";
+    }
+    printf("\n");
+}
+
+static void print_alloc_result(const case_result_t *result)
+{
+    if (result->alloc_count == 0)
+        return;
+
+    print_label(result->unfreed_alloc_count > 0 ? YELLOW : GREEN, ALLOC_LABEL);
+    printf("%llu alloc, %llu bytes, peak %llu bytes, %llu unfreed, %llu bytes leaked\n",
+            (unsigned long long)result->alloc_count, (unsigned long long)result->alloc_bytes,
+            (unsigned long long)result->peak_alloc_bytes, (unsigned long long)result->unfreed_alloc_count,
+            (unsigned long long)result->unfreed_alloc_bytes);
+}
+
+/*
+ * FLAKY passed on a retry, TIMED OUT was stopped by the watchdog, CRASHED got a fatal signal, QUARANTINED failed
+ * without failing the run.
+ */
+static void print_case_end_label(const case_result_t *result, const char* msg)
+{
+    if (result->is_flaky)
+        print_underline_label(YELLOW, FLAKY_LABEL);
+    else if (result->is_timed_out)
+        print_underline_label(RED, TIMED_OUT_LABEL);
+    else if (result->is_crashed)
+        print_underline_label(RED, CRASHED_LABEL);
+    else if (!result->passed && result->is_quarantined)
+        print_underline_label(YELLOW, QUARANTINED_LABEL);
+    else
+        print_underline_label(result->passed ? GREEN : RED, result->passed ? PASSED_LABEL : FAILED_LABEL);
+    printf("%s\n", msg);
+}
+
 void print_case_end(const test_case_t *test_case)
 {
     const case_result_t *result = test_case->result;
+    char retry[TIME_STR_LEN] = EMPTY_STR;
+    if (result->retry_count > 0)
+        snprintf(retry, sizeof(retry), " (%d retry)", result->retry_count);
+
     char msg[MAX_STR_LEN];
-    snprintf(msg, sizeof(msg), "%s [(%d assertion) (%d ms)]",
-            test_case->name, result->assertion_count, result->time);
-    print_end_label(result->passed, msg);
+    char time[TIME_STR_LEN];
+    char user_time[TIME_STR_LEN];
+    char system_time[TIME_STR_LEN];
+    snprintf(msg, sizeof(msg), "%s [(%d assertion)%s (%s) (user %s) (sys %s)]",
+            test_case->name, result->assertion_count, retry, format_time(result->time, time),
+            format_time(result->user_time, user_time), format_time(result->system_time, system_time));
+    print_case_end_label(result, msg);
+    print_perf_counter_result(result);
+    print_alloc_result(result);
+}
+
+void print_benchmark_result(const test_case_t *test_case)
+{
+    const benchmark_result_t *result = test_case->benchmark;
+    if (result->sample_count == 0)
+        return;
+
+    print_label(GREEN, BENCHMARK_LABEL);
+    printf("%d sample x %llu iteration: median %.3f ns/op, mean %.3f, stddev %.3f, min %.3f, p99 %.3f\n",
+            result->sample_count, (unsigned long long)result->iteration_count, result->median, result->mean,
+            result->stddev, result->min, result->p99);
+    if (result->compared)
+    {
+        print_label(GREEN, BLANK_LABEL);
+        printf("baseline median %.3f ns/op, change %+.2f%%, p-value of regression %.4f\n", result->baseline_median,
+                (result->median / result->baseline_median - 1) * 100, result->p_value);
+    }
 }
 
 static void print_setup_teardown_begin_label(test_type_t setup_teardown, const char* msg)
@@ -267,10 +448,11 @@ void print_setup_begin(test_type_t test_type)
     print_setup_teardown_begin_label(SETUP, msg);
 }
 
-void print_setup_end(test_type_t test_type, bool passed, int time)
+void print_setup_end(test_type_t test_type, bool passed, uint64_t time)
 {
     char msg[MAX_STR_LEN];
-    snprintf(msg, sizeof(msg), "%s setup end [(%d ms)]\n", get_test_type_name(test_type), time);
+    char time_str[TIME_STR_LEN];
+    snprintf(msg, sizeof(msg), "%s setup end [(%s)]\n", get_test_type_name(test_type), format_time(time, time_str));
     print_setup_teardown_end_label(passed, msg);
 }
 
@@ -284,15 +466,79 @@ void print_teardown_begin(test_type_t test_type)
     print_setup_teardown_begin_label(TEARDOWN, msg);
 }
 
-void print_teardown_end(test_type_t test_type, bool passed, int time)
+void print_teardown_end(test_type_t test_type, bool passed, uint64_t time)
 {
     char msg[MAX_STR_LEN];
-    snprintf(msg, sizeof(msg), "%s teardown end [(%d ms)]\n", get_test_type_name(test_type), time);
+    char time_str[TIME_STR_LEN];
+    snprintf(msg, sizeof(msg), "%s teardown end [(%s)]\n", get_test_type_name(test_type), format_time(time, time_str));
     print_setup_teardown_end_label(passed, msg);
 }
 
+void set_print_muted(bool muted)
+{
+    _is_print_muted_ = muted;
+}
+
+static FILE* open_spare_stream(int fd, char* buffer, size_t size)
+{
+    int spare_fd = dup(fd);
+    if (spare_fd == -1)
+        return NULL;
+
+    FILE *stream = fdopen(spare_fd, "w");
+    if (stream == NULL)
+    {
+        close(spare_fd);
+        return NULL;
+    }
+
+    setvbuf(stream, buffer, (buffer != NULL) ? _IOFBF : _IONBF, size);
+    return stream;
+}
+
+/* Opened with the watchdog, before a case can get stuck, as fdopen() and the first write of a stream allocate. */
+void open_spare_console(void)
+{
+    if (_spare_stdout_ == NULL)
+        _spare_stdout_ = open_spare_stream(STDOUT_FILENO, _spare_stdout_buffer_, sizeof(_spare_stdout_buffer_));
+    if (_spare_stderr_ == NULL)
+        _spare_stderr_ = open_spare_stream(STDERR_FILENO, NULL, 0);
+}
+
+/* What the stuck thread left in the buffer of the stream is written out as it stands, glibc keeps it in between. */
+static FILE* take_stream(FILE *stream, FILE *spare)
+{
+    if (ftrylockfile(stream) == 0 || spare == NULL)
+        return stream;
+
+    const char* data = stream->_IO_write_base;
+    while (data < stream->_IO_write_ptr)
+    {
+        ssize_t len = write(fileno(spare), data, stream->_IO_write_ptr - data);
+        if (len <= 0)
+            break;
+        data += len;
+    }
+    fputc('\n', spare);
+    return spare;
+}
+
+/*
+ * For the report of a timed out case, while the stuck case thread is parked, maybe inside printf() with the lock
+ * of stdout held. A stream whose lock is held is replaced with its spare on the same fd. The locks taken stay held,
+ * the process exits after the report.
+ */
+void take_stuck_console(void)
+{
+    stdout = take_stream(stdout, _spare_stdout_);
+    stderr = take_stream(stderr, _spare_stderr_);
+}
+
 void print_assertion_info(const char* file, int line, const char* expected, const char* actual, const char* msg, ...)
 {
+    if (_is_print_muted_)
+        return;
+
     print_label(CYAN, FILE_LINE_LABEL);
     printf("%s: %d\n", file, line);
 
@@ -325,24 +571,99 @@ void print_assertion_info(const char* file, int line, const char* expected, cons
     fflush(stdout);
 }
 
-void print_ut_list(const test_runner_t *test_runner)
+static void print_text_ut_list(const test_runner_t *test_runner)
 {
     printf("UT: %s\n", test_runner->name);
 
     int suite_index;
-    for (suite_index = 0; suite_index < test_runner->suite_count; suite_index++)
+    const test_suite_t *test_suite;
+    for (suite_index = 0; (test_suite = get_listed_suite(test_runner, suite_index)) != NULL; suite_index++)
     {
-        test_suite_t *test_suite = test_runner->suite_list[suite_index];
         printf("%s\n", test_suite->name);
 
         int case_index;
-        for (case_index = 0; case_index < test_suite->case_count; case_index++)
-            printf("%*c%s\n", INDENT, ' ', test_suite->case_list[case_index]->name);
+        const test_case_t *test_case;
+        for (case_index = 0; (test_case = get_listed_case(test_suite, case_index)) != NULL; case_index++)
+            printf("%*c%s\n", INDENT, ' ', test_case->name);
     }
 }
 
-static void print_case_result(const runner_result_t *result)
+static void print_json_location(const char* name, const char* file, int line)
+{
+    printf("{\"name\":");
+    write_report_str(stdout, name);
+    printf(",\"file\":");
+    write_report_str(stdout, file);
+    printf(",\"line\":%d", line);
+}
+
+/* Declared capacities, an exclusive resource has 1. */
+static void print_json_resources(const resource_list_t *resources)
 {
+    printf(",\"resources\":[");
+    int count = (resources != NULL) ? resources->count : 0;
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        const resource_t *resource = &resources->list[i];
+        printf("%s{\"name\":", (i > 0) ? "," : EMPTY_STR);
+        write_report_str(stdout, resource->name);
+        printf(",\"capacity\":%d}", (resource->capacity > 1) ? resource->capacity : 1);
+    }
+    printf("]");
+}
+
+/* One JSON document, for test discovery of IDEs and CI. */
+static void print_json_ut_list(const test_runner_t *test_runner)
+{
+    printf("{\"runner\":");
+    write_report_str(stdout, test_runner->name);
+    printf(",\"suites\":[");
+
+    int suite_index;
+    const test_suite_t *test_suite;
+    for (suite_index = 0; (test_suite = get_listed_suite(test_runner, suite_index)) != NULL; suite_index++)
+    {
+        printf("%s", (suite_index > 0) ? "," : EMPTY_STR);
+        print_json_location(test_suite->name, test_suite->file, test_suite->line);
+        print_json_resources(test_suite->resources);
+        printf(",\"cases\":[");
+
+        int case_index;
+        const test_case_t *test_case;
+        for (case_index = 0; (test_case = get_listed_case(test_suite, case_index)) != NULL; case_index++)
+        {
+            printf("%s", (case_index > 0) ? "," : EMPTY_STR);
+            print_json_location(test_case->name, test_case->file, test_case->line);
+            printf(",\"benchmark\":%s", (test_case->benchmark != NULL) ? "true" : "false");
+            print_json_resources(test_case->resources);
+            printf("}");
+        }
+        printf("]}");
+    }
+    printf("]}\n");
+}
+
+/* Listing does not init the reporters, the console buffer is set here so that the list is written at once. */
+void print_ut_list(const test_runner_t *test_runner)
+{
+    setvbuf(stdout, _console_buffer_, _IOFBF, sizeof(_console_buffer_));
+    if (UT_FLAG(list_format) == JSON_LIST_FORMAT)
+        print_json_ut_list(test_runner);
+    else
+        print_text_ut_list(test_runner);
+    fflush(stdout);
+}
+
+static void print_result_case_ref(const test_runner_t *test_runner, const result_case_ref_t *ref)
+{
+    const test_suite_t *test_suite = test_runner->suite_list[ref->suite_index];
+    printf("%s.%s\n", test_suite->name, test_suite->case_list[ref->case_index]->name);
+}
+
+static void print_case_result(const test_runner_t *test_runner)
+{
+    const runner_result_t *result = test_runner->result;
     print_underline_blank(GREEN);
     print_label(GREEN, CASE_LABEL);
     printf("%d\n", result->case_count);
@@ -353,7 +674,7 @@ static void print_case_result(const runner_result_t *result)
     for (i = 0; i < result->succ_case_count; i++)
     {
         print_label(GREEN, BLANK_LABEL);
-        printf("%s\n", result->succ_case_list[i]);
+        print_result_case_ref(test_runner, &result->succ_case_list[i]);
     }
 
     if (result->fail_case_count > 0)
@@ -364,7 +685,29 @@ static void print_case_result(const runner_result_t *result)
     for (i = 0; i < result->fail_case_count; i++)
     {
         print_label(RED, BLANK_LABEL);
-        printf("%s\n", result->fail_case_list[i]);
+        print_result_case_ref(test_runner, &result->fail_case_list[i]);
+    }
+
+    if (result->flaky_case_count > 0)
+    {
+        print_label(YELLOW, FLAKY_LABEL);
+        printf("%d\n", result->flaky_case_count);
+        for (i = 0; i < result->flaky_case_count; i++)
+        {
+            print_label(YELLOW, BLANK_LABEL);
+            print_result_case_ref(test_runner, &result->flaky_case_list[i]);
+        }
+    }
+
+    if (result->quarantined_case_count > 0)
+    {
+        print_label(YELLOW, QUARANTINED_LABEL);
+        printf("%d\n", result->quarantined_case_count);
+        for (i = 0; i < result->quarantined_case_count; i++)
+        {
+            print_label(YELLOW, BLANK_LABEL);
+            print_result_case_ref(test_runner, &result->quarantined_case_list[i]);
+        }
     }
 
     if (result->skip_case_count > 0)
@@ -374,7 +717,7 @@ static void print_case_result(const runner_result_t *result)
         for (i = 0; i < result->skip_case_count; i++)
         {
             print_label(BLUE, BLANK_LABEL);
-            printf("%s\n", result->skip_case_list[i]);
+            print_result_case_ref(test_runner, &result->skip_case_list[i]);
         }
     }
 
@@ -388,13 +731,14 @@ static void print_case_result(const runner_result_t *result)
         for (i = 0; i < result->filtered_out_case_count; i++)
         {
             print_label(YELLOW, BLANK_LABEL);
-            printf("%s\n", result->filtered_out_case_list[i]);
+            print_result_case_ref(test_runner, &result->filtered_out_case_list[i]);
         }
     }
 }
 
-static void print_suite_result(const runner_result_t *result)
+static void print_suite_result(const test_runner_t *test_runner)
 {
+    const runner_result_t *result = test_runner->result;
     color_underline_print(GREEN, BLANK_LABEL, BORDER);
     printf("\n");
     print_label(GREEN, SUITE_LABEL);
@@ -406,7 +750,7 @@ static void print_suite_result(const runner_result_t *result)
     for (i = 0; i < result->succ_suite_count; i++)
     {
         print_label(GREEN, BLANK_LABEL);
-        printf("%s\n", result->succ_suite_list[i]);
+        printf("%s\n", test_runner->suite_list[result->succ_suite_list[i]]->name);
     }
 
     if (result->fail_suite_count > 0)
@@ -417,7 +761,7 @@ static void print_suite_result(const runner_result_t *result)
     for (i = 0; i < result->fail_suite_count; i++)
     {
         print_label(RED, BLANK_LABEL);
-        printf("%s\n", result->fail_suite_list[i]);
+        printf("%s\n", test_runner->suite_list[result->fail_suite_list[i]]->name);
     }
 
     if (result->skip_suite_count > 0)
@@ -427,7 +771,7 @@ static void print_suite_result(const runner_result_t *result)
         for (i = 0; i < result->skip_suite_count; i++)
         {
             print_label(BLUE, BLANK_LABEL);
-            printf("%s\n", result->skip_suite_list[i]);
+            printf("%s\n", test_runner->suite_list[result->skip_suite_list[i]]->name);
         }
     }
 
@@ -441,11 +785,33 @@ static void print_suite_result(const runner_result_t *result)
         for (i = 0; i < result->filtered_out_suite_count; i++)
         {
             print_label(YELLOW, BLANK_LABEL);
-            printf("%s\n", result->filtered_out_suite_list[i]);
+            printf("%s\n", test_runner->suite_list[result->filtered_out_suite_list[i]]->name);
         }
     }
 }
 
+/* How much of the runner --time-budget covered, and how long the cases it did not start take by history. */
+static void print_time_budget_result(const test_runner_t *test_runner)
+{
+    const runner_result_t *result = test_runner->result;
+    uint64_t skip_time = 0;
+    int i;
+    for (i = 0; i < result->skip_case_count; i++)
+    {
+        const result_case_ref_t *ref = &result->skip_case_list[i];
+        const test_suite_t *test_suite = test_runner->suite_list[ref->suite_index];
+        skip_time += get_case_expected_time(test_suite, test_suite->case_list[ref->case_index]);
+    }
+
+    int case_count = result->case_count - result->filtered_out_case_count;
+    int run_count = case_count - result->skip_case_count;
+    char time[TIME_STR_LEN];
+    print_label((result->skip_case_count > 0) ? YELLOW : GREEN, BUDGET_LABEL);
+    printf("%d/%d case (%.1f%%) within %d s, %d not started, about %s more\n", run_count, case_count,
+           (case_count > 0) ? 100.0 * run_count / case_count : 100.0, UT_FLAG(time_budget), result->skip_case_count,
+           format_time(skip_time, time));
+}
+
 static void print_runner_result(const test_runner_t *test_runner)
 {
     color_underline_print(GREEN, BLANK_LABEL, BORDER);
@@ -461,8 +827,11 @@ static void print_runner_result(const test_runner_t *test_runner)
         return;
     }
 
+    char time[TIME_STR_LEN];
     print_label(GREEN, TIME_LABEL);
-    printf("%d ms\n", result->time);
+    printf("%s\n", format_time(result->time, time));
+    if (UT_FLAG(time_budget) > 0)
+        print_time_budget_result(test_runner);
 
     if (result->passed)
     {
@@ -483,206 +852,261 @@ void print_ut_result(const test_runner_t *test_runner)
     const runner_result_t *result = test_runner->result;
     if (result->accessed)
     {
-        print_case_result(result);
-        print_suite_result(result);
+        print_case_result(test_runner);
+        print_suite_result(test_runner);
     }
     print_runner_result(test_runner);
 }
 
-static bool get_xml_path_default(const char* test_bin_name, int repeat, char xml_path[PATH_MAX])
+static bool init_console(const char* path ATTRIBUTE_UNUSED)
 {
-    if (strlen(UT_FLAG(xml_path)) != 0)
-        return false;
-
-    if (repeat > 0)
-        snprintf(xml_path, PATH_MAX, "%s_%d.xml", test_bin_name, repeat);
-    else
-        snprintf(xml_path, PATH_MAX, "%s.xml", test_bin_name);
-
+    detect_console();
+    setvbuf(stdout, _console_buffer_, _IOFBF, sizeof(_console_buffer_));
+    _console_.flush_time = get_monotonic_time();
     return true;
 }
 
-static bool get_xml_path_with_dir(const char* test_bin_name, int repeat, char xml_path[PATH_MAX])
+static void fini_console(void)
 {
-    struct stat fs;
-    if (stat(UT_FLAG(xml_path), &fs) == -1)
-        return false;
+    clear_progress();
+    fflush(stdout);
+}
 
-    if (!S_ISDIR(fs.st_mode))
-        return false;
+static void print_progress(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    printf(CLEAR_LINE_FORMAT "[%d case, %d failed] %s.%s", _console_.done_case_count, _console_.fail_case_count,
+           test_suite->name, test_case->name);
+    _console_.is_progress_shown = true;
+}
 
-    if (repeat > 0)
-        snprintf(xml_path, PATH_MAX, "%s/%s_%d.xml", UT_FLAG(xml_path), test_bin_name, repeat);
-    else
-        snprintf(xml_path, PATH_MAX, "%s/%s.xml", UT_FLAG(xml_path), test_bin_name);
+/* A case boundary, the only place besides failures where the buffer is written out. */
+static void end_console_case(const test_suite_t *test_suite, const test_case_t *test_case, bool failed)
+{
+    uint64_t now = get_monotonic_time();
+    if (should_show_progress() && (failed || now - _console_.progress_time >= CONSOLE_FLUSH_INTERVAL))
+    {
+        print_progress(test_suite, test_case);
+        _console_.progress_time = now;
+    }
 
-    return true;
+    if (failed || now - _console_.flush_time >= CONSOLE_FLUSH_INTERVAL)
+    {
+        fflush(stdout);
+        _console_.flush_time = now;
+    }
 }
 
-static bool get_xml_path(const char* test_bin_name, int repeat, char xml_path[PATH_MAX])
+static void print_console_runner_begin(const test_runner_t *test_runner, int repeat ATTRIBUTE_UNUSED)
 {
-    if (get_xml_path_default(test_bin_name, repeat, xml_path))
-        return true;
+    _console_.done_case_count = 0;
+    _console_.fail_case_count = 0;
+    if (!is_quiet())
+        print_runner_begin(test_runner);
+}
 
-    if (get_xml_path_with_dir(test_bin_name, repeat, xml_path))
-        return true;
+static void print_console_runner_end(const test_runner_t *test_runner)
+{
+    if (!is_quiet())
+        print_runner_end(test_runner, *test_runner->teardown);
+}
 
-    snprintf(xml_path, PATH_MAX, "%s", UT_FLAG(xml_path));
+static bool print_console_runner_result(const test_runner_t *test_runner)
+{
+    clear_progress();
+    print_ut_result(test_runner);
+    fflush(stdout);
+    _console_.flush_time = get_monotonic_time();
     return true;
 }
 
-static const char* escape_xml(const char* string)
+static void print_console_suite_begin(const test_suite_t *test_suite)
 {
-    static char escape_str[MAX_STR_LEN];
+    if (!is_quiet())
+        print_suite_begin(test_suite);
+}
 
-    char* index = escape_str;
-    const char* replace_str = NULL;
-    while (*string && (index - escape_str) < MAX_STR_LEN)
-    {
-        switch (*string)
-        {
-        case '<':
-            replace_str = "&lt;";
-            break;
-        case '>':
-            replace_str = "&gt;";
-            break;
-        case '&':
-            replace_str = "&amp;";
-            break;
-        case '\'':
-            replace_str = "&apos;";
-            break;
-        case '\"':
-            replace_str = "&quot;";
-            break;
-        default:
-            *index++ = *string++;
-            continue;
-        }
+static void print_console_suite_end(const test_suite_t *test_suite, const suite_result_t *result ATTRIBUTE_UNUSED)
+{
+    if (!is_quiet())
+        print_suite_end(test_suite);
+}
 
-        while (*replace_str)
-            *index++ = *replace_str++;
-        string++;
-    }
-    *index = '\0';
+/* Quiet, the begin of a case is only printed once it fails. */
+static void print_console_case_begin_once(void)
+{
+    if (_console_.is_case_printed)
+        return;
 
-    return escape_str;
+    clear_progress();
+    print_case_begin(_console_.test_case);
+    _console_.is_case_printed = true;
 }
 
-static void write_test_case_result(FILE *xml, const test_case_t *test_case, int indent)
+static void print_console_case_begin(const test_suite_t *test_suite ATTRIBUTE_UNUSED, const test_case_t *test_case)
 {
-    const case_result_t *case_result = test_case->result;
-    const char* result;
-    if (!case_result->accessed)
-        result = SKIPPED;
-    else if (case_result->is_filtered_out)
-        result = FILTERED_OUT;
-    else if (case_result->passed)
-        result = PASSED;
-    else
-        result = FAILED;
+    _console_.test_case = test_case;
+    _console_.is_case_printed = false;
+    if (is_quiet())
+        return;
 
-    if (!case_result->accessed
-        || case_result->passed
-        || (!UT_FLAG(no_filtered_out_result) && case_result->is_filtered_out))
+    /* On a terminal someone watches, a case that hangs or crashes must be on the screen. */
+    print_console_case_begin_once();
+    if (_console_.is_terminal)
+        fflush(stdout);
+}
+
+static void print_console_assertion_failure(const assertion_failure_t *failure)
+{
+    print_console_case_begin_once();
+    print_assertion_info(failure->file, failure->line, failure->expected, failure->actual, "%s", failure->user_msg);
+}
+
+static void print_console_case_end(const test_suite_t *test_suite, const test_case_t *test_case,
+                                   const case_result_t *result)
+{
+    _console_.done_case_count++;
+    if (!result->passed)
+        _console_.fail_case_count++;
+
+    if (!is_quiet() || !result->passed || result->retry_count > 0)
     {
-        fprintf(xml, "%*c<test_case name=\"%s\" result=\"%s\" assertion=\"%d\" time=\"%dms\"/>\n", indent, ' ',
-                escape_xml(test_case->name), result, case_result->assertion_count, case_result->time);
+        print_console_case_begin_once();
+        print_case_end(test_case);
+        if (test_case->benchmark != NULL)
+            print_benchmark_result(test_case);
     }
-    else
+
+    end_console_case(test_suite, test_case, !result->passed);
+}
+
+static void print_console_setup_begin(test_type_t test_type)
+{
+    if (!is_quiet())
+        print_setup_begin(test_type);
+}
+
+static void print_console_setup_end(test_type_t test_type, bool passed, uint64_t time)
+{
+    if (is_quiet() && passed)
+        return;
+
+    if (is_quiet())
     {
-        fprintf(xml, "%*c<test_case name=\"%s\" result=\"%s\" assertion=\"%d\" time=\"%dms\">\n", indent, ' ',
-                escape_xml(test_case->name), result, case_result->assertion_count, case_result->time);
-        fprintf(xml, "%*c<message file=\"%s\" line=\"%d\" expected=\"%s\" actual=\"%s\" user_msg=\"%s\"/>\n",
-                indent + INDENT, ' ',
-                case_result->file, case_result->line, escape_xml(case_result->expected), escape_xml(case_result->actual),
-                case_result->user_msg);
-        fprintf(xml, "%*c</test_case>\n", indent, ' ');
+        clear_progress();
+        print_setup_begin(test_type);
     }
+    print_setup_end(test_type, passed, time);
+    if (!passed)
+        fflush(stdout);
 }
 
-static void write_test_suite_result(FILE *xml, const test_suite_t *test_suite, int indent)
+static void print_console_teardown_begin(test_type_t test_type)
 {
-    const suite_result_t *suite_result = test_suite->result;
-    const char* result;
-    if (!suite_result->accessed)
-        result = SKIPPED;
-    else if (suite_result->is_filtered_out)
-        result = FILTERED_OUT;
-    else if (suite_result->passed)
-        result = PASSED;
-    else
-        result = FAILED;
+    if (!is_quiet())
+        print_teardown_begin(test_type);
+}
 
-    if (UT_FLAG(no_filtered_out_result) && suite_result->is_filtered_out)
+static void print_console_teardown_end(test_type_t test_type, bool passed, uint64_t time)
+{
+    if (is_quiet() && passed)
         return;
 
-    fprintf(xml, "%*c<test_suite name=\"%s\" result=\"%s\" test_case=\"%d\" assertion=\"%d\" time=\"%dms\">\n",
-            indent, ' ', escape_xml(test_suite->name),
-            result, suite_result->case_count, suite_result->assertion_count, suite_result->time);
-
-    if (suite_result->accessed && !suite_result->is_filtered_out)
+    if (is_quiet())
     {
-        int i;
-        for (i = 0; i < test_suite->case_count; i++)
-            write_test_case_result(xml, test_suite->case_list[i], indent + INDENT);
+        clear_progress();
+        print_teardown_begin(test_type);
     }
-
-    fprintf(xml, "%*c</test_suite>\n", indent, ' ');
+    print_teardown_end(test_type, passed, time);
+    if (!passed)
+        fflush(stdout);
 }
 
-static void write_test_runner_result(FILE *xml, const test_runner_t *test_runner)
+const reporter_t CONSOLE_REPORTER =
 {
-    const runner_result_t *runner_result = test_runner->result;
-    const char* result;
-    if (!runner_result->accessed)
-        result = SKIPPED;
-    else if (runner_result->passed)
-        result = PASSED;
-    else
-        result = FAILED;
+    .name               = "console",
+    .init               = init_console,
+    .fini               = fini_console,
+    .runner_begin       = print_console_runner_begin,
+    .runner_end         = print_console_runner_end,
+    .runner_result      = print_console_runner_result,
+    .suite_begin        = print_console_suite_begin,
+    .suite_end          = print_console_suite_end,
+    .case_begin         = print_console_case_begin,
+    .assertion_failure  = print_console_assertion_failure,
+    .case_end           = print_console_case_end,
+    .setup_begin        = print_console_setup_begin,
+    .setup_end          = print_console_setup_end,
+    .teardown_begin     = print_console_teardown_begin,
+    .teardown_end       = print_console_teardown_end
+};
 
-    fprintf(xml, "<ut name=\"%s\" result=\"%s\" test_suite=\"%d\" test_case=\"%d\" assertion=\"%d\" time=\"%dms\">\n",
-            escape_xml(test_runner->name), result, runner_result->suite_count, runner_result->case_count,
-            runner_result->assertion_count, runner_result->time);
+void print_slowest_case_list(const case_history_t* const *case_history_list, int count)
+{
+    printf("\n");
+    print_underline_blank(YELLOW);
+    print_label(YELLOW, SLOWEST_LABEL);
+    printf("%d case\n", count);
 
-    if (runner_result->accessed)
+    int i;
+    for (i = 0; i < count; i++)
     {
-        int i;
-        for (i = 0; i < test_runner->suite_count; i++)
-            write_test_suite_result(xml, test_runner->suite_list[i], INDENT);
+        const case_history_t *case_history = case_history_list[i];
+        print_label(YELLOW, BLANK_LABEL);
+        printf("%12.3f ms (last %.3f ms, %d run, %d failed) %s\n", case_history->mean_time, case_history->last_time,
+                case_history->run_count, case_history->fail_count, case_history->name);
     }
-
-    fprintf(xml, "</ut>\n");
 }
 
-static bool write_ut_result_to_xml(const test_runner_t *test_runner, const char* xml_path)
+static void print_case_stats(const test_suite_t *test_suite, const test_case_t *test_case,
+                             const case_stats_t *stats)
 {
-    FILE *xml = fopen(xml_path, "w+");
-    if (xml == NULL)
+    if (stats->run_count == 0)
     {
-        fprintf(stderr, "fopen(%s, w+): %m\n", xml_path);
-        return false;
+        print_label(YELLOW, SKIPED_LABEL);
+        printf("%d skipped %s.%s\n", stats->skip_count, test_suite->name, test_case->name);
+        return;
     }
 
-    fprintf(xml, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
-    write_test_runner_result(xml, test_runner);
+    if (stats->fail_count == 0)
+        print_label(GREEN, PASSED_LABEL);
+    else if (stats->pass_count == 0)
+        print_label(RED, FAILED_LABEL);
+    else
+        print_label(YELLOW, FLAKY_LABEL);
 
-    fclose(xml);
-    return true;
+    printf("%6d/%-6d %10.3f ms (min %.3f, max %.3f, stddev %.3f ms) ", stats->pass_count, stats->run_count,
+           stats->mean_time, stats->min_time, stats->max_time, get_case_stats_stddev(stats));
+    if (stats->fail_count > 0 && stats->pass_count > 0)
+        printf("(flaky %.1f%%) ", get_case_stats_flaky_rate(stats) * 100);
+    printf("%s.%s\n", test_suite->name, test_case->name);
 }
 
-bool print_ut_result_to_xml(const test_runner_t *test_runner, int repeat)
+/* Every case that ran, or was skipped, in one line: passed runs of all, mean time and its spread. */
+void print_repeat_stats(const test_runner_t *test_runner)
 {
-    char xml_path[PATH_MAX];
-    if (!get_xml_path(test_runner->test_bin_name, repeat, xml_path))
-        return false;
+    clear_progress();
+    printf("\n");
+    bool passed = is_repeat_stats_passed();
+    print_underline_blank(passed ? GREEN : RED);
+    print_label(passed ? GREEN : RED, REPEAT_LABEL);
+    printf("%d run of %s\n", get_repeat_stats_count(), test_runner->name);
 
-    if (!write_ut_result_to_xml(test_runner, xml_path))
-        return false;
+    int i;
+    for (i = 0; i < test_runner->suite_count; i++)
+    {
+        const test_suite_t *test_suite = test_runner->suite_list[i];
+        int j;
+        for (j = 0; j < test_suite->case_count; j++)
+        {
+            const case_stats_t *stats = get_case_stats(i, j);
+            if (stats->run_count > 0 || stats->skip_count > 0)
+                print_case_stats(test_suite, test_suite->case_list[j], stats);
+        }
+    }
 
-    return true;
+    print_label(passed ? GREEN : RED, passed ? PASSED_LABEL : FAILED_LABEL);
+    printf("\n");
+    fflush(stdout);
 }
 
 void print_ut_init_no_called_error(void)
@@ -706,6 +1130,21 @@ void print_ut_flag_int_value_warning(const char* flag, int value, int min, int m
             flag, value, min, max, default_value);
 }
 
+void print_ut_flag_str_value_warning(const char* flag, const char* value, const char* default_value)
+{
+    fprintf(stderr, "UT_ENV_FLAG `%s = %s' is invalid, use `%s' default.\n", flag, value, default_value);
+}
+
+void print_ut_flag_str_value_error(const char* option, const char* value)
+{
+    fprintf(stderr, "UT_OPTION `%s = %s' is invalid.\n", option, value);
+}
+
+void print_ut_flag_conflict_error(const char* option, const char* other_option)
+{
+    fprintf(stderr, "UT_OPTION `%s' cannot be used with `%s'.\n", option, other_option);
+}
+
 void print_ut_flag_int_type_error(const char* option, const char* value)
 {
     fprintf(stderr, "UT_OPTION `%s = %s' is invalid.\n", option, value);
@@ -735,6 +1174,8 @@ void print_error(const char* file, const char* function, int line, const char* m
     vsnprintf(formatted_msg, sizeof(formatted_msg), format, args);
     va_end(args);
 
+    clear_progress();
     print_label(PURPLE, INTERNAL_ERR_LABEL);
     printf("%s\n", formatted_msg);
+    fflush(stdout);
 }
@@ -0,0 +1,190 @@
+#include "zcut.h"
+
+#include <math.h>
+
+#define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
+
+bool UT_FLAG(repeat_stats);
+char UT_FLAG(repeat_stats_path)[MAX_STR_LEN];
+
+/*
+ * Statistics of every case over all repeats, kept with running algorithms so that nothing grows with the repeat
+ * count. Suite and case indexes of the runner do not change between repeats, shuffle and order are done once.
+ */
+typedef struct repeat_stats_t
+{
+    case_stats_t    *case_stats_list;
+    int             *suite_offset_list;
+    int             repeat_count;
+    int             fail_repeat_count;
+}repeat_stats_t;
+
+static repeat_stats_t _repeat_stats_;
+
+static double get_time_ms(uint64_t time)
+{
+    return time / 1000000.0;
+}
+
+bool init_repeat_stats(const test_runner_t *test_runner)
+{
+    int suite_count = test_runner->suite_count;
+    _repeat_stats_.suite_offset_list = (int*)malloc((suite_count + 1) * sizeof(int));
+    if (_repeat_stats_.suite_offset_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("malloc(%d): %m", (suite_count + 1) * sizeof(int));
+        return false;
+    }
+
+    int case_count = 0;
+    int i;
+    for (i = 0; i < suite_count; i++)
+    {
+        _repeat_stats_.suite_offset_list[i] = case_count;
+        case_count += test_runner->suite_list[i]->case_count;
+    }
+    _repeat_stats_.suite_offset_list[suite_count] = case_count;
+
+    /* An empty runner still gets a list, calloc(0) may return NULL. */
+    _repeat_stats_.case_stats_list = (case_stats_t*)calloc((case_count > 0) ? case_count : 1, sizeof(case_stats_t));
+    if (_repeat_stats_.case_stats_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("calloc(%d): %m", case_count * sizeof(case_stats_t));
+        return false;
+    }
+
+    return true;
+}
+
+void free_repeat_stats(void)
+{
+    free(_repeat_stats_.case_stats_list);
+    free(_repeat_stats_.suite_offset_list);
+    memset(&_repeat_stats_, 0, sizeof(_repeat_stats_));
+}
+
+/* Welford's update of the mean and the sum of squared differences from it. */
+static void update_case_stats(case_stats_t *stats, const case_result_t *result)
+{
+    if (stats->run_count > 0 && result->passed != stats->last_passed)
+        stats->flip_count++;
+    stats->last_passed = result->passed;
+    if (result->passed)
+        stats->pass_count++;
+    else
+        stats->fail_count++;
+
+    double time = get_time_ms(result->time);
+    stats->run_count++;
+    if (stats->run_count == 1 || time < stats->min_time)
+        stats->min_time = time;
+    if (stats->run_count == 1 || time > stats->max_time)
+        stats->max_time = time;
+
+    double delta = time - stats->mean_time;
+    stats->mean_time += delta / stats->run_count;
+    stats->time_m2 += delta * (time - stats->mean_time);
+}
+
+/* `passed' is the whole run, a failed runner setup or teardown fails it without failing a case. */
+void update_repeat_stats(const test_runner_t *test_runner, bool passed)
+{
+    if (_repeat_stats_.case_stats_list == NULL)
+        return;
+
+    _repeat_stats_.repeat_count++;
+    if (!passed)
+        _repeat_stats_.fail_repeat_count++;
+
+    int i;
+    for (i = 0; i < test_runner->suite_count; i++)
+    {
+        const test_suite_t *test_suite = test_runner->suite_list[i];
+        case_stats_t *stats_list = _repeat_stats_.case_stats_list + _repeat_stats_.suite_offset_list[i];
+        int j;
+        for (j = 0; j < test_suite->case_count; j++)
+        {
+            const case_result_t *result = test_suite->case_list[j]->result;
+            if (!result->accessed)
+                stats_list[j].skip_count++;
+            else if (!result->is_filtered_out)
+                update_case_stats(&stats_list[j], result);
+        }
+    }
+}
+
+const case_stats_t* get_case_stats(int suite_index, int case_index)
+{
+    return &_repeat_stats_.case_stats_list[_repeat_stats_.suite_offset_list[suite_index] + case_index];
+}
+
+int get_repeat_stats_count(void)
+{
+    return _repeat_stats_.repeat_count;
+}
+
+bool is_repeat_stats_passed(void)
+{
+    return _repeat_stats_.repeat_count > 0 && _repeat_stats_.fail_repeat_count == 0;
+}
+
+double get_case_stats_stddev(const case_stats_t *stats)
+{
+    return (stats->run_count > 1) ? sqrt(stats->time_m2 / (stats->run_count - 1)) : 0.0;
+}
+
+/* How often the outcome changed between runs: 0 if it never did, 1 if it alternated every time. */
+double get_case_stats_flaky_rate(const case_stats_t *stats)
+{
+    return (stats->run_count > 1) ? (double)stats->flip_count / (stats->run_count - 1) : 0.0;
+}
+
+static void write_case_stats(FILE *file, const test_suite_t *test_suite, const test_case_t *test_case,
+                             const case_stats_t *stats)
+{
+    fprintf(file, "{\"suite\":");
+    write_report_str(file, test_suite->name);
+    fprintf(file, ",\"case\":");
+    write_report_str(file, test_case->name);
+    fprintf(file, ",\"run\":%d,\"passed\":%d,\"failed\":%d,\"skipped\":%d,\"flaky_rate\":%.6f,\"min_ms\":%.6f,"
+            "\"mean_ms\":%.6f,\"max_ms\":%.6f,\"stddev_ms\":%.6f}", stats->run_count, stats->pass_count,
+            stats->fail_count, stats->skip_count, get_case_stats_flaky_rate(stats), stats->min_time,
+            stats->mean_time, stats->max_time, get_case_stats_stddev(stats));
+}
+
+/* One JSON document for all the repeats, `test_bin.repeat.json' by default. */
+bool save_repeat_stats(const test_runner_t *test_runner)
+{
+    if (_repeat_stats_.case_stats_list == NULL)
+        return true;
+
+    FILE *file = open_report_file(UT_FLAG(repeat_stats_path), ".repeat.json", test_runner, 0);
+    if (file == NULL)
+        return false;
+
+    fprintf(file, "{\"runner\":");
+    write_report_str(file, test_runner->name);
+    fprintf(file, ",\"repeat\":%d,\"failed_repeat\":%d,\"cases\":[", _repeat_stats_.repeat_count,
+            _repeat_stats_.fail_repeat_count);
+
+    bool is_first = true;
+    int i;
+    for (i = 0; i < test_runner->suite_count; i++)
+    {
+        const test_suite_t *test_suite = test_runner->suite_list[i];
+        int j;
+        for (j = 0; j < test_suite->case_count; j++)
+        {
+            const case_stats_t *stats = get_case_stats(i, j);
+            if (stats->run_count == 0 && stats->skip_count == 0)
+                continue;
+
+            fprintf(file, "%s\n", is_first ? EMPTY_STR : ",");
+            write_case_stats(file, test_suite, test_suite->case_list[j], stats);
+            is_first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    return close_report_file(file);
+}
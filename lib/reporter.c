@@ -0,0 +1,613 @@
+#define _GNU_SOURCE
+#include "zcut.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <time.h>
+
+#define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
+#define MAX_REPORTER_COUNT  8
+#define REPORT_QUEUE_SIZE   1024
+#define REPORT_BUFFER_SIZE  (64 * 1024)
+
+char UT_FLAG(reporter)[MAX_STR_LEN];
+
+static const long MIN_REPORT_WAIT_TIME = 50000L;
+static const long MAX_REPORT_WAIT_TIME = 1000000L;
+
+typedef enum report_event_type_t
+{
+    RUNNER_BEGIN_EVENT,
+    RUNNER_END_EVENT,
+    RUNNER_RESULT_EVENT,
+    SUITE_BEGIN_EVENT,
+    SUITE_END_EVENT,
+    CASE_BEGIN_EVENT,
+    ASSERTION_FAILURE_EVENT,
+    CASE_END_EVENT,
+    SETUP_BEGIN_EVENT,
+    SETUP_END_EVENT,
+    TEARDOWN_BEGIN_EVENT,
+    TEARDOWN_END_EVENT,
+    STOP_EVENT
+}report_event_type_t;
+
+/*
+ * Results in a queued event are copies, the case or suite may run again before the background thread gets to it.
+ * Failure records stay valid in the arena until the next run, and every run ends by draining the queue.
+ */
+typedef struct report_event_t
+{
+    report_event_type_t         type;
+    test_type_t                 test_type;
+    bool                        passed;
+    int                         repeat;
+    uint64_t                    time;
+    const test_runner_t         *test_runner;
+    const test_suite_t          *test_suite;
+    const test_case_t           *test_case;
+    const assertion_failure_t   *failure;
+    const suite_result_t        *suite_result;
+    const case_result_t         *case_result;
+    suite_result_t              suite_result_copy;
+    case_result_t               case_result_copy;
+}report_event_t;
+
+/*
+ * Single producer, single consumer ring. Events are produced by the main thread, or by pool threads one at a time
+ * under the print lock, so the producer side needs no atomics of its own.
+ */
+typedef struct report_queue_t
+{
+    report_event_t  *event_list;
+    unsigned int    head;
+    unsigned int    tail;
+}report_queue_t;
+
+typedef struct reporter_list_t
+{
+    const reporter_t    *reporter_list[MAX_REPORTER_COUNT];
+    int                 count;
+    bool                has_background;
+    bool                thread_started;
+    pthread_t           thread;
+    report_queue_t      queue;
+    bool                background_failed;
+}reporter_list_t;
+
+static reporter_list_t _reporters_;
+static __thread bool _is_case_reporting_;
+
+typedef struct reporter_name_t
+{
+    const char*         name;
+    const reporter_t    *reporter;
+}reporter_name_t;
+
+static const reporter_name_t REPORTER_NAME_LIST[] =
+{
+    {"junit",   &JUNIT_REPORTER},
+    {"json",    &JSON_REPORTER},
+    {"tap",     &TAP_REPORTER}
+};
+static const int REPORTER_NAME_COUNT = sizeof(REPORTER_NAME_LIST) / sizeof(REPORTER_NAME_LIST[0]);
+
+static const reporter_t* find_reporter(const char* name, size_t len)
+{
+    int i;
+    for (i = 0; i < REPORTER_NAME_COUNT; i++)
+    {
+        if (strlen(REPORTER_NAME_LIST[i].name) == len && strncmp(name, REPORTER_NAME_LIST[i].name, len) == 0)
+            return REPORTER_NAME_LIST[i].reporter;
+    }
+
+    return NULL;
+}
+
+/* `NAME[:PATH],...', every reporter at most once. Only checks, init_reporters() opens them. */
+bool parse_reporters(const char* value)
+{
+    char reporter_list[MAX_STR_LEN];
+    snprintf(reporter_list, sizeof(reporter_list), "%s", value);
+
+    const reporter_t *seen_list[MAX_REPORTER_COUNT];
+    int seen_count = 0;
+    char* save_ptr = NULL;
+    char* spec;
+    for (spec = strtok_r(reporter_list, ",", &save_ptr); spec != NULL; spec = strtok_r(NULL, ",", &save_ptr))
+    {
+        const reporter_t *reporter = find_reporter(spec, strcspn(spec, ":"));
+        if (reporter == NULL)
+            return false;
+
+        int i;
+        for (i = 0; i < seen_count; i++)
+        {
+            if (seen_list[i] == reporter)
+                return false;
+        }
+        seen_list[seen_count++] = reporter;
+    }
+
+    return seen_count > 0;
+}
+
+static bool add_reporter(const reporter_t *reporter, const char* path)
+{
+    if (_reporters_.count == MAX_REPORTER_COUNT)
+    {
+        PRINT_INTERNAL_ERROR("too many reporters");
+        return false;
+    }
+
+    if (reporter->init != NULL && !reporter->init(path))
+        return false;
+
+    _reporters_.reporter_list[_reporters_.count++] = reporter;
+    if (reporter->background)
+        _reporters_.has_background = true;
+    return true;
+}
+
+static void dispatch_event(const reporter_t *reporter, const report_event_t *event)
+{
+    switch (event->type)
+    {
+    case RUNNER_BEGIN_EVENT:
+        if (reporter->runner_begin != NULL)
+            reporter->runner_begin(event->test_runner, event->repeat);
+        break;
+    case RUNNER_END_EVENT:
+        if (reporter->runner_end != NULL)
+            reporter->runner_end(event->test_runner);
+        break;
+    case RUNNER_RESULT_EVENT:
+        if (reporter->runner_result != NULL && !reporter->runner_result(event->test_runner))
+            _reporters_.background_failed = true;
+        break;
+    case SUITE_BEGIN_EVENT:
+        if (reporter->suite_begin != NULL)
+            reporter->suite_begin(event->test_suite);
+        break;
+    case SUITE_END_EVENT:
+        if (reporter->suite_end != NULL)
+            reporter->suite_end(event->test_suite, event->suite_result);
+        break;
+    case CASE_BEGIN_EVENT:
+        if (reporter->case_begin != NULL)
+            reporter->case_begin(event->test_suite, event->test_case);
+        break;
+    case ASSERTION_FAILURE_EVENT:
+        if (reporter->assertion_failure != NULL)
+            reporter->assertion_failure(event->failure);
+        break;
+    case CASE_END_EVENT:
+        if (reporter->case_end != NULL)
+            reporter->case_end(event->test_suite, event->test_case, event->case_result);
+        break;
+    case SETUP_BEGIN_EVENT:
+        if (reporter->setup_begin != NULL)
+            reporter->setup_begin(event->test_type);
+        break;
+    case SETUP_END_EVENT:
+        if (reporter->setup_end != NULL)
+            reporter->setup_end(event->test_type, event->passed, event->time);
+        break;
+    case TEARDOWN_BEGIN_EVENT:
+        if (reporter->teardown_begin != NULL)
+            reporter->teardown_begin(event->test_type);
+        break;
+    case TEARDOWN_END_EVENT:
+        if (reporter->teardown_end != NULL)
+            reporter->teardown_end(event->test_type, event->passed, event->time);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Assertion failures reach background reporters with the end of their case, from the copied failure list. */
+static void dispatch_background_event(const report_event_t *event)
+{
+    int i;
+    if (event->type == CASE_END_EVENT)
+    {
+        report_event_t failure_event = *event;
+        failure_event.type = ASSERTION_FAILURE_EVENT;
+        const assertion_failure_t *failure;
+        for (failure = event->case_result->failure_list; failure != NULL; failure = failure->next)
+        {
+            failure_event.failure = failure;
+            for (i = 0; i < _reporters_.count; i++)
+            {
+                if (_reporters_.reporter_list[i]->background)
+                    dispatch_event(_reporters_.reporter_list[i], &failure_event);
+            }
+        }
+    }
+
+    for (i = 0; i < _reporters_.count; i++)
+    {
+        if (_reporters_.reporter_list[i]->background)
+            dispatch_event(_reporters_.reporter_list[i], event);
+    }
+}
+
+static void wait_report_queue(long *wait_time)
+{
+    struct timespec time = {0, *wait_time};
+    nanosleep(&time, NULL);
+    if (*wait_time < MAX_REPORT_WAIT_TIME)
+        *wait_time *= 2;
+}
+
+static void* run_report_thread(void* arg)
+{
+    report_queue_t *queue = (report_queue_t*)arg;
+    long wait_time = MIN_REPORT_WAIT_TIME;
+    while (true)
+    {
+        unsigned int tail = queue->tail;
+        if (tail == __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE))
+        {
+            wait_report_queue(&wait_time);
+            continue;
+        }
+
+        wait_time = MIN_REPORT_WAIT_TIME;
+        report_event_t *event = &queue->event_list[tail % REPORT_QUEUE_SIZE];
+        if (event->type == STOP_EVENT)
+            break;
+
+        dispatch_background_event(event);
+        __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    return NULL;
+}
+
+static void push_report_event(const report_event_t *event)
+{
+    report_queue_t *queue = &_reporters_.queue;
+    unsigned int head = queue->head;
+    while (head - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) == REPORT_QUEUE_SIZE)
+        sched_yield();
+
+    report_event_t *slot = &queue->event_list[head % REPORT_QUEUE_SIZE];
+    *slot = *event;
+    if (event->suite_result != NULL)
+    {
+        slot->suite_result_copy = *event->suite_result;
+        slot->suite_result = &slot->suite_result_copy;
+    }
+    if (event->case_result != NULL)
+    {
+        slot->case_result_copy = *event->case_result;
+        slot->case_result = &slot->case_result_copy;
+    }
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* Also called before forking a worker, so the child does not inherit a stream locked by the background thread. */
+void drain_report_queue(void)
+{
+    report_queue_t *queue = &_reporters_.queue;
+    if (!_reporters_.thread_started)
+        return;
+
+    while (__atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) != queue->head)
+        sched_yield();
+}
+
+static void report_event(const report_event_t *event)
+{
+    int i;
+    for (i = 0; i < _reporters_.count; i++)
+    {
+        const reporter_t *reporter = _reporters_.reporter_list[i];
+        if (!reporter->background || !_reporters_.thread_started)
+            dispatch_event(reporter, event);
+    }
+
+    if (_reporters_.thread_started && event->type != ASSERTION_FAILURE_EVENT)
+        push_report_event(event);
+}
+
+static bool start_report_thread(void)
+{
+    report_queue_t *queue = &_reporters_.queue;
+    queue->event_list = (report_event_t*)malloc(REPORT_QUEUE_SIZE * sizeof(report_event_t));
+    if (queue->event_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("malloc(%d): %m", REPORT_QUEUE_SIZE * sizeof(report_event_t));
+        return false;
+    }
+    queue->head = 0;
+    queue->tail = 0;
+
+    if (pthread_create(&_reporters_.thread, NULL, run_report_thread, queue) != 0)
+    {
+        PRINT_INTERNAL_ERROR("pthread_create(): %m");
+        free(queue->event_list);
+        queue->event_list = NULL;
+        return false;
+    }
+
+    _reporters_.thread_started = true;
+    return true;
+}
+
+/* Console first, its output is what a failing run is read by. A background thread that fails to start is not fatal. */
+bool init_reporters(void)
+{
+    if (!add_reporter(&CONSOLE_REPORTER, EMPTY_STR))
+        return false;
+    if (UT_FLAG(xml) && !add_reporter(&XML_REPORTER, UT_FLAG(xml_path)))
+        return false;
+
+    char reporter_list[MAX_STR_LEN];
+    snprintf(reporter_list, sizeof(reporter_list), "%s", UT_FLAG(reporter));
+    char* save_ptr = NULL;
+    char* spec;
+    for (spec = strtok_r(reporter_list, ",", &save_ptr); spec != NULL; spec = strtok_r(NULL, ",", &save_ptr))
+    {
+        size_t name_len = strcspn(spec, ":");
+        const char* path = (spec[name_len] == ':') ? spec + name_len + 1 : EMPTY_STR;
+        const reporter_t *reporter = find_reporter(spec, name_len);
+        if (reporter == NULL || !add_reporter(reporter, path))
+            return false;
+    }
+
+    if (_reporters_.has_background)
+        start_report_thread();
+    return true;
+}
+
+void fini_reporters(void)
+{
+    if (_reporters_.thread_started)
+    {
+        report_event_t event;
+        memset(&event, 0, sizeof(event));
+        event.type = STOP_EVENT;
+        push_report_event(&event);
+        pthread_join(_reporters_.thread, NULL);
+        free(_reporters_.queue.event_list);
+        _reporters_.queue.event_list = NULL;
+        _reporters_.thread_started = false;
+    }
+
+    int i;
+    for (i = 0; i < _reporters_.count; i++)
+    {
+        if (_reporters_.reporter_list[i]->fini != NULL)
+            _reporters_.reporter_list[i]->fini();
+    }
+    _reporters_.count = 0;
+    _reporters_.has_background = false;
+}
+
+static void init_report_event(report_event_t *event, report_event_type_t type)
+{
+    memset(event, 0, offsetof(report_event_t, suite_result_copy));
+    event->type = type;
+}
+
+void report_runner_begin(const test_runner_t *test_runner, int repeat)
+{
+    report_event_t event;
+    init_report_event(&event, RUNNER_BEGIN_EVENT);
+    event.test_runner = test_runner;
+    event.repeat = repeat;
+    report_event(&event);
+}
+
+void report_runner_end(const test_runner_t *test_runner)
+{
+    report_event_t event;
+    init_report_event(&event, RUNNER_END_EVENT);
+    event.test_runner = test_runner;
+    report_event(&event);
+}
+
+/* A barrier: background reporters are done with the run when this returns. */
+bool report_runner_result(const test_runner_t *test_runner)
+{
+    report_event_t event;
+    init_report_event(&event, RUNNER_RESULT_EVENT);
+    event.test_runner = test_runner;
+
+    _reporters_.background_failed = false;
+    bool ret = true;
+    int i;
+    for (i = 0; i < _reporters_.count; i++)
+    {
+        const reporter_t *reporter = _reporters_.reporter_list[i];
+        if ((!reporter->background || !_reporters_.thread_started) && reporter->runner_result != NULL
+            && !reporter->runner_result(test_runner))
+            ret = false;
+    }
+
+    if (_reporters_.thread_started)
+    {
+        push_report_event(&event);
+        drain_report_queue();
+    }
+
+    return ret && !_reporters_.background_failed;
+}
+
+void report_suite_begin(const test_suite_t *test_suite)
+{
+    report_event_t event;
+    init_report_event(&event, SUITE_BEGIN_EVENT);
+    event.test_suite = test_suite;
+    report_event(&event);
+}
+
+void report_suite_end(const test_suite_t *test_suite)
+{
+    report_event_t event;
+    init_report_event(&event, SUITE_END_EVENT);
+    event.test_suite = test_suite;
+    event.suite_result = test_suite->result;
+    report_event(&event);
+}
+
+static void report_case_event(report_event_type_t type, const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    report_event_t event;
+    init_report_event(&event, type);
+    event.test_suite = test_suite;
+    event.test_case = test_case;
+    if (type == CASE_END_EVENT)
+        event.case_result = test_case->result;
+    report_event(&event);
+}
+
+/* Between these two the case runs on this thread, and its failed assertions are reported as they happen. */
+void report_case_begin(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    report_case_event(CASE_BEGIN_EVENT, test_suite, test_case);
+    _is_case_reporting_ = true;
+}
+
+void report_case_end(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    _is_case_reporting_ = false;
+    report_case_event(CASE_END_EVENT, test_suite, test_case);
+}
+
+void report_assertion_failure(const assertion_failure_t *failure)
+{
+    if (!_is_case_reporting_)
+        return;
+
+    report_event_t event;
+    init_report_event(&event, ASSERTION_FAILURE_EVENT);
+    event.failure = failure;
+    report_event(&event);
+}
+
+/* A case which ran on a pool thread or in a worker is reported afterwards, with its recorded failures. */
+void report_case_replay(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    report_case_event(CASE_BEGIN_EVENT, test_suite, test_case);
+
+    report_event_t event;
+    init_report_event(&event, ASSERTION_FAILURE_EVENT);
+    const assertion_failure_t *failure;
+    for (failure = test_case->result->failure_list; failure != NULL; failure = failure->next)
+    {
+        event.failure = failure;
+        report_event(&event);
+    }
+
+    report_case_event(CASE_END_EVENT, test_suite, test_case);
+}
+
+/* Ends a case still open on another thread, for the watchdog: its timeout is the last failure recorded. */
+void report_case_timeout(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    report_event_t event;
+    init_report_event(&event, ASSERTION_FAILURE_EVENT);
+    event.failure = test_case->result->last_failure;
+    report_event(&event);
+
+    report_case_end(test_suite, test_case);
+}
+
+void report_setup_teardown_begin(test_type_t test_type, test_type_t setup_teardown)
+{
+    report_event_t event;
+    init_report_event(&event, (setup_teardown == SETUP) ? SETUP_BEGIN_EVENT : TEARDOWN_BEGIN_EVENT);
+    event.test_type = test_type;
+    report_event(&event);
+}
+
+void report_setup_teardown_end(test_type_t test_type, test_type_t setup_teardown, bool passed, uint64_t time)
+{
+    report_event_t event;
+    init_report_event(&event, (setup_teardown == SETUP) ? SETUP_END_EVENT : TEARDOWN_END_EVENT);
+    event.test_type = test_type;
+    event.passed = passed;
+    event.time = time;
+    report_event(&event);
+}
+
+/*
+ * `-' is stdout. Without a path the report is named after the test binary, like the XML report. Repeated runs get
+ * their own file, suffixed with the repeat index.
+ */
+FILE* open_report_file(const char* path, const char* suffix, const test_runner_t *test_runner, int repeat)
+{
+    if (strcmp(path, "-") == 0)
+        return stdout;
+
+    char report_path[PATH_MAX];
+    if (strlen(path) > 0 && repeat > 0)
+        snprintf(report_path, sizeof(report_path), "%s_%d", path, repeat);
+    else if (strlen(path) > 0)
+        snprintf(report_path, sizeof(report_path), "%s", path);
+    else if (repeat > 0)
+        snprintf(report_path, sizeof(report_path), "%s_%d%s", test_runner->test_bin_name, repeat, suffix);
+    else
+        snprintf(report_path, sizeof(report_path), "%s%s", test_runner->test_bin_name, suffix);
+
+    FILE *file = fopen(report_path, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "fopen(%s, w): %m\n", report_path);
+        return NULL;
+    }
+
+    setvbuf(file, NULL, _IOFBF, REPORT_BUFFER_SIZE);
+    return file;
+}
+
+bool close_report_file(FILE *file)
+{
+    if (file == stdout)
+        return fflush(file) == 0;
+
+    bool ret = !ferror(file);
+    if (fclose(file) != 0)
+        ret = false;
+    return ret;
+}
+
+/* A double quoted string, escaped for JSON, which is also a valid YAML scalar. */
+void write_report_str(FILE *file, const char* string)
+{
+    fputc('\"', file);
+    for (; *string != '\0'; string++)
+    {
+        unsigned char c = (unsigned char)*string;
+        switch (c)
+        {
+        case '\"':
+            fputs("\\\"", file);
+            break;
+        case '\\':
+            fputs("\\\\", file);
+            break;
+        case '\n':
+            fputs("\\n", file);
+            break;
+        case '\r':
+            fputs("\\r", file);
+            break;
+        case '\t':
+            fputs("\\t", file);
+            break;
+        default:
+            if (c < 0x20)
+                fprintf(file, "\\u%04x", c);
+            else
+                fputc(c, file);
+            break;
+        }
+    }
+    fputc('\"', file);
+}
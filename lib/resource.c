@@ -0,0 +1,189 @@
+#include "zcut.h"
+
+#define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
+
+/*
+ * How many running cases hold a resource, by name, and the smallest capacity they declared it with. That capacity
+ * is kept until the count drops to 0, when the entry is reused.
+ */
+typedef struct held_resource_t
+{
+    const char* name;
+    int         count;
+    int         capacity;
+}held_resource_t;
+
+/*
+ * The resources held by the cases a pool runs at the moment. The pool which schedules the cases serializes the
+ * calls, so there is no lock here.
+ */
+typedef struct resource_table_t
+{
+    held_resource_t *list;
+    int             count;
+    int             size;
+}resource_table_t;
+
+static resource_table_t _resource_table_;
+
+static int get_resource_count(const resource_list_t *resources)
+{
+    return (resources != NULL) ? resources->count : 0;
+}
+
+/* The resources of a case are those of its suite, then its own. */
+static const resource_t* get_case_resource(const test_suite_t *test_suite, const test_case_t *test_case, int index)
+{
+    int suite_resource_count = get_resource_count(test_suite->resources);
+    if (index < suite_resource_count)
+        return &test_suite->resources->list[index];
+    return &test_case->resources->list[index - suite_resource_count];
+}
+
+static int get_case_resource_count(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    return get_resource_count(test_suite->resources) + get_resource_count(test_case->resources);
+}
+
+/* A case holds a resource once, however often it is declared. */
+static bool is_resource_declared_before(const test_suite_t *test_suite, const test_case_t *test_case, int index)
+{
+    const char* name = get_case_resource(test_suite, test_case, index)->name;
+    int i;
+    for (i = 0; i < index; i++)
+    {
+        if (strcmp(get_case_resource(test_suite, test_case, i)->name, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+static held_resource_t* find_held_resource(const char* name)
+{
+    int i;
+    for (i = 0; i < _resource_table_.count; i++)
+    {
+        held_resource_t *held = &_resource_table_.list[i];
+        if (held->count > 0 && strcmp(held->name, name) == 0)
+            return held;
+    }
+    return NULL;
+}
+
+static held_resource_t* add_held_resource(const char* name)
+{
+    held_resource_t *held = find_held_resource(name);
+    if (held != NULL)
+        return held;
+
+    int i;
+    for (i = 0; i < _resource_table_.count; i++)
+    {
+        if (_resource_table_.list[i].count == 0)
+            break;
+    }
+
+    if (i == _resource_table_.size)
+    {
+        int size = (_resource_table_.size > 0) ? _resource_table_.size * 2 : 8;
+        held_resource_t *list = (held_resource_t*)realloc(_resource_table_.list, size * sizeof(held_resource_t));
+        if (list == NULL)
+        {
+            PRINT_INTERNAL_ERROR("realloc(%d): %m", size * sizeof(held_resource_t));
+            return NULL;
+        }
+        _resource_table_.list = list;
+        _resource_table_.size = size;
+    }
+
+    held = &_resource_table_.list[i];
+    held->name = name;
+    held->count = 0;
+    if (i == _resource_table_.count)
+        _resource_table_.count++;
+    return held;
+}
+
+static int get_resource_capacity(const resource_t *resource)
+{
+    return (resource->capacity > 1) ? resource->capacity : 1;
+}
+
+/* A resource declared with different capacities is shared by no more cases than any of its holders allows. */
+static bool is_resource_available(const resource_t *resource)
+{
+    const held_resource_t *held = find_held_resource(resource->name);
+    if (held == NULL)
+        return true;
+
+    int capacity = get_resource_capacity(resource);
+    return held->count < ((held->capacity < capacity) ? held->capacity : capacity);
+}
+
+/* Whether the suite or any of its cases declares a resource, pools schedule the cases of other suites freely. */
+bool has_suite_resources(const test_suite_t *test_suite)
+{
+    if (get_resource_count(test_suite->resources) > 0)
+        return true;
+
+    int i;
+    for (i = 0; i < test_suite->case_count; i++)
+    {
+        if (get_resource_count(test_suite->case_list[i]->resources) > 0)
+            return true;
+    }
+    return false;
+}
+
+/*
+ * Takes all the resources of the case, or none of them if one is at its capacity. A case which cannot hold its
+ * resources for lack of memory runs without them.
+ */
+bool acquire_case_resources(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    int count = get_case_resource_count(test_suite, test_case);
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        if (!is_resource_available(get_case_resource(test_suite, test_case, i)))
+            return false;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (is_resource_declared_before(test_suite, test_case, i))
+            continue;
+
+        const resource_t *resource = get_case_resource(test_suite, test_case, i);
+        held_resource_t *held = add_held_resource(resource->name);
+        if (held == NULL)
+            continue;
+
+        int capacity = get_resource_capacity(resource);
+        if (held->count == 0 || capacity < held->capacity)
+            held->capacity = capacity;
+        held->count++;
+    }
+    return true;
+}
+
+void release_case_resources(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    int count = get_case_resource_count(test_suite, test_case);
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        if (is_resource_declared_before(test_suite, test_case, i))
+            continue;
+
+        held_resource_t *held = find_held_resource(get_case_resource(test_suite, test_case, i)->name);
+        if (held != NULL)
+            held->count--;
+    }
+}
+
+void free_case_resources(void)
+{
+    free(_resource_table_.list);
+    memset(&_resource_table_, 0, sizeof(_resource_table_));
+}
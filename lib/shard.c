@@ -0,0 +1,283 @@
+#include "zcut.h"
+
+#define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
+
+static const int WHOLE_SUITE = -1;
+
+typedef struct shard_weight_t
+{
+    char*   name;
+    double  weight;
+}shard_weight_t;
+
+typedef struct shard_weight_list_t
+{
+    shard_weight_t  *weight_list;
+    int             count;
+    double          default_weight;
+}shard_weight_list_t;
+
+/* A unit is either one case, or a whole suite which must not be split because of its SUITE_SETUP. */
+typedef struct shard_unit_t
+{
+    test_suite_t    *test_suite;
+    int             case_index;
+    int             order;
+    int             shard;
+    double          cost;
+}shard_unit_t;
+
+static int compare_weight_name(const void* a, const void* b)
+{
+    return strcmp(((const shard_weight_t*)a)->name, ((const shard_weight_t*)b)->name);
+}
+
+static bool add_shard_weight(shard_weight_list_t *list, int *capacity, const char* name, double weight)
+{
+    if (list->count == *capacity)
+    {
+        int new_capacity = (*capacity == 0) ? 256 : *capacity * 2;
+        shard_weight_t *weight_list = (shard_weight_t*)realloc(list->weight_list,
+                                                               new_capacity * sizeof(shard_weight_t));
+        if (weight_list == NULL)
+        {
+            PRINT_INTERNAL_ERROR("realloc(%d): %m", new_capacity * sizeof(shard_weight_t));
+            return false;
+        }
+        list->weight_list = weight_list;
+        *capacity = new_capacity;
+    }
+
+    char* name_copy = strdup(name);
+    if (name_copy == NULL)
+    {
+        PRINT_INTERNAL_ERROR("strdup(%s): %m", name);
+        return false;
+    }
+
+    list->weight_list[list->count].name = name_copy;
+    list->weight_list[list->count].weight = weight;
+    list->count++;
+    return true;
+}
+
+static bool load_shard_weight_list(const char* path, shard_weight_list_t *list)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "fopen(%s, r): %m\n", path);
+        return false;
+    }
+
+    bool ret = true;
+    int capacity = 0;
+    double total_weight = 0;
+    char line[MAX_STR_LEN * 2];
+    char name[MAX_STR_LEN];
+    double weight;
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if (line[0] == '#' || sscanf(line, "%1023s %lf", name, &weight) != 2 || weight < 0)
+            continue;
+
+        if (!add_shard_weight(list, &capacity, name, weight))
+        {
+            ret = false;
+            break;
+        }
+        total_weight += weight;
+    }
+    fclose(file);
+
+    list->default_weight = (list->count > 0) ? total_weight / list->count : 1;
+    qsort(list->weight_list, list->count, sizeof(shard_weight_t), compare_weight_name);
+    return ret;
+}
+
+static void free_shard_weight_list(shard_weight_list_t *list)
+{
+    int i;
+    for (i = 0; i < list->count; i++)
+        free(list->weight_list[i].name);
+    free(list->weight_list);
+}
+
+static double get_case_weight(const shard_weight_list_t *list, const test_suite_t *test_suite,
+                              const test_case_t *test_case)
+{
+    if (list->count == 0)
+        return 1;
+
+    char name[MAX_STR_LEN];
+    snprintf(name, sizeof(name), "%s.%s", test_suite->name, test_case->name);
+    shard_weight_t key = {name, 0};
+    const shard_weight_t *found = (const shard_weight_t*)bsearch(&key, list->weight_list, list->count,
+                                                                 sizeof(shard_weight_t), compare_weight_name);
+    return (found != NULL) ? found->weight : list->default_weight;
+}
+
+static bool is_suite_splittable(const test_suite_t *test_suite)
+{
+    return UT_FLAG(shard_split_suites) || *test_suite->suite_setup == 0;
+}
+
+static int fill_shard_unit_list(const test_runner_t *test_runner, const shard_weight_list_t *weight_list,
+                                shard_unit_t *unit_list)
+{
+    int unit_count = 0;
+    int i;
+    for (i = 0; i < test_runner->suite_count; i++)
+    {
+        test_suite_t *test_suite = test_runner->suite_list[i];
+        bool splittable = is_suite_splittable(test_suite);
+        if (!splittable)
+        {
+            unit_list[unit_count].test_suite = test_suite;
+            unit_list[unit_count].case_index = WHOLE_SUITE;
+            unit_list[unit_count].order = unit_count;
+            unit_list[unit_count].cost = 0;
+            unit_count++;
+        }
+
+        int j;
+        for (j = 0; j < test_suite->case_count; j++)
+        {
+            double weight = get_case_weight(weight_list, test_suite, test_suite->case_list[j]);
+            if (!splittable)
+            {
+                unit_list[unit_count - 1].cost += weight;
+                continue;
+            }
+
+            unit_list[unit_count].test_suite = test_suite;
+            unit_list[unit_count].case_index = j;
+            unit_list[unit_count].order = unit_count;
+            unit_list[unit_count].cost = weight;
+            unit_count++;
+        }
+    }
+
+    return unit_count;
+}
+
+static int compare_unit_cost(const void* a, const void* b)
+{
+    const shard_unit_t *unit_a = (const shard_unit_t*)a;
+    const shard_unit_t *unit_b = (const shard_unit_t*)b;
+    if (unit_a->cost != unit_b->cost)
+        return (unit_a->cost > unit_b->cost) ? -1 : 1;
+
+    return unit_a->order - unit_b->order;
+}
+
+static int compare_unit_order(const void* a, const void* b)
+{
+    return ((const shard_unit_t*)a)->order - ((const shard_unit_t*)b)->order;
+}
+
+/* Longest processing time first: the costliest unit goes to the least loaded shard, ties to the lower index. */
+static bool assign_shard_unit_list(shard_unit_t *unit_list, int unit_count, int shard_count)
+{
+    double *load_list = (double*)calloc(shard_count, sizeof(double));
+    if (load_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("calloc(%d): %m", shard_count * sizeof(double));
+        return false;
+    }
+
+    qsort(unit_list, unit_count, sizeof(shard_unit_t), compare_unit_cost);
+
+    int i;
+    for (i = 0; i < unit_count; i++)
+    {
+        int shard = 0;
+        int j;
+        for (j = 1; j < shard_count; j++)
+        {
+            if (load_list[j] < load_list[shard])
+                shard = j;
+        }
+
+        unit_list[i].shard = shard;
+        load_list[shard] += unit_list[i].cost;
+    }
+
+    qsort(unit_list, unit_count, sizeof(shard_unit_t), compare_unit_order);
+    free(load_list);
+    return true;
+}
+
+static void keep_shard_case_list(test_runner_t *test_runner, const shard_unit_t *unit_list, int unit_count)
+{
+    int suite_count = 0;
+    int unit_index = 0;
+    int i;
+    for (i = 0; i < test_runner->suite_count; i++)
+    {
+        test_suite_t *test_suite = test_runner->suite_list[i];
+        int case_count = 0;
+        for (; unit_index < unit_count && unit_list[unit_index].test_suite == test_suite; unit_index++)
+        {
+            const shard_unit_t *unit = &unit_list[unit_index];
+            if (unit->shard != UT_FLAG(shard_index))
+                continue;
+
+            if (unit->case_index == WHOLE_SUITE)
+            {
+                case_count = test_suite->case_count;
+                break;
+            }
+            test_suite->case_list[case_count++] = test_suite->case_list[unit->case_index];
+        }
+        while (unit_index < unit_count && unit_list[unit_index].test_suite == test_suite)
+            unit_index++;
+
+        test_suite->case_count = case_count;
+        if (case_count > 0)
+        {
+            test_runner->suite_list[suite_count++] = test_suite;
+        }
+        else if (test_suite->get_case_func_list != NULL)
+        {
+            /* ut_fini() frees the case lists of the suites left in the runner; an auto registered one is a section. */
+            free(test_suite->case_list);
+            test_suite->case_list = NULL;
+        }
+    }
+
+    test_runner->suite_count = suite_count;
+}
+
+bool shard_test_runner(test_runner_t *test_runner)
+{
+    shard_weight_list_t weight_list;
+    memset(&weight_list, 0, sizeof(weight_list));
+    if (strlen(UT_FLAG(shard_weights)) > 0 && !load_shard_weight_list(UT_FLAG(shard_weights), &weight_list))
+    {
+        free_shard_weight_list(&weight_list);
+        return false;
+    }
+
+    int unit_capacity = test_runner->suite_count;
+    int i;
+    for (i = 0; i < test_runner->suite_count; i++)
+        unit_capacity += test_runner->suite_list[i]->case_count;
+
+    shard_unit_t *unit_list = (shard_unit_t*)malloc((unit_capacity + 1) * sizeof(shard_unit_t));
+    if (unit_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("malloc(%d): %m", (unit_capacity + 1) * sizeof(shard_unit_t));
+        free_shard_weight_list(&weight_list);
+        return false;
+    }
+
+    int unit_count = fill_shard_unit_list(test_runner, &weight_list, unit_list);
+    bool ret = assign_shard_unit_list(unit_list, unit_count, UT_FLAG(shard_count));
+    if (ret)
+        keep_shard_case_list(test_runner, unit_list, unit_count);
+
+    free(unit_list);
+    free_shard_weight_list(&weight_list);
+    return ret;
+}
@@ -0,0 +1,126 @@
+#include "zcut.h"
+
+/*
+ * TAP version 13: a test line per run case, named `suite.case', with the failures of a failed one in a YAML block.
+ * The plan comes last, the number of cases to run is only known at the end.
+ */
+typedef struct tap_report_t
+{
+    char    path[MAX_STR_LEN];
+    FILE    *file;
+    int     test_count;
+}tap_report_t;
+
+static tap_report_t _tap_report_;
+
+static const char* const TEST_TYPE_NAME_LIST[] =
+{
+    "runner",
+    "suite",
+    "case"
+};
+
+static bool init_tap_report(const char* path)
+{
+    snprintf(_tap_report_.path, sizeof(_tap_report_.path), "%s", path);
+    return true;
+}
+
+static void fini_tap_report(void)
+{
+    if (_tap_report_.file != NULL)
+        close_report_file(_tap_report_.file);
+    _tap_report_.file = NULL;
+}
+
+static void begin_tap_runner(const test_runner_t *test_runner, int repeat)
+{
+    _tap_report_.test_count = 0;
+    _tap_report_.file = open_report_file(_tap_report_.path, ".tap", test_runner, repeat);
+    if (_tap_report_.file != NULL)
+        fprintf(_tap_report_.file, "TAP version 13\n# %s\n", test_runner->name);
+}
+
+static bool end_tap_runner(const test_runner_t *test_runner ATTRIBUTE_UNUSED)
+{
+    FILE *file = _tap_report_.file;
+    if (file == NULL)
+        return false;
+
+    fprintf(file, "1..%d\n", _tap_report_.test_count);
+    bool ret = close_report_file(file);
+    _tap_report_.file = NULL;
+    return ret;
+}
+
+static void begin_tap_suite(const test_suite_t *test_suite)
+{
+    if (_tap_report_.file != NULL)
+        fprintf(_tap_report_.file, "# %s\n", test_suite->name);
+}
+
+static void write_tap_failure(FILE *file, const assertion_failure_t *failure)
+{
+    fprintf(file, "    - file: ");
+    write_report_str(file, failure->file);
+    fprintf(file, "\n      line: %d\n      expected: ", failure->line);
+    write_report_str(file, failure->expected);
+    fprintf(file, "\n      actual: ");
+    write_report_str(file, failure->actual);
+    fprintf(file, "\n      user_msg: ");
+    write_report_str(file, failure->user_msg);
+    fprintf(file, "\n");
+}
+
+static void end_tap_case(const test_suite_t *test_suite, const test_case_t *test_case, const case_result_t *result)
+{
+    FILE *file = _tap_report_.file;
+    if (file == NULL)
+        return;
+
+    /* A quarantined failure is a TODO test, which TAP consumers do not count as failed. */
+    bool quarantined = !result->passed && result->is_quarantined;
+    fprintf(file, "%s %d - %s.%s%s\n", result->passed ? "ok" : "not ok", ++_tap_report_.test_count,
+            test_suite->name, test_case->name, quarantined ? " # TODO quarantined" : EMPTY_STR);
+    if (result->is_flaky)
+        fprintf(file, "# flaky, passed after %d retry\n", result->retry_count);
+    if (result->passed)
+        return;
+
+    fprintf(file, "  ---\n  failures:\n");
+    const assertion_failure_t *failure;
+    for (failure = result->failure_list; failure != NULL; failure = failure->next)
+        write_tap_failure(file, failure);
+    fprintf(file, "  ...\n");
+    fflush(file);
+}
+
+static void write_tap_setup_teardown_end(const char* name, test_type_t test_type, bool passed)
+{
+    if (_tap_report_.file != NULL && !passed)
+        fprintf(_tap_report_.file, "# %s %s failed\n", TEST_TYPE_NAME_LIST[test_type], name);
+}
+
+static void end_tap_setup(test_type_t test_type, bool passed, uint64_t time ATTRIBUTE_UNUSED)
+{
+    write_tap_setup_teardown_end("setup", test_type, passed);
+}
+
+static void end_tap_teardown(test_type_t test_type, bool passed, uint64_t time ATTRIBUTE_UNUSED)
+{
+    write_tap_setup_teardown_end("teardown", test_type, passed);
+}
+
+const reporter_t TAP_REPORTER =
+{
+    .name           = "tap",
+    .background     = true,
+    .init           = init_tap_report,
+    .fini           = fini_tap_report,
+    .runner_begin   = begin_tap_runner,
+    .runner_result  = end_tap_runner,
+    .suite_begin    = begin_tap_suite,
+    .case_end       = end_tap_case,
+    .setup_end      = end_tap_setup,
+    .teardown_end   = end_tap_teardown
+};
@@ -0,0 +1,441 @@
+#include "zcut.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
+
+static const time_t PRINT_LOCK_WAIT_TIME = 1;
+
+/*
+ * Every thread owns a deque of case indexes. The owner pops from the bottom, idle threads steal from the top of
+ * the other deques. No case is pushed after the pool starts, so a thread quits once a whole steal round is empty.
+ * When cases declare resources, a case taken while its resources are held waits in the deferred list, and threads
+ * take from that list first; a thread with nothing else to take waits for a running case to release resources.
+ */
+typedef struct case_deque_t
+{
+    pthread_mutex_t lock;
+    int             *case_index_list;
+    int             top;
+    int             bottom;
+}case_deque_t;
+
+typedef struct thread_pool_t
+{
+    const test_suite_t  *test_suite;
+    case_deque_t        *deque_list;
+    bool                *reported_list;
+    int                 thread_count;
+    pthread_mutex_t     print_lock;
+    bool                has_resources;
+    pthread_mutex_t     resource_lock;
+    pthread_cond_t      resource_cond;
+    int                 *deferred_list;
+    int                 deferred_count;
+    volatile bool       stopped;
+    bool                passed;
+}thread_pool_t;
+
+typedef struct pool_thread_t
+{
+    thread_pool_t   *pool;
+    int             index;
+    pthread_t       thread;
+}pool_thread_t;
+
+static bool pop_case(case_deque_t *deque, int *case_index)
+{
+    bool found = false;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom > deque->top)
+    {
+        *case_index = deque->case_index_list[--deque->bottom];
+        found = true;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static bool steal_case(case_deque_t *deque, int *case_index)
+{
+    bool found = false;
+    if (pthread_mutex_trylock(&deque->lock) != 0)
+        return false;
+
+    if (deque->bottom > deque->top)
+    {
+        *case_index = deque->case_index_list[deque->top++];
+        found = true;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static bool is_deque_empty(case_deque_t *deque)
+{
+    pthread_mutex_lock(&deque->lock);
+    bool empty = deque->bottom <= deque->top;
+    pthread_mutex_unlock(&deque->lock);
+    return empty;
+}
+
+static bool get_queued_case(thread_pool_t *pool, int self, int *case_index)
+{
+    if (pop_case(&pool->deque_list[self], case_index))
+        return true;
+
+    for (;;)
+    {
+        bool all_empty = true;
+        int i;
+        for (i = 1; i < pool->thread_count; i++)
+        {
+            case_deque_t *victim = &pool->deque_list[(self + i) % pool->thread_count];
+            if (steal_case(victim, case_index))
+                return true;
+            if (!is_deque_empty(victim))
+                all_empty = false;
+        }
+
+        if (all_empty || pool->stopped)
+            return false;
+    }
+}
+
+/* The first deferred case whose resources are free now, deferred cases keep their order. */
+static bool take_deferred_case(thread_pool_t *pool, int *case_index)
+{
+    const test_suite_t *test_suite = pool->test_suite;
+    int i;
+    for (i = 0; i < pool->deferred_count; i++)
+    {
+        int deferred_case_index = pool->deferred_list[i];
+        if (!acquire_case_resources(test_suite, test_suite->case_list[deferred_case_index]))
+            continue;
+
+        memmove(&pool->deferred_list[i], &pool->deferred_list[i + 1], (pool->deferred_count - i - 1) * sizeof(int));
+        pool->deferred_count--;
+        *case_index = deferred_case_index;
+        return true;
+    }
+    return false;
+}
+
+static bool get_next_case(thread_pool_t *pool, int self, int *case_index)
+{
+    if (!pool->has_resources)
+        return get_queued_case(pool, self, case_index);
+
+    const test_suite_t *test_suite = pool->test_suite;
+    bool found = false;
+    pthread_mutex_lock(&pool->resource_lock);
+    while (!found && !pool->stopped)
+    {
+        int queued_case_index;
+        if (take_deferred_case(pool, case_index))
+            found = true;
+        else if (!get_queued_case(pool, self, &queued_case_index))
+        {
+            if (pool->deferred_count == 0)
+                break;
+            pthread_cond_wait(&pool->resource_cond, &pool->resource_lock);
+        }
+        else if (acquire_case_resources(test_suite, test_suite->case_list[queued_case_index]))
+        {
+            *case_index = queued_case_index;
+            found = true;
+        }
+        else
+            pool->deferred_list[pool->deferred_count++] = queued_case_index;
+    }
+    pthread_mutex_unlock(&pool->resource_lock);
+    return found;
+}
+
+static void release_thread_case(thread_pool_t *pool, int case_index)
+{
+    if (!pool->has_resources)
+        return;
+
+    pthread_mutex_lock(&pool->resource_lock);
+    release_case_resources(pool->test_suite, pool->test_suite->case_list[case_index]);
+    pthread_cond_broadcast(&pool->resource_cond);
+    pthread_mutex_unlock(&pool->resource_lock);
+}
+
+static bool run_thread_setup_teardown(setup_teardown_func_t func, uint64_t *time)
+{
+    *time = 0;
+    if (func == 0)
+        return true;
+
+    uint64_t begin = get_monotonic_time();
+    bool ret = (*func)();
+    *time = get_monotonic_time() - begin;
+    return ret;
+}
+
+static void print_thread_setup_teardown(test_type_t setup_teardown, setup_teardown_func_t func, bool passed,
+                                        uint64_t time)
+{
+    if (func == 0)
+        return;
+
+    report_setup_teardown_begin(CASE, setup_teardown);
+    report_setup_teardown_end(CASE, setup_teardown, passed, time);
+}
+
+/* The teardown is that of the case, or the failed setup or teardown of a retry, which stops the suite alike. */
+static void complete_thread_case(thread_pool_t *pool, int case_index, bool setup_passed, uint64_t setup_time,
+                                 const fixture_result_t *teardown)
+{
+    const test_suite_t *test_suite = pool->test_suite;
+    const test_case_t *test_case = test_suite->case_list[case_index];
+    const case_result_t *result = test_case->result;
+    setup_teardown_func_t teardown_func = (teardown->setup_teardown == SETUP) ? *test_suite->case_setup
+                                                                              : *test_suite->case_teardown;
+
+    pthread_mutex_lock(&pool->print_lock);
+    set_print_muted(false);
+    print_thread_setup_teardown(SETUP, *test_suite->case_setup, setup_passed, setup_time);
+    pool->reported_list[case_index] = true;
+    if (setup_passed)
+    {
+        report_case_replay(test_suite, test_case);
+        calc_suite_case_result(test_suite->result, result);
+        print_thread_setup_teardown(teardown->setup_teardown, teardown_func, teardown->passed, teardown->time);
+    }
+
+    if (!setup_passed || !teardown->passed)
+    {
+        pool->stopped = true;
+        pool->passed = false;
+    }
+    set_print_muted(true);
+    pthread_mutex_unlock(&pool->print_lock);
+}
+
+static void run_thread_case(thread_pool_t *pool, int case_index)
+{
+    const test_suite_t *test_suite = pool->test_suite;
+    const test_case_t *test_case = test_suite->case_list[case_index];
+    uint64_t setup_time;
+    fixture_result_t teardown = {TEARDOWN, true, 0};
+    fixture_result_t retry_fixture;
+
+    bool setup_passed = run_thread_setup_teardown(*test_suite->case_setup, &setup_time);
+    if (setup_passed)
+    {
+        exec_test_case(test_case);
+        if (retry_test_case(test_suite, test_case, &retry_fixture))
+            teardown.passed = run_thread_setup_teardown(*test_suite->case_teardown, &teardown.time);
+        else
+            teardown = retry_fixture;
+    }
+    else
+    {
+        test_case->result->accessed = false;
+    }
+
+    complete_thread_case(pool, case_index, setup_passed, setup_time, &teardown);
+}
+
+static thread_pool_t *_running_pool_;
+
+/*
+ * Every case is begun when the deques are filled, so the cases a stopped pool never reported, still queued or
+ * running, must be marked unaccessed to end up skipped rather than failed.
+ */
+static void skip_unreported_cases(thread_pool_t *pool, const test_case_t *except_case)
+{
+    const test_suite_t *test_suite = pool->test_suite;
+    int i;
+    for (i = 0; i < test_suite->case_count; i++)
+    {
+        case_result_t *result = test_suite->case_list[i]->result;
+        if (test_suite->case_list[i] != except_case && !result->is_filtered_out && !pool->reported_list[i])
+            result->accessed = false;
+    }
+}
+
+/*
+ * The other pool threads go on until they report, then wait on the print lock for the exit. One which reports
+ * into the stdout the stuck thread holds never releases the print lock, so it is waited for a while only.
+ */
+static void abort_timed_out_thread_case(const test_case_t *test_case)
+{
+    thread_pool_t *pool = _running_pool_;
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += PRINT_LOCK_WAIT_TIME;
+    pthread_mutex_timedlock(&pool->print_lock, &deadline);
+    skip_unreported_cases(pool, test_case);
+    abort_timed_out_run(test_case, true);
+}
+
+static void* run_pool_thread(void* arg)
+{
+    pool_thread_t *self = (pool_thread_t*)arg;
+    thread_pool_t *pool = self->pool;
+    set_print_muted(true);
+
+    int case_index;
+    while (!pool->stopped && get_next_case(pool, self->index, &case_index))
+    {
+        if (!skip_over_budget_case(pool->test_suite, pool->test_suite->case_list[case_index]))
+            run_thread_case(pool, case_index);
+        release_thread_case(pool, case_index);
+    }
+
+    close_perf_counters();
+    return NULL;
+}
+
+static int fill_case_deque_list(thread_pool_t *pool)
+{
+    const test_suite_t *test_suite = pool->test_suite;
+    int runnable_count = 0;
+    int i;
+    for (i = 0; i < test_suite->case_count; i++)
+    {
+        const test_case_t *test_case = test_suite->case_list[i];
+        if (!begin_test_case(test_suite, test_case))
+        {
+            calc_suite_case_result(test_suite->result, test_case->result);
+            continue;
+        }
+
+        case_deque_t *deque = &pool->deque_list[runnable_count % pool->thread_count];
+        deque->case_index_list[deque->bottom++] = i;
+        runnable_count++;
+    }
+
+    return runnable_count;
+}
+
+static bool init_thread_pool(thread_pool_t *pool, const test_suite_t *test_suite)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->test_suite = test_suite;
+    pool->thread_count = UT_FLAG(threads) < test_suite->case_count ? UT_FLAG(threads) : test_suite->case_count;
+    pool->passed = true;
+
+    pool->deque_list = (case_deque_t*)calloc(pool->thread_count, sizeof(case_deque_t));
+    if (pool->deque_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("calloc(%d): %m", pool->thread_count * sizeof(case_deque_t));
+        return false;
+    }
+
+    int i;
+    for (i = 0; i < pool->thread_count; i++)
+    {
+        case_deque_t *deque = &pool->deque_list[i];
+        pthread_mutex_init(&deque->lock, NULL);
+        deque->case_index_list = (int*)malloc(test_suite->case_count * sizeof(int));
+        if (deque->case_index_list == NULL)
+        {
+            PRINT_INTERNAL_ERROR("malloc(%d): %m", test_suite->case_count * sizeof(int));
+            return false;
+        }
+    }
+
+    pool->reported_list = (bool*)calloc(test_suite->case_count, sizeof(bool));
+    if (pool->reported_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("calloc(%d): %m", test_suite->case_count * sizeof(bool));
+        return false;
+    }
+
+    pthread_mutex_init(&pool->print_lock, NULL);
+    pthread_mutex_init(&pool->resource_lock, NULL);
+    pthread_cond_init(&pool->resource_cond, NULL);
+    pool->has_resources = has_suite_resources(test_suite);
+    if (!pool->has_resources)
+        return true;
+
+    pool->deferred_list = (int*)malloc(test_suite->case_count * sizeof(int));
+    if (pool->deferred_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("malloc(%d): %m", test_suite->case_count * sizeof(int));
+        return false;
+    }
+    return true;
+}
+
+static void fini_thread_pool(thread_pool_t *pool)
+{
+    if (pool->deque_list == NULL)
+        return;
+
+    int i;
+    for (i = 0; i < pool->thread_count; i++)
+    {
+        pthread_mutex_destroy(&pool->deque_list[i].lock);
+        free(pool->deque_list[i].case_index_list);
+    }
+    free(pool->deque_list);
+    free(pool->reported_list);
+    free(pool->deferred_list);
+    pthread_mutex_destroy(&pool->print_lock);
+    pthread_mutex_destroy(&pool->resource_lock);
+    pthread_cond_destroy(&pool->resource_cond);
+}
+
+bool run_suite_cases_in_threads(const test_suite_t *test_suite)
+{
+    if (test_suite->case_count == 0)
+        return true;
+
+    thread_pool_t pool;
+    if (!init_thread_pool(&pool, test_suite))
+    {
+        fini_thread_pool(&pool);
+        return false;
+    }
+
+    pool_thread_t *thread_list = (pool_thread_t*)calloc(pool.thread_count, sizeof(pool_thread_t));
+    if (thread_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("calloc(%d): %m", pool.thread_count * sizeof(pool_thread_t));
+        fini_thread_pool(&pool);
+        return false;
+    }
+
+    fill_case_deque_list(&pool);
+    fflush(stdout);
+    _running_pool_ = &pool;
+    timeout_handler_t timeout_handler = set_case_timeout_handler(abort_timed_out_thread_case);
+
+    int started_count = 0;
+    int i;
+    for (i = 0; i < pool.thread_count; i++)
+    {
+        thread_list[i].pool = &pool;
+        thread_list[i].index = i;
+        if (pthread_create(&thread_list[i].thread, NULL, run_pool_thread, &thread_list[i]) != 0)
+        {
+            PRINT_INTERNAL_ERROR("pthread_create(): %m");
+            break;
+        }
+        started_count++;
+    }
+
+    /* Deques of threads that failed to start are drained by stealing, at least one thread is needed. */
+    if (started_count == 0)
+        run_pool_thread(&thread_list[0]);
+    set_print_muted(false);
+
+    for (i = 0; i < started_count; i++)
+        pthread_join(thread_list[i].thread, NULL);
+    set_case_timeout_handler(timeout_handler);
+    _running_pool_ = NULL;
+    if (pool.stopped)
+        skip_unreported_cases(&pool, NULL);
+
+    free_case_resources();
+    free(thread_list);
+    fini_thread_pool(&pool);
+    return pool.passed;
+}
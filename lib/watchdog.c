@@ -0,0 +1,318 @@
+#define _GNU_SOURCE
+#include "zcut.h"
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
+#define MAX_STUCK_FRAME_COUNT   16
+
+int UT_FLAG(timeout);
+
+/* Frames of the signal handler and the signal trampoline, above the code the case was stuck in. */
+static const int STUCK_HANDLER_FRAME_COUNT = 2;
+static const int MAX_REPORTED_FRAME_COUNT = 8;
+static const uint64_t NSEC_PER_MSEC = 1000000ULL;
+static const uint64_t NSEC_PER_SEC = 1000000000ULL;
+static const uint64_t STUCK_CAPTURE_TIME = 200000000ULL;
+static const unsigned int TIMED_OUT_EXIT_TIME = 5;
+
+/* A case running with a timeout, on the thread that runs it. */
+typedef struct watchdog_slot_t
+{
+    bool                used;
+    volatile bool       timed_out;
+    pthread_t           thread;
+    const test_case_t   *test_case;
+    int                 timeout;
+    uint64_t            deadline;
+    void*               frame_list[MAX_STUCK_FRAME_COUNT];
+    volatile int        frame_count;
+}watchdog_slot_t;
+
+/*
+ * One watchdog thread per process that runs cases, started with its first timed case, so a forked worker has its
+ * own. It sleeps on a monotonic clock until the nearest deadline. A slot per pool thread is enough, as every thread
+ * runs one case at a time.
+ */
+typedef struct watchdog_t
+{
+    pid_t               pid;
+    pthread_t           thread;
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    watchdog_slot_t     *slot_list;
+    int                 slot_count;
+    timeout_handler_t   handler;
+}watchdog_t;
+
+static watchdog_t _watchdog_ = {0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, 0, NULL};
+static __thread watchdog_slot_t *_case_slot_;
+static bool _is_watchdog_atfork_set_;
+
+timeout_handler_t set_case_timeout_handler(timeout_handler_t handler)
+{
+    timeout_handler_t old_handler = _watchdog_.handler;
+    _watchdog_.handler = handler;
+    return old_handler;
+}
+
+/* A declared CASE_TIMEOUT wins, --timeout applies to the other test cases; benchmarks run for a set time anyway. */
+static int get_case_timeout(const test_case_t *test_case)
+{
+    if (test_case->timeout != NULL && *test_case->timeout > 0)
+        return *test_case->timeout;
+    return (test_case->benchmark == NULL) ? UT_FLAG(timeout) : 0;
+}
+
+/* Parks the stuck thread for good, with its stack captured; any other SIGURG is left alone. */
+static void park_stuck_thread(int signal_number ATTRIBUTE_UNUSED)
+{
+    watchdog_slot_t *slot = _case_slot_;
+    if (slot == NULL || !slot->timed_out)
+        return;
+
+    int frame_count = backtrace(slot->frame_list, MAX_STUCK_FRAME_COUNT);
+    __sync_synchronize();
+    slot->frame_count = frame_count;
+    while (true)
+        pause();
+}
+
+static void format_stuck_frame(void* frame, char* buf, size_t size)
+{
+    Dl_info info;
+    if (dladdr(frame, &info) == 0 || info.dli_fname == NULL)
+        snprintf(buf, size, "%p", frame);
+    else if (info.dli_sname != NULL)
+        snprintf(buf, size, "%s+%#lx", info.dli_sname, (unsigned long)((char*)frame - (char*)info.dli_saddr));
+    else
+        snprintf(buf, size, "%s(+%#lx)", basename((char*)info.dli_fname),
+                 (unsigned long)((char*)frame - (char*)info.dli_fbase));
+}
+
+/* Innermost frame first. Static functions show as `binary(+offset)', for addr2line, or link with -rdynamic. */
+static void format_stuck_stack(const watchdog_slot_t *slot, char* stuck_at, size_t size)
+{
+    if (slot->frame_count <= STUCK_HANDLER_FRAME_COUNT)
+    {
+        snprintf(stuck_at, size, "stack not captured");
+        return;
+    }
+
+    int len = snprintf(stuck_at, size, "stuck in ");
+    int i;
+    for (i = STUCK_HANDLER_FRAME_COUNT;
+         i < slot->frame_count && i < STUCK_HANDLER_FRAME_COUNT + MAX_REPORTED_FRAME_COUNT && len < (int)size; i++)
+    {
+        char frame[MAX_STR_LEN];
+        format_stuck_frame(slot->frame_list[i], frame, sizeof(frame));
+        len += snprintf(stuck_at + len, size - len, "%s%s", (i == STUCK_HANDLER_FRAME_COUNT) ? EMPTY_STR : " <- ",
+                        frame);
+    }
+}
+
+static void mark_case_timed_out(const watchdog_slot_t *slot, const char* stuck_at)
+{
+    const test_case_t *test_case = slot->test_case;
+    case_result_t *result = test_case->result;
+    result->is_timed_out = true;
+    result->passed = false;
+    result->fail_assertion_count++;
+    result->assertion_count = result->succ_assertion_count + result->fail_assertion_count;
+    result->time = (uint64_t)slot->timeout * NSEC_PER_MSEC;
+
+    char expected[MAX_STR_LEN];
+    snprintf(expected, sizeof(expected), "%s finished within %d ms", test_case->name, slot->timeout);
+    save_assertion_info(result, test_case->file, test_case->line, expected, stuck_at, "timed out");
+}
+
+/*
+ * The case thread gets SIGURG and parks itself in the handler with its stack captured, so that the case neither
+ * goes on nor reports while its result is written here. The lock stays held, the case cannot end meanwhile. The
+ * console is taken first, stdout may be locked by the parked thread. The handler aborts the case and does not
+ * return; should it hang on another lock the parked thread holds, SIGALRM ends the process.
+ */
+static void time_out_case(watchdog_slot_t *slot)
+{
+    signal(SIGALRM, SIG_DFL);
+    alarm(TIMED_OUT_EXIT_TIME);
+    take_stuck_console();
+
+    slot->timed_out = true;
+    slot->frame_count = 0;
+    if (pthread_kill(slot->thread, SIGURG) == 0)
+    {
+        uint64_t begin = get_monotonic_time();
+        struct timespec wait_time = {0, 1000000};
+        while (slot->frame_count == 0 && get_monotonic_time() - begin < STUCK_CAPTURE_TIME)
+            nanosleep(&wait_time, NULL);
+    }
+
+    char stuck_at[MAX_STR_LEN];
+    format_stuck_stack(slot, stuck_at, sizeof(stuck_at));
+    mark_case_timed_out(slot, stuck_at);
+    if (_watchdog_.handler != NULL)
+        (*_watchdog_.handler)(slot->test_case);
+    _exit(EXIT_FAILURE);
+}
+
+static watchdog_slot_t* get_nearest_slot(void)
+{
+    watchdog_slot_t *nearest_slot = NULL;
+    int i;
+    for (i = 0; i < _watchdog_.slot_count; i++)
+    {
+        watchdog_slot_t *slot = &_watchdog_.slot_list[i];
+        if (slot->used && (nearest_slot == NULL || slot->deadline < nearest_slot->deadline))
+            nearest_slot = slot;
+    }
+    return nearest_slot;
+}
+
+static void* run_watchdog(void* arg ATTRIBUTE_UNUSED)
+{
+    pthread_mutex_lock(&_watchdog_.lock);
+    while (true)
+    {
+        watchdog_slot_t *slot = get_nearest_slot();
+        if (slot == NULL)
+        {
+            pthread_cond_wait(&_watchdog_.cond, &_watchdog_.lock);
+            continue;
+        }
+
+        if (get_monotonic_time() >= slot->deadline)
+            time_out_case(slot);
+
+        struct timespec deadline;
+        deadline.tv_sec = slot->deadline / NSEC_PER_SEC;
+        deadline.tv_nsec = slot->deadline % NSEC_PER_SEC;
+        pthread_cond_timedwait(&_watchdog_.cond, &_watchdog_.lock, &deadline);
+    }
+
+    return NULL;
+}
+
+/* Threads do not survive fork(), a worker starts its own watchdog with its first timed case. */
+static void reset_watchdog_in_child(void)
+{
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    _watchdog_.pid = 0;
+    _watchdog_.lock = lock;
+    if (_watchdog_.slot_list != NULL)
+        memset(_watchdog_.slot_list, 0, _watchdog_.slot_count * sizeof(watchdog_slot_t));
+}
+
+static bool start_watchdog(void)
+{
+    if (_watchdog_.pid == getpid())
+        return true;
+
+    if (!_is_watchdog_atfork_set_)
+    {
+        if (pthread_atfork(NULL, NULL, reset_watchdog_in_child) != 0)
+        {
+            PRINT_INTERNAL_ERROR("pthread_atfork(): %m");
+            return false;
+        }
+        _is_watchdog_atfork_set_ = true;
+    }
+
+    if (_watchdog_.slot_list == NULL)
+    {
+        int slot_count = (UT_FLAG(threads) > 1) ? UT_FLAG(threads) : 1;
+        _watchdog_.slot_list = (watchdog_slot_t*)calloc(slot_count, sizeof(watchdog_slot_t));
+        if (_watchdog_.slot_list == NULL)
+        {
+            PRINT_INTERNAL_ERROR("calloc(%d): %m", slot_count * sizeof(watchdog_slot_t));
+            return false;
+        }
+        _watchdog_.slot_count = slot_count;
+    }
+
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&_watchdog_.cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    open_spare_console();
+
+    /* backtrace() loads libgcc on its first call, which must not happen in the signal handler. */
+    void* frame;
+    backtrace(&frame, 1);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = park_stuck_thread;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGURG, &action, NULL) == -1)
+    {
+        PRINT_INTERNAL_ERROR("sigaction(SIGURG): %m");
+        return false;
+    }
+
+    /* The watchdog must never get the SIGURG meant for a case thread. */
+    sigset_t signal_set;
+    sigset_t old_signal_set;
+    sigemptyset(&signal_set);
+    sigaddset(&signal_set, SIGURG);
+    pthread_sigmask(SIG_BLOCK, &signal_set, &old_signal_set);
+    int ret = pthread_create(&_watchdog_.thread, NULL, run_watchdog, NULL);
+    pthread_sigmask(SIG_SETMASK, &old_signal_set, NULL);
+    if (ret != 0)
+    {
+        PRINT_INTERNAL_ERROR("pthread_create(): %s", strerror(ret));
+        return false;
+    }
+
+    pthread_detach(_watchdog_.thread);
+    _watchdog_.pid = getpid();
+    return true;
+}
+
+void begin_case_watchdog(const test_case_t *test_case)
+{
+    int timeout = get_case_timeout(test_case);
+    if (timeout <= 0)
+        return;
+
+    pthread_mutex_lock(&_watchdog_.lock);
+    if (start_watchdog())
+    {
+        int i;
+        for (i = 0; i < _watchdog_.slot_count; i++)
+        {
+            watchdog_slot_t *slot = &_watchdog_.slot_list[i];
+            if (slot->used)
+                continue;
+
+            slot->used = true;
+            slot->timed_out = false;
+            slot->thread = pthread_self();
+            slot->test_case = test_case;
+            slot->timeout = timeout;
+            slot->deadline = get_monotonic_time() + (uint64_t)timeout * NSEC_PER_MSEC;
+            _case_slot_ = slot;
+            pthread_cond_signal(&_watchdog_.cond);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&_watchdog_.lock);
+}
+
+void end_case_watchdog(void)
+{
+    if (_case_slot_ == NULL)
+        return;
+
+    pthread_mutex_lock(&_watchdog_.lock);
+    _case_slot_->used = false;
+    pthread_mutex_unlock(&_watchdog_.lock);
+    _case_slot_ = NULL;
+}
@@ -0,0 +1,772 @@
+#define _GNU_SOURCE
+#include "zcut.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
+
+static const int STOP_WORKER = -1;
+static const int NO_CASE = -1;
+
+/*
+ * A worker of an ISOLATED_SUITE is a process forked for one case, which leaves its result in the shared memory file
+ * `shm_fd' and exits; the hang-up of its result pipe tells the case is done. It has no command pipe.
+ */
+typedef struct worker_t
+{
+    pid_t   pid;
+    int     cmd_fd;
+    int     result_fd;
+    int     shm_fd;
+    int     case_index;
+}worker_t;
+
+typedef struct worker_result_t
+{
+    int                 case_index;
+    bool                setup_passed;
+    uint64_t            setup_time;
+    fixture_result_t    teardown;
+    case_result_t       result;
+}worker_result_t;
+
+/* Follows worker_result_t once per failure record, with the strings right behind it, in this order. */
+typedef struct worker_failure_t
+{
+    int     line;
+    int     file_len;
+    int     expected_len;
+    int     actual_len;
+    int     user_msg_len;
+}worker_failure_t;
+
+/* What a worker needs to send the result of a case its watchdog timed out, from the watchdog thread. */
+typedef struct worker_context_t
+{
+    int                 result_fd;
+    worker_result_t     *message;
+}worker_context_t;
+
+typedef struct worker_pool_t
+{
+    const test_suite_t  *test_suite;
+    worker_t            *worker_list;
+    int                 worker_count;
+    bool                *started_list;
+    int                 next_case;
+    bool                isolated;
+    bool                stopped;
+    bool                passed;
+}worker_pool_t;
+
+static int read_cpu_quota_v2(const char* path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return 0;
+
+    char quota[64];
+    long period = 0;
+    int cpu_count = 0;
+    if (fscanf(file, "%63s %ld", quota, &period) == 2 && strcmp(quota, "max") != 0 && period > 0)
+        cpu_count = (int)((strtol(quota, NULL, 10) + period - 1) / period);
+
+    fclose(file);
+    return cpu_count;
+}
+
+static int read_cpu_quota_v1(const char* quota_path, const char* period_path)
+{
+    FILE *file = fopen(quota_path, "r");
+    if (file == NULL)
+        return 0;
+    long quota = -1;
+    if (fscanf(file, "%ld", &quota) != 1)
+        quota = -1;
+    fclose(file);
+
+    file = fopen(period_path, "r");
+    if (file == NULL)
+        return 0;
+    long period = 0;
+    if (fscanf(file, "%ld", &period) != 1)
+        period = 0;
+    fclose(file);
+
+    if (quota <= 0 || period <= 0)
+        return 0;
+
+    return (int)((quota + period - 1) / period);
+}
+
+static int get_cgroup_cpu_quota(void)
+{
+    char path[PATH_MAX];
+    char line[MAX_STR_LEN];
+    int cpu_count = 0;
+
+    FILE *file = fopen("/proc/self/cgroup", "r");
+    if (file != NULL)
+    {
+        while (cpu_count == 0 && fgets(line, sizeof(line), file) != NULL)
+        {
+            if (strncmp(line, "0::", 3) != 0)
+                continue;
+
+            line[strcspn(line, "\n")] = '\0';
+            snprintf(path, sizeof(path), "/sys/fs/cgroup%s/cpu.max", line + 3);
+            cpu_count = read_cpu_quota_v2(path);
+        }
+        fclose(file);
+    }
+
+    if (cpu_count == 0)
+        cpu_count = read_cpu_quota_v2("/sys/fs/cgroup/cpu.max");
+    if (cpu_count == 0)
+        cpu_count = read_cpu_quota_v1("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+    if (cpu_count == 0)
+        cpu_count = read_cpu_quota_v1("/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_quota_us",
+                                      "/sys/fs/cgroup/cpu,cpuacct/cpu.cfs_period_us");
+
+    return cpu_count;
+}
+
+int get_auto_job_count(void)
+{
+    int cpu_count = 0;
+    cpu_set_t cpu_set;
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0)
+        cpu_count = CPU_COUNT(&cpu_set);
+    if (cpu_count <= 0)
+        cpu_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    int quota = get_cgroup_cpu_quota();
+    if (quota > 0 && quota < cpu_count)
+        cpu_count = quota;
+
+    return cpu_count > 0 ? cpu_count : 1;
+}
+
+static bool write_all(int fd, const void* buf, size_t len)
+{
+    const char* data = (const char*)buf;
+    while (len > 0)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+
+        data += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+static bool read_all(int fd, void* buf, size_t len)
+{
+    char* data = (char*)buf;
+    while (len > 0)
+    {
+        ssize_t n = read(fd, data, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+
+        data += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+static bool run_worker_setup_teardown(setup_teardown_func_t setup_teardown_func, uint64_t *time)
+{
+    *time = 0;
+    if (setup_teardown_func == 0)
+        return true;
+
+    uint64_t begin = get_monotonic_time();
+    bool ret = (*setup_teardown_func)();
+    *time = get_monotonic_time() - begin;
+    return ret;
+}
+
+static bool write_worker_failure_list(int fd, const case_result_t *result)
+{
+    const assertion_failure_t *failure;
+    for (failure = result->failure_list; failure != NULL; failure = failure->next)
+    {
+        worker_failure_t header;
+        header.line = failure->line;
+        header.file_len = (int)strnlen(failure->file, MAX_STR_LEN - 1);
+        header.expected_len = (int)strlen(failure->expected);
+        header.actual_len = (int)strlen(failure->actual);
+        header.user_msg_len = (int)strlen(failure->user_msg);
+
+        if (!write_all(fd, &header, sizeof(header))
+            || !write_all(fd, failure->file, header.file_len)
+            || !write_all(fd, failure->expected, header.expected_len)
+            || !write_all(fd, failure->actual, header.actual_len)
+            || !write_all(fd, failure->user_msg, header.user_msg_len))
+            return false;
+    }
+
+    return true;
+}
+
+static bool read_worker_str(int fd, char* str, int len)
+{
+    if (len < 0 || len >= MAX_STR_LEN || !read_all(fd, str, len))
+        return false;
+
+    str[len] = '\0';
+    return true;
+}
+
+/* The records land in the arena of this process, the list pointers which came along with the result are stale. */
+static bool read_worker_failure_list(int fd, case_result_t *result)
+{
+    int failure_count = result->failure_count;
+    result->failure_count = 0;
+    result->failure_list = NULL;
+    result->last_failure = NULL;
+
+    char file[MAX_STR_LEN];
+    char expected[MAX_STR_LEN];
+    char actual[MAX_STR_LEN];
+    char user_msg[MAX_STR_LEN];
+    int i;
+    for (i = 0; i < failure_count; i++)
+    {
+        worker_failure_t header;
+        if (!read_all(fd, &header, sizeof(header))
+            || !read_worker_str(fd, file, header.file_len)
+            || !read_worker_str(fd, expected, header.expected_len)
+            || !read_worker_str(fd, actual, header.actual_len)
+            || !read_worker_str(fd, user_msg, header.user_msg_len))
+            return false;
+
+        add_assertion_failure(result, file, header.line, expected, actual, user_msg);
+    }
+
+    return true;
+}
+
+static worker_context_t _worker_context_;
+
+/* The case teardown is skipped, the stuck case may still hold what it would release; the parent spawns a new worker. */
+static void send_timed_out_case(const test_case_t *test_case)
+{
+    worker_result_t *message = _worker_context_.message;
+    message->result = *test_case->result;
+    message->teardown.passed = true;
+    if (write_all(_worker_context_.result_fd, message, sizeof(*message)))
+        write_worker_failure_list(_worker_context_.result_fd, &message->result);
+    _exit(EXIT_FAILURE);
+}
+
+static void init_worker(void)
+{
+    set_print_muted(true);
+    close_perf_counters();
+    set_case_timeout_handler(send_timed_out_case);
+}
+
+static bool run_worker_case(const test_suite_t *test_suite, int case_index, int result_fd)
+{
+    const test_case_t *test_case = test_suite->case_list[case_index];
+    worker_result_t message;
+    memset(&message, 0, sizeof(message));
+    message.case_index = case_index;
+    _worker_context_.result_fd = result_fd;
+    _worker_context_.message = &message;
+
+    message.setup_passed = run_worker_setup_teardown(*test_suite->case_setup, &message.setup_time);
+    if (message.setup_passed)
+    {
+        begin_test_case(test_suite, test_case);
+        exec_test_case(test_case);
+        message.teardown.setup_teardown = TEARDOWN;
+        bool fixture_passed = retry_test_case(test_suite, test_case, &message.teardown);
+        message.result = *test_case->result;
+        if (fixture_passed)
+            message.teardown.passed = run_worker_setup_teardown(*test_suite->case_teardown, &message.teardown.time);
+    }
+
+    fflush(stdout);
+    return write_all(result_fd, &message, sizeof(message)) && write_worker_failure_list(result_fd, &message.result);
+}
+
+static void run_worker(const test_suite_t *test_suite, int cmd_fd, int result_fd)
+{
+    init_worker();
+
+    int case_index;
+    while (read_all(cmd_fd, &case_index, sizeof(case_index)) && case_index != STOP_WORKER)
+    {
+        if (!run_worker_case(test_suite, case_index, result_fd))
+            break;
+    }
+
+    fflush(stdout);
+    _exit(EXIT_SUCCESS);
+}
+
+static void run_isolated_worker(const test_suite_t *test_suite, int case_index, int shm_fd)
+{
+    init_worker();
+    run_worker_case(test_suite, case_index, shm_fd);
+    _exit(EXIT_SUCCESS);
+}
+
+static void close_worker(worker_t *worker)
+{
+    if (worker->cmd_fd >= 0)
+        close(worker->cmd_fd);
+    if (worker->result_fd >= 0)
+        close(worker->result_fd);
+
+    worker->cmd_fd = -1;
+    worker->result_fd = -1;
+}
+
+/* The result file of an isolated worker is created once, and reused by every case the worker slot runs. */
+static bool open_isolated_worker(worker_t *worker)
+{
+    if (worker->shm_fd >= 0)
+        return true;
+
+    worker->shm_fd = memfd_create("zcut-case-result", MFD_CLOEXEC);
+    if (worker->shm_fd == -1)
+    {
+        PRINT_INTERNAL_ERROR("memfd_create(): %m");
+        return false;
+    }
+    return true;
+}
+
+static bool spawn_worker(worker_pool_t *pool, worker_t *worker)
+{
+    if (pool->isolated)
+        return open_isolated_worker(worker);
+
+    int cmd_pipe[2];
+    int result_pipe[2];
+    if (pipe(cmd_pipe) == -1)
+    {
+        PRINT_INTERNAL_ERROR("pipe(): %m");
+        return false;
+    }
+    if (pipe(result_pipe) == -1)
+    {
+        PRINT_INTERNAL_ERROR("pipe(): %m");
+        close(cmd_pipe[0]);
+        close(cmd_pipe[1]);
+        return false;
+    }
+
+    drain_report_queue();
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        PRINT_INTERNAL_ERROR("fork(): %m");
+        close(cmd_pipe[0]);
+        close(cmd_pipe[1]);
+        close(result_pipe[0]);
+        close(result_pipe[1]);
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        int i;
+        for (i = 0; i < pool->worker_count; i++)
+            close_worker(&pool->worker_list[i]);
+        close(cmd_pipe[1]);
+        close(result_pipe[0]);
+        run_worker(pool->test_suite, cmd_pipe[0], result_pipe[1]);
+    }
+
+    close(cmd_pipe[0]);
+    close(result_pipe[1]);
+    worker->pid = pid;
+    worker->cmd_fd = cmd_pipe[1];
+    worker->result_fd = result_pipe[0];
+    worker->case_index = NO_CASE;
+    return true;
+}
+
+/*
+ * Forks the case from the main process, which holds the state SUITE_SETUP left and never runs a case of the suite
+ * itself, so every case starts from that state, copied on write.
+ */
+static bool fork_isolated_worker(worker_pool_t *pool, worker_t *worker, int case_index)
+{
+    int result_pipe[2];
+    if (ftruncate(worker->shm_fd, 0) == -1 || lseek(worker->shm_fd, 0, SEEK_SET) == -1)
+    {
+        PRINT_INTERNAL_ERROR("ftruncate(): %m");
+        return false;
+    }
+    if (pipe(result_pipe) == -1)
+    {
+        PRINT_INTERNAL_ERROR("pipe(): %m");
+        return false;
+    }
+
+    drain_report_queue();
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        PRINT_INTERNAL_ERROR("fork(): %m");
+        close(result_pipe[0]);
+        close(result_pipe[1]);
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        int i;
+        for (i = 0; i < pool->worker_count; i++)
+            close_worker(&pool->worker_list[i]);
+        close(result_pipe[0]);
+        run_isolated_worker(pool->test_suite, case_index, worker->shm_fd);
+    }
+
+    close(result_pipe[1]);
+    worker->pid = pid;
+    worker->result_fd = result_pipe[0];
+    worker->case_index = case_index;
+    return true;
+}
+
+static void stop_worker(worker_t *worker)
+{
+    if (worker->pid <= 0)
+        return;
+
+    if (worker->cmd_fd >= 0)
+        write_all(worker->cmd_fd, &STOP_WORKER, sizeof(STOP_WORKER));
+
+    close_worker(worker);
+    while (waitpid(worker->pid, NULL, 0) == -1 && errno == EINTR)
+        ;
+    worker->pid = 0;
+}
+
+/* `next_case' is the first case not started yet, the cases after it may be started before it for resources. */
+static void start_case(worker_pool_t *pool, int case_index)
+{
+    pool->started_list[case_index] = true;
+    while (pool->next_case < pool->test_suite->case_count && pool->started_list[pool->next_case])
+        pool->next_case++;
+}
+
+/* The first case whose resources are free, the cases waiting for theirs go once a running case releases them. */
+static int get_next_case(worker_pool_t *pool)
+{
+    const test_suite_t *test_suite = pool->test_suite;
+    int case_index;
+    for (case_index = pool->next_case; !pool->stopped && case_index < test_suite->case_count; case_index++)
+    {
+        const test_case_t *test_case = test_suite->case_list[case_index];
+        if (pool->started_list[case_index])
+            continue;
+        if (skip_over_budget_case(test_suite, test_case))
+        {
+            start_case(pool, case_index);
+            continue;
+        }
+        if (!acquire_case_resources(test_suite, test_case))
+            continue;
+
+        start_case(pool, case_index);
+        if (begin_test_case(test_suite, test_case))
+            return case_index;
+
+        release_case_resources(test_suite, test_case);
+        calc_suite_case_result(test_suite->result, test_case->result);
+    }
+
+    return NO_CASE;
+}
+
+static bool has_next_case(worker_pool_t *pool)
+{
+    return !pool->stopped && pool->next_case < pool->test_suite->case_count;
+}
+
+static void dispatch_case(worker_pool_t *pool, worker_t *worker)
+{
+    int case_index = get_next_case(pool);
+    if (case_index == NO_CASE)
+        return;
+
+    if (pool->isolated)
+    {
+        if (!fork_isolated_worker(pool, worker, case_index))
+        {
+            pool->stopped = true;
+            pool->passed = false;
+        }
+        return;
+    }
+
+    worker->case_index = case_index;
+    if (!write_all(worker->cmd_fd, &case_index, sizeof(case_index)))
+        PRINT_INTERNAL_ERROR("write(worker %d): %m", worker->pid);
+}
+
+static void print_worker_setup_teardown(test_type_t setup_teardown, setup_teardown_func_t func, bool passed,
+                                        uint64_t time)
+{
+    if (func == 0)
+        return;
+
+    report_setup_teardown_begin(CASE, setup_teardown);
+    report_setup_teardown_end(CASE, setup_teardown, passed, time);
+}
+
+static void complete_worker_case(worker_pool_t *pool, const worker_result_t *message)
+{
+    const test_suite_t *test_suite = pool->test_suite;
+    const test_case_t *test_case = test_suite->case_list[message->case_index];
+    release_case_resources(test_suite, test_case);
+
+    print_worker_setup_teardown(SETUP, *test_suite->case_setup, message->setup_passed, message->setup_time);
+    if (!message->setup_passed)
+    {
+        test_case->result->accessed = false;
+        pool->stopped = true;
+        pool->passed = false;
+        return;
+    }
+
+    *test_case->result = message->result;
+    report_case_replay(test_suite, test_case);
+    calc_suite_case_result(test_suite->result, test_case->result);
+    if (message->result.is_timed_out)
+        return;
+
+    /* A retry which failed its setup or teardown sends it as the teardown, the case teardown did not run again. */
+    const fixture_result_t *teardown = &message->teardown;
+    setup_teardown_func_t teardown_func = (teardown->setup_teardown == SETUP) ? *test_suite->case_setup
+                                                                              : *test_suite->case_teardown;
+    print_worker_setup_teardown(teardown->setup_teardown, teardown_func, teardown->passed, teardown->time);
+    if (!teardown->passed)
+    {
+        pool->stopped = true;
+        pool->passed = false;
+    }
+}
+
+static void fail_crashed_worker_case(worker_pool_t *pool, worker_t *worker)
+{
+    int status = 0;
+    while (waitpid(worker->pid, &status, 0) == -1 && errno == EINTR)
+        ;
+
+    const test_case_t *test_case = pool->test_suite->case_list[worker->case_index];
+    release_case_resources(pool->test_suite, test_case);
+    case_result_t *result = test_case->result;
+    result->passed = false;
+    result->fail_assertion_count = 1;
+    result->assertion_count = 1;
+    if (WIFSIGNALED(status))
+        save_assertion_info(result, test_case->file, test_case->line, EMPTY_STR, EMPTY_STR,
+                            "worker process %d was killed by signal %d (%s)",
+                            worker->pid, WTERMSIG(status), strsignal(WTERMSIG(status)));
+    else
+        save_assertion_info(result, test_case->file, test_case->line, EMPTY_STR, EMPTY_STR,
+                            "worker process %d exited with status %d while running the case",
+                            worker->pid, WEXITSTATUS(status));
+
+    report_case_replay(pool->test_suite, test_case);
+    calc_suite_case_result(pool->test_suite->result, result);
+
+    close_worker(worker);
+    worker->pid = 0;
+    worker->case_index = NO_CASE;
+
+    if (UT_FLAG(break_on_failure))
+        abort();
+}
+
+/* The result pipe hangs up when the case process exits, its result is complete in the shared file by then. */
+static bool handle_isolated_worker_result(worker_pool_t *pool, worker_t *worker)
+{
+    worker_result_t message;
+    if (lseek(worker->shm_fd, 0, SEEK_SET) == -1 || !read_all(worker->shm_fd, &message, sizeof(message))
+        || !read_worker_failure_list(worker->shm_fd, &message.result))
+    {
+        fail_crashed_worker_case(pool, worker);
+        return false;
+    }
+
+    close_worker(worker);
+    while (waitpid(worker->pid, NULL, 0) == -1 && errno == EINTR)
+        ;
+    worker->pid = 0;
+    worker->case_index = NO_CASE;
+    complete_worker_case(pool, &message);
+    return true;
+}
+
+static bool handle_worker_result(worker_pool_t *pool, worker_t *worker)
+{
+    if (pool->isolated)
+        return handle_isolated_worker_result(pool, worker);
+
+    worker_result_t message;
+    if (!read_all(worker->result_fd, &message, sizeof(message))
+        || !read_worker_failure_list(worker->result_fd, &message.result))
+    {
+        fail_crashed_worker_case(pool, worker);
+        return false;
+    }
+
+    worker->case_index = NO_CASE;
+    complete_worker_case(pool, &message);
+    if (!message.result.is_timed_out)
+        return true;
+
+    /* The worker exits after a timed out case, with the case thread stuck in it. */
+    close_worker(worker);
+    while (waitpid(worker->pid, NULL, 0) == -1 && errno == EINTR)
+        ;
+    worker->pid = 0;
+    return false;
+}
+
+static int poll_workers(worker_pool_t *pool, struct pollfd *fd_list)
+{
+    int i;
+    int busy_count = 0;
+    for (i = 0; i < pool->worker_count; i++)
+    {
+        worker_t *worker = &pool->worker_list[i];
+        fd_list[i].fd = (worker->case_index != NO_CASE) ? worker->result_fd : -1;
+        fd_list[i].events = POLLIN;
+        fd_list[i].revents = 0;
+        if (worker->case_index != NO_CASE)
+            busy_count++;
+    }
+
+    if (busy_count == 0)
+        return 0;
+
+    while (poll(fd_list, pool->worker_count, -1) == -1)
+    {
+        if (errno != EINTR)
+        {
+            PRINT_INTERNAL_ERROR("poll(): %m");
+            return -1;
+        }
+    }
+
+    return busy_count;
+}
+
+static bool is_worker_idle(const worker_pool_t *pool, const worker_t *worker)
+{
+    return worker->case_index == NO_CASE && (pool->isolated ? worker->shm_fd >= 0 : worker->pid > 0);
+}
+
+/* Every idle worker, not only the ones which just finished, as a finished case may free the resources of others. */
+static void dispatch_idle_workers(worker_pool_t *pool)
+{
+    int i;
+    for (i = 0; i < pool->worker_count && has_next_case(pool); i++)
+    {
+        worker_t *worker = &pool->worker_list[i];
+        if (is_worker_idle(pool, worker))
+            dispatch_case(pool, worker);
+    }
+}
+
+static void run_worker_pool(worker_pool_t *pool, struct pollfd *fd_list)
+{
+    int i;
+    for (i = 0; i < pool->worker_count; i++)
+        spawn_worker(pool, &pool->worker_list[i]);
+    dispatch_idle_workers(pool);
+
+    while (poll_workers(pool, fd_list) > 0)
+    {
+        for (i = 0; i < pool->worker_count; i++)
+        {
+            worker_t *worker = &pool->worker_list[i];
+            if (fd_list[i].revents != 0 && !handle_worker_result(pool, worker) && has_next_case(pool))
+                spawn_worker(pool, worker);
+        }
+        dispatch_idle_workers(pool);
+    }
+
+    for (i = 0; i < pool->worker_count; i++)
+        stop_worker(&pool->worker_list[i]);
+}
+
+bool run_suite_cases_in_workers(const test_suite_t *test_suite)
+{
+    if (test_suite->case_count == 0)
+        return true;
+
+    worker_pool_t pool;
+    memset(&pool, 0, sizeof(pool));
+    pool.test_suite = test_suite;
+    pool.worker_count = UT_FLAG(jobs) < test_suite->case_count ? UT_FLAG(jobs) : test_suite->case_count;
+    pool.isolated = *test_suite->isolated;
+    pool.passed = true;
+
+    pool.worker_list = (worker_t*)calloc(pool.worker_count, sizeof(worker_t));
+    pool.started_list = (bool*)calloc(test_suite->case_count, sizeof(bool));
+    struct pollfd *fd_list = (struct pollfd*)calloc(pool.worker_count, sizeof(struct pollfd));
+    if (pool.worker_list == NULL || pool.started_list == NULL || fd_list == NULL)
+    {
+        PRINT_INTERNAL_ERROR("calloc(%d): %m", pool.worker_count);
+        free(pool.worker_list);
+        free(pool.started_list);
+        free(fd_list);
+        return false;
+    }
+
+    int i;
+    for (i = 0; i < pool.worker_count; i++)
+    {
+        pool.worker_list[i].cmd_fd = -1;
+        pool.worker_list[i].result_fd = -1;
+        pool.worker_list[i].shm_fd = -1;
+        pool.worker_list[i].case_index = NO_CASE;
+    }
+
+    void (*sigpipe_handler)(int) = signal(SIGPIPE, SIG_IGN);
+    run_worker_pool(&pool, fd_list);
+    signal(SIGPIPE, sigpipe_handler);
+
+    for (i = 0; i < pool.worker_count; i++)
+    {
+        if (pool.worker_list[i].shm_fd >= 0)
+            close(pool.worker_list[i].shm_fd);
+    }
+
+    free_case_resources();
+    free(pool.worker_list);
+    free(pool.started_list);
+    free(fd_list);
+    return pool.passed;
+}
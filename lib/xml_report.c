@@ -0,0 +1,583 @@
+#define _GNU_SOURCE
+#include "zcut.h"
+
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
+#define XML_BUFFER_SIZE     (64 * 1024)
+#define XML_RESERVED_LEN    160
+
+char UT_FLAG(xml_path)[MAX_STR_LEN];
+
+static const int INDENT = 2;
+static const uint64_t XML_FLUSH_INTERVAL = 100000000ULL;
+static char* SKIPPED        = "SKIPPED";
+static char* FILTERED_OUT   = "FILTERED_OUT";
+static char* PASSED         = "PASSED";
+static char* FAILED         = "FAILED";
+static char* FLAKY          = "FLAKY";
+static char* QUARANTINED    = "QUARANTINED";
+static char* TIMEOUT        = "TIMEOUT";
+static char* CRASHED        = "CRASHED";
+static char* INCOMPLETE     = "INCOMPLETE";
+
+/*
+ * The report is streamed while the runner runs: every element goes into one buffer, which is written out together
+ * with the closing tags of the elements still open, and the next write starts over those closing tags. So the file
+ * on disk is always a whole document, which lags the last completed case by at most XML_FLUSH_INTERVAL; a failed
+ * case is written out at once. The summary attributes of <ut> and <test_suite> are only known at their end, their
+ * opening tags reserve room for them, and say result="INCOMPLETE" until then. One bit per case of the open suite
+ * remembers what was written, a case may be listed by several suites and its result is then not its state here.
+ */
+typedef struct xml_report_t
+{
+    const test_runner_t *test_runner;
+    int                 fd;
+    char                path[PATH_MAX];
+    char                buffer[XML_BUFFER_SIZE];
+    size_t              buffer_len;
+    off_t               committed;
+    off_t               file_end;
+    off_t               runner_attr_offset;
+    off_t               suite_attr_offset;
+    bool                suite_open;
+    const test_suite_t  *suite;
+    unsigned char       *written_case_bitmap;
+    int                 bitmap_capacity;
+    int                 case_cursor;
+    int                 written_suite_count;
+    uint64_t            flush_time;
+    bool                failed;
+}xml_report_t;
+
+static xml_report_t _xml_report_ = {.fd = -1};
+
+static bool get_xml_path_default(const char* test_bin_name, int repeat, char xml_path[PATH_MAX])
+{
+    if (strlen(UT_FLAG(xml_path)) != 0)
+        return false;
+
+    if (repeat > 0)
+        snprintf(xml_path, PATH_MAX, "%s_%d.xml", test_bin_name, repeat);
+    else
+        snprintf(xml_path, PATH_MAX, "%s.xml", test_bin_name);
+
+    return true;
+}
+
+static bool get_xml_path_with_dir(const char* test_bin_name, int repeat, char xml_path[PATH_MAX])
+{
+    struct stat fs;
+    if (stat(UT_FLAG(xml_path), &fs) == -1)
+        return false;
+
+    if (!S_ISDIR(fs.st_mode))
+        return false;
+
+    if (repeat > 0)
+        snprintf(xml_path, PATH_MAX, "%s/%s_%d.xml", UT_FLAG(xml_path), test_bin_name, repeat);
+    else
+        snprintf(xml_path, PATH_MAX, "%s/%s.xml", UT_FLAG(xml_path), test_bin_name);
+
+    return true;
+}
+
+static bool get_xml_path(const char* test_bin_name, int repeat, char xml_path[PATH_MAX])
+{
+    if (get_xml_path_default(test_bin_name, repeat, xml_path))
+        return true;
+
+    if (get_xml_path_with_dir(test_bin_name, repeat, xml_path))
+        return true;
+
+    snprintf(xml_path, PATH_MAX, "%s", UT_FLAG(xml_path));
+    return true;
+}
+
+static double get_time_ms(uint64_t time)
+{
+    return time / 1e6;
+}
+
+static bool is_xml_report_open(void)
+{
+    return _xml_report_.fd != -1;
+}
+
+static void fail_xml_report(const char* func)
+{
+    xml_report_t *report = &_xml_report_;
+    fprintf(stderr, "%s(%s): %m\n", func, report->path);
+    close(report->fd);
+    report->fd = -1;
+    report->failed = true;
+}
+
+static size_t get_xml_tail(bool suite_open, char* tail, size_t size)
+{
+    if (suite_open)
+        return snprintf(tail, size, "%*c</test_suite>\n</ut>\n", INDENT, ' ');
+
+    return snprintf(tail, size, "</ut>\n");
+}
+
+/* Without the tail only while a single element is larger than the buffer. */
+static void flush_xml_report(bool with_tail)
+{
+    xml_report_t *report = &_xml_report_;
+    if (!is_xml_report_open())
+        return;
+
+    char tail[64];
+    struct iovec iov[2];
+    iov[0].iov_base = report->buffer;
+    iov[0].iov_len = report->buffer_len;
+    iov[1].iov_base = tail;
+    iov[1].iov_len = with_tail ? get_xml_tail(report->suite_open, tail, sizeof(tail)) : 0;
+
+    size_t len = iov[0].iov_len + iov[1].iov_len;
+    if (pwritev(report->fd, iov, 2, report->committed) != (ssize_t)len)
+    {
+        fail_xml_report("pwritev");
+        return;
+    }
+
+    off_t end = report->committed + len;
+    if (end < report->file_end && ftruncate(report->fd, end) == -1)
+    {
+        fail_xml_report("ftruncate");
+        return;
+    }
+
+    report->committed += report->buffer_len;
+    report->file_end = end;
+    report->buffer_len = 0;
+    report->flush_time = get_monotonic_time();
+}
+
+static void append_xml(const char* data, size_t len)
+{
+    xml_report_t *report = &_xml_report_;
+    while (len > 0 && is_xml_report_open())
+    {
+        if (report->buffer_len == XML_BUFFER_SIZE)
+            flush_xml_report(false);
+
+        size_t copy_len = XML_BUFFER_SIZE - report->buffer_len;
+        if (copy_len > len)
+            copy_len = len;
+        memcpy(report->buffer + report->buffer_len, data, copy_len);
+        report->buffer_len += copy_len;
+        data += copy_len;
+        len -= copy_len;
+    }
+}
+
+/* Only for markup and numbers, text of any length goes through append_xml_escaped(). */
+static void append_xml_format(const char* format, ...)
+{
+    char str[MAX_STR_LEN];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(str, sizeof(str), format, args);
+    va_end(args);
+
+    if (len > 0)
+        append_xml(str, ((size_t)len < sizeof(str)) ? (size_t)len : sizeof(str) - 1);
+}
+
+static void append_xml_escaped(const char* string)
+{
+    while (*string)
+    {
+        size_t len = strcspn(string, "<>&'\"");
+        append_xml(string, len);
+        string += len;
+
+        const char* replace_str;
+        switch (*string)
+        {
+        case '<':
+            replace_str = "&lt;";
+            break;
+        case '>':
+            replace_str = "&gt;";
+            break;
+        case '&':
+            replace_str = "&amp;";
+            break;
+        case '\'':
+            replace_str = "&apos;";
+            break;
+        case '\"':
+            replace_str = "&quot;";
+            break;
+        default:
+            return;
+        }
+
+        append_xml(replace_str, strlen(replace_str));
+        string++;
+    }
+}
+
+static void append_xml_attr(const char* name, const char* value)
+{
+    append_xml_format(" %s=\"", name);
+    append_xml_escaped(value);
+    append_xml("\"", 1);
+}
+
+/* The padding of the reserved room is whitespace inside the tag, which keeps the document well-formed. */
+static off_t reserve_xml_attr(void)
+{
+    xml_report_t *report = &_xml_report_;
+    off_t offset = report->committed + report->buffer_len;
+    char attr[XML_RESERVED_LEN + 1];
+    snprintf(attr, sizeof(attr), " result=\"%s\"", INCOMPLETE);
+    append_xml_format("%-*s", XML_RESERVED_LEN, attr);
+    return offset;
+}
+
+static void fill_xml_attr(off_t offset, const char* format, ...)
+{
+    xml_report_t *report = &_xml_report_;
+    if (!is_xml_report_open())
+        return;
+
+    char attr[XML_RESERVED_LEN + 1];
+    char padded_attr[XML_RESERVED_LEN + 1];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(attr, sizeof(attr), format, args);
+    va_end(args);
+    snprintf(padded_attr, sizeof(padded_attr), "%-*s", XML_RESERVED_LEN, attr);
+
+    /* The room may straddle the written out part and the buffer. */
+    size_t file_len = 0;
+    if (offset < report->committed)
+    {
+        file_len = (offset + XML_RESERVED_LEN <= report->committed) ? XML_RESERVED_LEN
+                                                                     : (size_t)(report->committed - offset);
+        if (pwrite(report->fd, padded_attr, file_len, offset) != (ssize_t)file_len)
+        {
+            fail_xml_report("pwrite");
+            return;
+        }
+    }
+    if (file_len < XML_RESERVED_LEN)
+        memcpy(report->buffer + (offset + file_len - report->committed), padded_attr + file_len,
+               XML_RESERVED_LEN - file_len);
+}
+
+static const char* get_case_result_str(const case_result_t *case_result)
+{
+    if (!case_result->accessed)
+        return SKIPPED;
+    if (case_result->is_filtered_out)
+        return FILTERED_OUT;
+    if (case_result->is_flaky)
+        return FLAKY;
+    if (case_result->passed)
+        return PASSED;
+    if (case_result->is_timed_out)
+        return TIMEOUT;
+    if (case_result->is_crashed)
+        return CRASHED;
+    if (case_result->is_quarantined)
+        return QUARANTINED;
+    return FAILED;
+}
+
+/* Attribute names follow the `user_time' style, `cache-misses' becomes `cache_misses'. */
+static void append_perf_counter_result(const case_result_t *result)
+{
+    int i;
+    for (i = 0; i < PERF_COUNTER_COUNT; i++)
+    {
+        if ((result->perf_counter_mask & (1 << i)) == 0)
+            continue;
+
+        char name[MAX_STR_LEN];
+        snprintf(name, sizeof(name), "%s", get_perf_counter_name((perf_counter_t)i));
+        char* dash = strchr(name, '-');
+        if (dash != NULL)
+            *dash = '_';
+        append_xml_format(" %s=\"%llu\"", name, (unsigned long long)result->perf_counter_list[i]);
+    }
+}
+
+static void append_test_case_result(const test_case_t *test_case, int indent)
+{
+    const case_result_t *case_result = test_case->result;
+    if (UT_FLAG(no_filtered_out_result) && case_result->is_filtered_out)
+        return;
+
+    bool has_message = case_result->accessed && !case_result->is_filtered_out && !case_result->passed
+                       && case_result->failure_list != NULL;
+    bool has_benchmark = test_case->benchmark != NULL && test_case->benchmark->sample_count > 0
+                         && case_result->accessed && !case_result->is_filtered_out;
+
+    append_xml_format("%*c<test_case", indent, ' ');
+    append_xml_attr("name", test_case->name);
+    append_xml_format(" result=\"%s\" assertion=\"%d\" time=\"%.6fms\" user_time=\"%.6fms\" system_time=\"%.6fms\"",
+                      get_case_result_str(case_result), case_result->assertion_count,
+                      get_time_ms(case_result->time), get_time_ms(case_result->user_time),
+                      get_time_ms(case_result->system_time));
+    if (case_result->retry_count > 0)
+        append_xml_format(" retry=\"%d\"", case_result->retry_count);
+    append_perf_counter_result(case_result);
+    append_xml_format(" alloc_count=\"%llu\" alloc_bytes=\"%llu\" peak_alloc_bytes=\"%llu\" "
+                      "unfreed_alloc_count=\"%llu\" leaked_bytes=\"%llu\"",
+                      (unsigned long long)case_result->alloc_count, (unsigned long long)case_result->alloc_bytes,
+                      (unsigned long long)case_result->peak_alloc_bytes,
+                      (unsigned long long)case_result->unfreed_alloc_count,
+                      (unsigned long long)case_result->unfreed_alloc_bytes);
+    append_xml_format("%s>\n", (has_message || has_benchmark) ? "" : "/");
+
+    const assertion_failure_t *failure;
+    for (failure = case_result->failure_list; has_message && failure != NULL; failure = failure->next)
+    {
+        append_xml_format("%*c<message", indent + INDENT, ' ');
+        append_xml_attr("file", failure->file);
+        append_xml_format(" line=\"%d\"", failure->line);
+        append_xml_attr("expected", failure->expected);
+        append_xml_attr("actual", failure->actual);
+        append_xml_attr("user_msg", failure->user_msg);
+        append_xml("/>\n", 3);
+    }
+    if (has_benchmark)
+    {
+        const benchmark_result_t *benchmark = test_case->benchmark;
+        append_xml_format("%*c<benchmark iteration=\"%llu\" sample=\"%d\" median=\"%.3fns\" mean=\"%.3fns\" "
+                          "stddev=\"%.3fns\" min=\"%.3fns\" p99=\"%.3fns\"", indent + INDENT, ' ',
+                          (unsigned long long)benchmark->iteration_count, benchmark->sample_count,
+                          benchmark->median, benchmark->mean, benchmark->stddev, benchmark->min, benchmark->p99);
+        if (benchmark->compared)
+            append_xml_format(" baseline_median=\"%.3fns\" p_value=\"%.6f\"", benchmark->baseline_median,
+                              benchmark->p_value);
+        append_xml("/>\n", 3);
+    }
+    if (has_message || has_benchmark)
+        append_xml_format("%*c</test_case>\n", indent, ' ');
+}
+
+/* Flushing only between elements keeps the tail right, an element never starts in the second half. */
+static void flush_xml_report_if_due(bool now)
+{
+    xml_report_t *report = &_xml_report_;
+    if (now || report->buffer_len >= XML_BUFFER_SIZE / 2
+        || get_monotonic_time() - report->flush_time >= XML_FLUSH_INTERVAL)
+        flush_xml_report(true);
+}
+
+static void open_xml_report(const test_runner_t *test_runner, int repeat)
+{
+    xml_report_t *report = &_xml_report_;
+    report->failed = true;
+    if (!get_xml_path(test_runner->test_bin_name, repeat, report->path))
+        return;
+
+    report->fd = open(report->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (report->fd == -1)
+    {
+        fprintf(stderr, "open(%s, w): %m\n", report->path);
+        return;
+    }
+
+    report->test_runner = test_runner;
+    report->buffer_len = 0;
+    report->committed = 0;
+    report->file_end = 0;
+    report->suite_open = false;
+    report->written_suite_count = 0;
+    report->failed = false;
+
+    append_xml_format("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<ut");
+    append_xml_attr("name", test_runner->name);
+    report->runner_attr_offset = reserve_xml_attr();
+    append_xml(">\n", 2);
+    flush_xml_report(true);
+}
+
+/* Suites which never began, skipped ones and filtered out ones, are written in their turn. */
+static void write_xml_unrun_suite(const test_suite_t *test_suite)
+{
+    const suite_result_t *suite_result = test_suite->result;
+    if (UT_FLAG(no_filtered_out_result) && suite_result->is_filtered_out)
+        return;
+
+    append_xml_format("%*c<test_suite", INDENT, ' ');
+    append_xml_attr("name", test_suite->name);
+    append_xml_format(" result=\"%s\" test_case=\"%d\" assertion=\"0\" time=\"%.6fms\">\n%*c</test_suite>\n",
+                      suite_result->accessed ? FILTERED_OUT : SKIPPED, test_suite->case_count, get_time_ms(0),
+                      INDENT, ' ');
+}
+
+static void write_xml_previous_suites(const test_suite_t *test_suite)
+{
+    xml_report_t *report = &_xml_report_;
+    const test_runner_t *test_runner = report->test_runner;
+    while (report->written_suite_count < test_runner->suite_count)
+    {
+        const test_suite_t *next_suite = test_runner->suite_list[report->written_suite_count];
+        if (next_suite == test_suite)
+            break;
+
+        write_xml_unrun_suite(next_suite);
+        report->written_suite_count++;
+    }
+}
+
+static bool reset_written_case_bitmap(int case_count)
+{
+    xml_report_t *report = &_xml_report_;
+    int size = (case_count + CHAR_BIT - 1) / CHAR_BIT;
+    if (size > report->bitmap_capacity)
+    {
+        unsigned char *bitmap = (unsigned char*)realloc(report->written_case_bitmap, size);
+        if (bitmap == NULL)
+        {
+            PRINT_INTERNAL_ERROR("realloc(%d): %m", size);
+            return false;
+        }
+        report->written_case_bitmap = bitmap;
+        report->bitmap_capacity = size;
+    }
+
+    memset(report->written_case_bitmap, 0, size);
+    report->case_cursor = 0;
+    return true;
+}
+
+static bool is_case_written(int index)
+{
+    return (_xml_report_.written_case_bitmap[index / CHAR_BIT] & (1 << (index % CHAR_BIT))) != 0;
+}
+
+/* Cases complete about in their order, so the search from the last one is short. */
+static void mark_case_written(const test_case_t *test_case)
+{
+    xml_report_t *report = &_xml_report_;
+    int case_count = report->suite->case_count;
+    int i;
+    for (i = 0; i < case_count; i++)
+    {
+        int index = (report->case_cursor + i) % case_count;
+        if (report->suite->case_list[index] == test_case && !is_case_written(index))
+        {
+            report->written_case_bitmap[index / CHAR_BIT] |= 1 << (index % CHAR_BIT);
+            report->case_cursor = index + 1;
+            return;
+        }
+    }
+}
+
+static void write_xml_suite_begin(const test_suite_t *test_suite)
+{
+    xml_report_t *report = &_xml_report_;
+    if (!is_xml_report_open())
+        return;
+
+    if (!reset_written_case_bitmap(test_suite->case_count))
+    {
+        fail_xml_report("write");
+        return;
+    }
+
+    write_xml_previous_suites(test_suite);
+    append_xml_format("%*c<test_suite", INDENT, ' ');
+    append_xml_attr("name", test_suite->name);
+    report->suite_attr_offset = reserve_xml_attr();
+    append_xml(">\n", 2);
+    report->suite_open = true;
+    report->suite = test_suite;
+    flush_xml_report_if_due(false);
+}
+
+static void write_xml_case_result(const test_suite_t *test_suite ATTRIBUTE_UNUSED, const test_case_t *test_case,
+                                  const case_result_t *result)
+{
+    if (!is_xml_report_open() || !_xml_report_.suite_open)
+        return;
+
+    mark_case_written(test_case);
+    append_test_case_result(test_case, INDENT * 2);
+    flush_xml_report_if_due(!result->passed);
+}
+
+/* Cases which did not run here, filtered out or skipped after a failed setup, close the suite in declared order. */
+static void write_xml_suite_end(const test_suite_t *test_suite, const suite_result_t *suite_result)
+{
+    xml_report_t *report = &_xml_report_;
+    if (!is_xml_report_open() || !report->suite_open)
+        return;
+
+    int i;
+    for (i = 0; i < test_suite->case_count; i++)
+    {
+        if (!is_case_written(i))
+            append_test_case_result(test_suite->case_list[i], INDENT * 2);
+    }
+
+    fill_xml_attr(report->suite_attr_offset, " result=\"%s\" test_case=\"%d\" assertion=\"%d\" time=\"%.6fms\"",
+                  suite_result->passed ? PASSED : FAILED, test_suite->case_count, suite_result->assertion_count,
+                  get_time_ms(suite_result->time));
+    append_xml_format("%*c</test_suite>\n", INDENT, ' ');
+    report->suite_open = false;
+    report->written_suite_count++;
+    flush_xml_report_if_due(false);
+}
+
+static bool close_xml_report(const test_runner_t *test_runner)
+{
+    xml_report_t *report = &_xml_report_;
+    free(report->written_case_bitmap);
+    report->written_case_bitmap = NULL;
+    report->bitmap_capacity = 0;
+    if (!is_xml_report_open())
+        return !report->failed;
+
+    const runner_result_t *runner_result = test_runner->result;
+    if (runner_result->accessed)
+        write_xml_previous_suites(NULL);
+
+    const char* result;
+    if (!runner_result->accessed)
+        result = SKIPPED;
+    else if (runner_result->passed)
+        result = PASSED;
+    else
+        result = FAILED;
+    fill_xml_attr(report->runner_attr_offset,
+                  " result=\"%s\" test_suite=\"%d\" test_case=\"%d\" assertion=\"%d\" time=\"%.6fms\"", result,
+                  runner_result->suite_count, runner_result->case_count, runner_result->assertion_count,
+                  get_time_ms(runner_result->time));
+    flush_xml_report(true);
+    if (!is_xml_report_open())
+        return false;
+
+    if (close(report->fd) == -1)
+    {
+        fprintf(stderr, "close(%s): %m\n", report->path);
+        report->fd = -1;
+        return false;
+    }
+
+    report->fd = -1;
+    return true;
+}
+
+const reporter_t XML_REPORTER =
+{
+    .name           = "xml",
+    .runner_begin   = open_xml_report,
+    .runner_result  = close_xml_report,
+    .suite_begin    = write_xml_suite_begin,
+    .suite_end      = write_xml_suite_end,
+    .case_end       = write_xml_case_result
+};
@@ -1,32 +1,116 @@
+#define _GNU_SOURCE
 #include "zcut.h"
 
 #include <getopt.h>
 #include <libgen.h>
 #include <stdarg.h>
+#include <sys/resource.h>
 #include <time.h>
+#include <unistd.h>
 
 #define PRINT_INTERNAL_ERROR(msg...) print_error(__FILE__, __func__, __LINE__, EMPTY_STR msg)
-#define GET_TIME_OF_DAY(now)\
-    struct timeval now;\
-    gettimeofday(&now, NULL)
-#define GET_TIME_PAST(begin, end) ((end.tv_sec - begin.tv_sec) * 1000 + (end.tv_usec - begin.tv_usec) / 1000)
+
+static const uint64_t NSEC_PER_SEC = 1000000000ULL;
+static const uint64_t NSEC_PER_USEC = 1000ULL;
 
 extern test_runner_t _test_runner_;
 
+bool UT_FLAG(benchmark);
 bool UT_FLAG(break_on_failure);
 char UT_FLAG(case_filter)[MAX_STR_LEN];
 char UT_FLAG(suite_filter)[MAX_STR_LEN];
 bool UT_FLAG(help);
+bool UT_FLAG(history);
+char UT_FLAG(history_path)[MAX_STR_LEN];
+int  UT_FLAG(jobs) = 1;
 bool UT_FLAG(keep_going);
 bool UT_FLAG(list);
+list_format_t UT_FLAG(list_format);
+case_order_t UT_FLAG(order);
 int  UT_FLAG(repeat) = 1;
+int  UT_FLAG(retry_failed);
+int  UT_FLAG(shard_count) = 1;
+int  UT_FLAG(shard_index);
+bool UT_FLAG(shard_split_suites);
+char UT_FLAG(shard_weights)[MAX_STR_LEN];
 bool UT_FLAG(shuffle);
+int  UT_FLAG(slowest);
+int  UT_FLAG(threads) = 1;
+int  UT_FLAG(time_budget);
 bool UT_FLAG(version);
 bool UT_FLAG(xml);
 
+typedef enum long_option_t
+{
+    SHARD_INDEX_OPTION = 256,
+    SHARD_COUNT_OPTION,
+    SHARD_WEIGHTS_OPTION,
+    SHARD_SPLIT_SUITES_OPTION,
+    HISTORY_OPTION,
+    ORDER_OPTION,
+    SLOWEST_OPTION,
+    BENCHMARK_OPTION,
+    BENCHMARK_TIME_OPTION,
+    BENCHMARK_BASELINE_OPTION,
+    BENCHMARK_SAVE_OPTION,
+    BENCHMARK_THRESHOLD_OPTION,
+    PERF_COUNTERS_OPTION,
+    REPORTER_OPTION,
+    PROGRESS_OPTION,
+    FILTER_FILE_OPTION,
+    LIST_FORMAT_OPTION,
+    REPEAT_STATS_OPTION,
+    RETRY_FAILED_OPTION,
+    QUARANTINE_OPTION,
+    COVERAGE_MAP_OPTION,
+    CHANGED_FILES_OPTION,
+    TIMEOUT_OPTION,
+    TIME_BUDGET_OPTION,
+    CATCH_CRASHES_OPTION
+}long_option_t;
+
+static const char* const CASE_ORDER_NAME_LIST[] =
+{
+    "declared",
+    "longest",
+    "failed",
+    "value"
+};
+static const char* const LIST_FORMAT_NAME_LIST[] =
+{
+    "text",
+    "json"
+};
+static const char* DEFAULT_PERF_COUNTERS = "cycles,instructions,cache-misses,branch-misses";
+
+static const int CASE_ORDER_COUNT = sizeof(CASE_ORDER_NAME_LIST) / sizeof(CASE_ORDER_NAME_LIST[0]);
+static const int LIST_FORMAT_COUNT = sizeof(LIST_FORMAT_NAME_LIST) / sizeof(LIST_FORMAT_NAME_LIST[0]);
+
 static bool _is_ut_init_called_;
 static bool _is_ut_init_successed_;
 
+uint64_t get_monotonic_time(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * NSEC_PER_SEC + (uint64_t)now.tv_nsec;
+}
+
+/* RUSAGE_THREAD, so that cases running on the pool threads only see their own CPU time. */
+void get_cpu_time(uint64_t *user_time, uint64_t *system_time)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) == -1)
+    {
+        *user_time = 0;
+        *system_time = 0;
+        return;
+    }
+
+    *user_time = (uint64_t)usage.ru_utime.tv_sec * NSEC_PER_SEC + (uint64_t)usage.ru_utime.tv_usec * NSEC_PER_USEC;
+    *system_time = (uint64_t)usage.ru_stime.tv_sec * NSEC_PER_SEC + (uint64_t)usage.ru_stime.tv_usec * NSEC_PER_USEC;
+}
+
 static bool get_env_bool(const char* key, bool *value)
 {
     *value = (getenv(key) != NULL);
@@ -67,51 +151,305 @@ static bool get_env_str(const char* key, char value[MAX_STR_LEN])
     return true;
 }
 
+static bool parse_jobs(const char* value, int *jobs)
+{
+    if (strcmp(value, "auto") == 0)
+    {
+        *jobs = get_auto_job_count();
+        return true;
+    }
+
+    char* endptr = NULL;
+    int job_count = strtol(value, &endptr, 10);
+    if (*value == '\0' || *endptr != '\0' || job_count < 1)
+        return false;
+
+    *jobs = job_count;
+    return true;
+}
+
+static bool get_env_jobs(const char* key, int *value)
+{
+    const char* value_str = getenv(key);
+    if (value_str == NULL)
+        return false;
+
+    if (!parse_jobs(value_str, value))
+    {
+        print_ut_flag_int_type_warning(key, value_str, *value);
+        return false;
+    }
+
+    return true;
+}
+
+static bool parse_order(const char* value, case_order_t *order)
+{
+    int i;
+    for (i = 0; i < CASE_ORDER_COUNT; i++)
+    {
+        if (strcmp(value, CASE_ORDER_NAME_LIST[i]) == 0)
+        {
+            *order = (case_order_t)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool get_env_order(const char* key, case_order_t *value)
+{
+    const char* value_str = getenv(key);
+    if (value_str == NULL)
+        return false;
+
+    if (!parse_order(value_str, value))
+    {
+        print_ut_flag_str_value_warning(key, value_str, CASE_ORDER_NAME_LIST[*value]);
+        return false;
+    }
+
+    return true;
+}
+
+static bool parse_list_format(const char* value, list_format_t *list_format)
+{
+    int i;
+    for (i = 0; i < LIST_FORMAT_COUNT; i++)
+    {
+        if (strcmp(value, LIST_FORMAT_NAME_LIST[i]) == 0)
+        {
+            *list_format = (list_format_t)i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool get_env_list_format(const char* key, list_format_t *value)
+{
+    const char* value_str = getenv(key);
+    if (value_str == NULL)
+        return false;
+
+    if (!parse_list_format(value_str, value))
+    {
+        print_ut_flag_str_value_warning(key, value_str, LIST_FORMAT_NAME_LIST[*value]);
+        return false;
+    }
+
+    return true;
+}
+
+static bool get_env_perf_counters(const char* key, int *value)
+{
+    const char* value_str = getenv(key);
+    if (value_str == NULL)
+        return false;
+
+    if (!parse_perf_counters(value_str, value))
+    {
+        print_ut_flag_str_value_warning(key, value_str, "none");
+        return false;
+    }
+
+    return true;
+}
+
+static bool get_env_reporter(const char* key, char* value)
+{
+    const char* value_str = getenv(key);
+    if (value_str == NULL)
+        return false;
+
+    if (!parse_reporters(value_str))
+    {
+        print_ut_flag_str_value_warning(key, value_str, "none");
+        return false;
+    }
+
+    snprintf(value, MAX_STR_LEN, "%s", value_str);
+    return true;
+}
+
 static void get_ut_flag_from_env_var(void)
 {
+    get_env_bool("UT_BENCHMARK", &UT_FLAG(benchmark));
+    get_env_int("UT_BENCHMARK_TIME", &UT_FLAG(benchmark_time));
+    get_env_str("UT_BENCHMARK_BASELINE", UT_FLAG(benchmark_baseline));
+    get_env_str("UT_BENCHMARK_SAVE", UT_FLAG(benchmark_save));
+    get_env_int("UT_BENCHMARK_THRESHOLD", &UT_FLAG(benchmark_threshold));
     get_env_bool("UT_BREAK_ON_FAILURE", &UT_FLAG(break_on_failure));
     get_env_str("UT_CASE_FILTER", UT_FLAG(case_filter));
+    get_env_str("UT_CHANGED_FILES", UT_FLAG(changed_files));
+    if (get_env_str("UT_COVERAGE_MAP", UT_FLAG(coverage_map_path)))
+        UT_FLAG(coverage_map) = true;
     get_env_str("UT_SUITE_FILTER", UT_FLAG(suite_filter));
+    get_env_str("UT_FILTER_FILE", UT_FLAG(filter_file));
+    get_env_str("UT_QUARANTINE", UT_FLAG(quarantine));
+    get_env_jobs("UT_JOBS", &UT_FLAG(jobs));
     get_env_bool("UT_KEEP_GOING", &UT_FLAG(keep_going));
     get_env_bool("UT_LIST", &UT_FLAG(list));
+    get_env_list_format("UT_LIST_FORMAT", &UT_FLAG(list_format));
     get_env_bool("UT_NO_COLOR", &UT_FLAG(no_color));
     get_env_bool("UT_NO_FILTERED_OUT_RESULT", &UT_FLAG(no_filtered_out_result));
     get_env_bool("UT_HIGHLIGHT", &UT_FLAG(highlight));
+    if (get_env_str("UT_HISTORY", UT_FLAG(history_path)))
+        UT_FLAG(history) = true;
+    get_env_order("UT_ORDER", &UT_FLAG(order));
+    get_env_perf_counters("UT_PERF_COUNTERS", &UT_FLAG(perf_counters));
+    get_env_bool("UT_PROGRESS", &UT_FLAG(progress));
+    get_env_bool("UT_QUIET", &UT_FLAG(quiet));
     get_env_int("UT_REPEAT", &UT_FLAG(repeat));
+    if (get_env_str("UT_REPEAT_STATS", UT_FLAG(repeat_stats_path)))
+        UT_FLAG(repeat_stats) = true;
+    get_env_reporter("UT_REPORTER", UT_FLAG(reporter));
+    get_env_int("UT_RETRY_FAILED", &UT_FLAG(retry_failed));
+    get_env_int("UT_SHARD_COUNT", &UT_FLAG(shard_count));
+    get_env_int("UT_SHARD_INDEX", &UT_FLAG(shard_index));
+    get_env_bool("UT_SHARD_SPLIT_SUITES", &UT_FLAG(shard_split_suites));
+    get_env_str("UT_SHARD_WEIGHTS", UT_FLAG(shard_weights));
     get_env_bool("UT_SHUFFLE", &UT_FLAG(shuffle));
+    get_env_int("UT_SLOWEST", &UT_FLAG(slowest));
+    get_env_jobs("UT_THREADS", &UT_FLAG(threads));
+    get_env_int("UT_TIMEOUT", &UT_FLAG(timeout));
+    get_env_int("UT_TIME_BUDGET", &UT_FLAG(time_budget));
+    get_env_bool("UT_CATCH_CRASHES", &UT_FLAG(catch_crashes));
 
     if (get_env_str("UT_XML_PATH", UT_FLAG(xml_path)))
         UT_FLAG(xml) = true;
 }
 
+static bool parse_int_option(const char* option, const char* value, int min, int max, int *flag)
+{
+    char* endptr = NULL;
+    long int_value = strtol(value, &endptr, 10);
+    if (*value == '\0' || *endptr != '\0')
+    {
+        print_ut_flag_int_type_error(option, value);
+        return false;
+    }
+
+    if (int_value < min || int_value > max)
+    {
+        print_ut_flag_int_value_error(option, (int)int_value, min, max);
+        return false;
+    }
+
+    *flag = (int)int_value;
+    return true;
+}
+
+static bool parse_jobs_option(const char* option, const char* value, int *flag)
+{
+    if (parse_jobs(value, flag))
+        return true;
+
+    print_ut_flag_int_type_error(option, value);
+    return false;
+}
+
+static bool check_shard_flag(void)
+{
+    if (UT_FLAG(shard_count) < 1)
+    {
+        print_ut_flag_int_value_error("--shard-count", UT_FLAG(shard_count), 1, INT_MAX);
+        print_help();
+        return false;
+    }
+
+    if (UT_FLAG(shard_index) >= UT_FLAG(shard_count))
+    {
+        print_ut_flag_int_value_error("--shard-index", UT_FLAG(shard_index), 0, UT_FLAG(shard_count) - 1);
+        print_help();
+        return false;
+    }
+
+    return true;
+}
+
+/* The repeats are reported once, by their statistics, so an asked for report file would never be written. */
+static bool check_repeat_stats_flag(void)
+{
+    if (!UT_FLAG(repeat_stats))
+        return true;
+
+    if (UT_FLAG(xml))
+    {
+        print_ut_flag_conflict_error("--repeat-stats", "--xml-path");
+        print_help();
+        return false;
+    }
+
+    if (strlen(UT_FLAG(reporter)) != 0)
+    {
+        print_ut_flag_conflict_error("--repeat-stats", "--reporter");
+        print_help();
+        return false;
+    }
+
+    return true;
+}
+
 static bool get_ut_flag_from_cmd_line(int argc, char* argv[])
 {
-    char* short_options = "bCf:F:Hklr:Rsx::hv";
+    char* short_options = "bCf:F:Hj:klqr:Rst:x::hv";
     struct option long_options[] =
     {
         {"break-on-failure",        no_argument,        0, 'b'},
         {"no-color",                no_argument,        0, 'C'},
         {"case-filter",             required_argument,  0, 'f'},
         {"suite-filter",            required_argument,  0, 'F'},
+        {"filter-file",             required_argument,  0, FILTER_FILE_OPTION},
         {"highlight",               no_argument,        0, 'H'},
+        {"jobs",                    required_argument,  0, 'j'},
         {"keep-going",              no_argument,        0, 'k'},
         {"list",                    no_argument,        0, 'l'},
+        {"list-format",             required_argument,  0, LIST_FORMAT_OPTION},
+        {"quiet",                   no_argument,        0, 'q'},
         {"repeat",                  required_argument,  0, 'r'},
+        {"repeat-stats",            optional_argument,  0, REPEAT_STATS_OPTION},
+        {"retry-failed",            required_argument,  0, RETRY_FAILED_OPTION},
+        {"quarantine",              required_argument,  0, QUARANTINE_OPTION},
+        {"coverage-map",            optional_argument,  0, COVERAGE_MAP_OPTION},
+        {"changed-files",           required_argument,  0, CHANGED_FILES_OPTION},
         {"no-filtered-out-result",  no_argument,        0, 'R'},
         {"shuffle",                 no_argument,        0, 's'},
+        {"threads",                 required_argument,  0, 't'},
+        {"timeout",                 required_argument,  0, TIMEOUT_OPTION},
+        {"time-budget",             required_argument,  0, TIME_BUDGET_OPTION},
+        {"catch-crashes",           no_argument,        0, CATCH_CRASHES_OPTION},
+        {"shard-index",             required_argument,  0, SHARD_INDEX_OPTION},
+        {"shard-count",             required_argument,  0, SHARD_COUNT_OPTION},
+        {"shard-weights",           required_argument,  0, SHARD_WEIGHTS_OPTION},
+        {"shard-split-suites",      no_argument,        0, SHARD_SPLIT_SUITES_OPTION},
+        {"history",                 optional_argument,  0, HISTORY_OPTION},
+        {"order",                   required_argument,  0, ORDER_OPTION},
+        {"slowest",                 required_argument,  0, SLOWEST_OPTION},
+        {"benchmark",               no_argument,        0, BENCHMARK_OPTION},
+        {"benchmark-time",          required_argument,  0, BENCHMARK_TIME_OPTION},
+        {"benchmark-baseline",      required_argument,  0, BENCHMARK_BASELINE_OPTION},
+        {"benchmark-save",          required_argument,  0, BENCHMARK_SAVE_OPTION},
+        {"benchmark-threshold",     required_argument,  0, BENCHMARK_THRESHOLD_OPTION},
+        {"perf-counters",           optional_argument,  0, PERF_COUNTERS_OPTION},
+        {"progress",                no_argument,        0, PROGRESS_OPTION},
+        {"reporter",                required_argument,  0, REPORTER_OPTION},
         {"xml-path",                optional_argument,  0, 'x'},
         {"help",                    no_argument,        0, 'h'},
         {"version",                 no_argument,        0, 'v'},
         {0, 0, 0, 0}
     };
-    int option_index = 0;
+    int option_index = -1;
     int option;
 
     while ((option = getopt_long(argc, argv, short_options, long_options, &option_index)) != -1)
     {
-        char* endptr = NULL;
-        int repeat;
-        const char* cur_option;
+        char short_option[] = {'-', (char)option, '\0'};
+        const char* cur_option = (option_index >= 0) ? long_options[option_index].name : short_option;
+        bool ret = true;
+        option_index = -1;
 
         switch (option)
         {
@@ -127,34 +465,50 @@ static bool get_ut_flag_from_cmd_line(int argc, char* argv[])
         case 'F':
             snprintf(UT_FLAG(suite_filter), sizeof(UT_FLAG(suite_filter)), "%s", optarg);
             break;
+        case FILTER_FILE_OPTION:
+            snprintf(UT_FLAG(filter_file), sizeof(UT_FLAG(filter_file)), "%s", optarg);
+            break;
         case 'H':
             UT_FLAG(highlight) = true;
             break;
+        case 'j':
+            ret = parse_jobs_option(cur_option, optarg, &UT_FLAG(jobs));
+            break;
         case 'k':
             UT_FLAG(keep_going) = true;
             break;
         case 'l':
             UT_FLAG(list) = true;
             break;
+        case LIST_FORMAT_OPTION:
+            ret = parse_list_format(optarg, &UT_FLAG(list_format));
+            if (!ret)
+                print_ut_flag_str_value_error(cur_option, optarg);
+            break;
+        case 'q':
+            UT_FLAG(quiet) = true;
+            break;
         case 'r':
-            repeat = strtol(optarg, &endptr, 10);
-            if (*endptr != '\0' || repeat < 0)
-            {
-                if (option_index != 0)
-                    cur_option = long_options[option_index].name;
-                else
-                    cur_option = "-r";
-
-                if (*endptr != '\0')
-                    print_ut_flag_int_type_error(cur_option, optarg);
-                else
-                    print_ut_flag_int_value_error(cur_option, repeat, 0, INT_MAX);
-
-                print_help();
-                return false;
-            }
-
-            UT_FLAG(repeat) = repeat;
+            ret = parse_int_option(cur_option, optarg, 0, INT_MAX, &UT_FLAG(repeat));
+            break;
+        case REPEAT_STATS_OPTION:
+            UT_FLAG(repeat_stats) = true;
+            if (optarg != NULL)
+                snprintf(UT_FLAG(repeat_stats_path), sizeof(UT_FLAG(repeat_stats_path)), "%s", optarg);
+            break;
+        case RETRY_FAILED_OPTION:
+            ret = parse_int_option(cur_option, optarg, 0, INT_MAX, &UT_FLAG(retry_failed));
+            break;
+        case QUARANTINE_OPTION:
+            snprintf(UT_FLAG(quarantine), sizeof(UT_FLAG(quarantine)), "%s", optarg);
+            break;
+        case COVERAGE_MAP_OPTION:
+            UT_FLAG(coverage_map) = true;
+            if (optarg != NULL)
+                snprintf(UT_FLAG(coverage_map_path), sizeof(UT_FLAG(coverage_map_path)), "%s", optarg);
+            break;
+        case CHANGED_FILES_OPTION:
+            snprintf(UT_FLAG(changed_files), sizeof(UT_FLAG(changed_files)), "%s", optarg);
             break;
         case 'R':
             UT_FLAG(no_filtered_out_result) = true;
@@ -162,6 +516,73 @@ static bool get_ut_flag_from_cmd_line(int argc, char* argv[])
         case 's':
             UT_FLAG(shuffle) = true;
             break;
+        case 't':
+            ret = parse_jobs_option(cur_option, optarg, &UT_FLAG(threads));
+            break;
+        case TIMEOUT_OPTION:
+            ret = parse_int_option(cur_option, optarg, 0, INT_MAX, &UT_FLAG(timeout));
+            break;
+        case TIME_BUDGET_OPTION:
+            ret = parse_int_option(cur_option, optarg, 0, INT_MAX, &UT_FLAG(time_budget));
+            break;
+        case CATCH_CRASHES_OPTION:
+            UT_FLAG(catch_crashes) = true;
+            break;
+        case SHARD_INDEX_OPTION:
+            ret = parse_int_option(cur_option, optarg, 0, INT_MAX, &UT_FLAG(shard_index));
+            break;
+        case SHARD_COUNT_OPTION:
+            ret = parse_int_option(cur_option, optarg, 1, INT_MAX, &UT_FLAG(shard_count));
+            break;
+        case SHARD_WEIGHTS_OPTION:
+            snprintf(UT_FLAG(shard_weights), sizeof(UT_FLAG(shard_weights)), "%s", optarg);
+            break;
+        case SHARD_SPLIT_SUITES_OPTION:
+            UT_FLAG(shard_split_suites) = true;
+            break;
+        case HISTORY_OPTION:
+            UT_FLAG(history) = true;
+            if (optarg != NULL)
+                snprintf(UT_FLAG(history_path), sizeof(UT_FLAG(history_path)), "%s", optarg);
+            break;
+        case ORDER_OPTION:
+            ret = parse_order(optarg, &UT_FLAG(order));
+            if (!ret)
+                print_ut_flag_str_value_error(cur_option, optarg);
+            break;
+        case SLOWEST_OPTION:
+            ret = parse_int_option(cur_option, optarg, 0, INT_MAX, &UT_FLAG(slowest));
+            break;
+        case BENCHMARK_OPTION:
+            UT_FLAG(benchmark) = true;
+            break;
+        case BENCHMARK_TIME_OPTION:
+            ret = parse_int_option(cur_option, optarg, 1, INT_MAX, &UT_FLAG(benchmark_time));
+            break;
+        case BENCHMARK_BASELINE_OPTION:
+            snprintf(UT_FLAG(benchmark_baseline), sizeof(UT_FLAG(benchmark_baseline)), "%s", optarg);
+            break;
+        case BENCHMARK_SAVE_OPTION:
+            snprintf(UT_FLAG(benchmark_save), sizeof(UT_FLAG(benchmark_save)), "%s", optarg);
+            break;
+        case BENCHMARK_THRESHOLD_OPTION:
+            ret = parse_int_option(cur_option, optarg, 0, INT_MAX, &UT_FLAG(benchmark_threshold));
+            break;
+        case PERF_COUNTERS_OPTION:
+            ret = parse_perf_counters((optarg != NULL) ? optarg : DEFAULT_PERF_COUNTERS, &UT_FLAG(perf_counters));
+            if (!ret)
+                print_ut_flag_str_value_error(cur_option, optarg);
+            break;
+        case PROGRESS_OPTION:
+            UT_FLAG(progress) = true;
+            break;
+        case REPORTER_OPTION:
+            ret = parse_reporters(optarg);
+            if (ret)
+                snprintf(UT_FLAG(reporter), sizeof(UT_FLAG(reporter)), "%s", optarg);
+            else
+                print_ut_flag_str_value_error(cur_option, optarg);
+            break;
         case 'x':
             UT_FLAG(xml) = true;
             if (optarg != NULL)
@@ -177,6 +598,12 @@ static bool get_ut_flag_from_cmd_line(int argc, char* argv[])
             print_help();
             return false;
         }
+
+        if (!ret)
+        {
+            print_help();
+            return false;
+        }
     }
 
     if (optind < argc)
@@ -185,7 +612,7 @@ static bool get_ut_flag_from_cmd_line(int argc, char* argv[])
         return false;
     }
 
-    return true;
+    return check_shard_flag() && check_repeat_stats_flag();
 }
 
 static bool init_ut_flag(int argc, char* argv[])
@@ -248,8 +675,25 @@ static bool alloc_runner_suite_list(test_runner_t *test_runner)
     return true;
 }
 
+/* An auto registered list is a linker section, already filled, so only its length is taken. */
+static bool is_auto_registered_suite(const test_suite_t *test_suite)
+{
+    return test_suite->get_case_func_list == NULL;
+}
+
+static bool is_auto_registered_runner(const test_runner_t *test_runner)
+{
+    return test_runner->get_suite_func_list == NULL;
+}
+
 static bool init_suite_case_list(test_suite_t *test_suite)
 {
+    if (is_auto_registered_suite(test_suite))
+    {
+        test_suite->case_count = test_suite->case_list_end - test_suite->case_list;
+        return true;
+    }
+
     if (!alloc_suite_case_list(test_suite))
         return false;
 
@@ -267,6 +711,15 @@ static bool init_suite_case_list(test_suite_t *test_suite)
 
 static bool init_runner_suite_list(test_runner_t *test_runner)
 {
+    if (is_auto_registered_runner(test_runner))
+    {
+        test_runner->suite_count = test_runner->suite_list_end - test_runner->suite_list;
+        int i;
+        for (i = 0; i < test_runner->suite_count; i++)
+            init_suite_case_list(test_runner->suite_list[i]);
+        return true;
+    }
+
     if (!alloc_runner_suite_list(test_runner))
         return false;
 
@@ -286,6 +739,46 @@ static bool init_runner_suite_list(test_runner_t *test_runner)
     return true;
 }
 
+/*
+ * --list reads the registered lists as they are, so listing allocates nothing. Only a shard needs them built,
+ * auto registered ones are always built as that costs nothing.
+ */
+static bool is_runner_list_built(const test_runner_t *test_runner)
+{
+    return is_auto_registered_runner(test_runner) || test_runner->suite_list != NULL;
+}
+
+const test_suite_t* get_listed_suite(const test_runner_t *test_runner, int suite_index)
+{
+    if (is_runner_list_built(test_runner))
+        return (suite_index < test_runner->suite_count) ? test_runner->suite_list[suite_index] : NULL;
+
+    get_suite_func_t get_suite_func = test_runner->get_suite_func_list[suite_index];
+    return (get_suite_func != TEST_NULL) ? (*get_suite_func)() : NULL;
+}
+
+const test_case_t* get_listed_case(const test_suite_t *test_suite, int case_index)
+{
+    if (is_auto_registered_suite(test_suite) || test_suite->case_list != NULL)
+        return (case_index < test_suite->case_count) ? test_suite->case_list[case_index] : NULL;
+
+    get_case_func_t get_case_func = test_suite->get_case_func_list[case_index];
+    return (get_case_func != TEST_NULL) ? (*get_case_func)() : NULL;
+}
+
+static bool init_listed_test_runner(test_runner_t *test_runner)
+{
+    if (UT_FLAG(shard_count) <= 1 && !is_auto_registered_runner(test_runner))
+        return true;
+
+    if (!init_runner_suite_list(test_runner))
+        return false;
+    if (UT_FLAG(shard_count) > 1 && !shard_test_runner(test_runner))
+        return false;
+
+    return true;
+}
+
 static void shuffle_list(void** list, int len)
 {
     srand(time(NULL));
@@ -309,15 +802,16 @@ static void shuffle(test_runner_t *test_runner)
         shuffle_list((void**)(test_runner->suite_list[i]->case_list), test_runner->suite_list[i]->case_count);
 }
 
-static bool alloc_runner_result_list(char (**list)[MAX_STR_LEN], int count)
+static bool alloc_runner_result_list(void** list, int count, size_t size)
 {
     if (*list != NULL)
         return true;
 
-    *list = (char (*)[MAX_STR_LEN])malloc(count * sizeof(char[MAX_STR_LEN]));
+    /* An empty runner still gets a list, malloc(0) may return NULL. */
+    *list = malloc((count > 0 ? count : 1) * size);
     if (*list == NULL)
     {
-        PRINT_INTERNAL_ERROR("malloc(%d): %m", count * sizeof(char[MAX_STR_LEN]));
+        PRINT_INTERNAL_ERROR("malloc(%d): %m", count * size);
         return false;
     }
 
@@ -329,13 +823,13 @@ static bool alloc_runner_result_suite_list(test_runner_t *test_runner)
     int suite_count = test_runner->suite_count;
     runner_result_t *result = test_runner->result;
 
-    if (!alloc_runner_result_list(&result->succ_suite_list, suite_count))
+    if (!alloc_runner_result_list((void**)&result->succ_suite_list, suite_count, sizeof(int)))
         return false;
-    if (!alloc_runner_result_list(&result->fail_suite_list, suite_count))
+    if (!alloc_runner_result_list((void**)&result->fail_suite_list, suite_count, sizeof(int)))
         return false;
-    if (!alloc_runner_result_list(&result->skip_suite_list, suite_count))
+    if (!alloc_runner_result_list((void**)&result->skip_suite_list, suite_count, sizeof(int)))
         return false;
-    if (!alloc_runner_result_list(&result->filtered_out_suite_list, suite_count))
+    if (!alloc_runner_result_list((void**)&result->filtered_out_suite_list, suite_count, sizeof(int)))
         return false;
 
     return true;
@@ -356,13 +850,17 @@ static bool alloc_runner_result_case_list(test_runner_t *test_runner)
     int case_count = get_total_case_count(test_runner);
     runner_result_t *result = test_runner->result;
 
-    if (!alloc_runner_result_list(&result->succ_case_list, case_count))
+    if (!alloc_runner_result_list((void**)&result->succ_case_list, case_count, sizeof(result_case_ref_t)))
         return false;
-    if (!alloc_runner_result_list(&result->fail_case_list, case_count))
+    if (!alloc_runner_result_list((void**)&result->fail_case_list, case_count, sizeof(result_case_ref_t)))
         return false;
-    if (!alloc_runner_result_list(&result->skip_case_list, case_count))
+    if (!alloc_runner_result_list((void**)&result->skip_case_list, case_count, sizeof(result_case_ref_t)))
         return false;
-    if (!alloc_runner_result_list(&result->filtered_out_case_list, case_count))
+    if (!alloc_runner_result_list((void**)&result->filtered_out_case_list, case_count, sizeof(result_case_ref_t)))
+        return false;
+    if (!alloc_runner_result_list((void**)&result->flaky_case_list, case_count, sizeof(result_case_ref_t)))
+        return false;
+    if (!alloc_runner_result_list((void**)&result->quarantined_case_list, case_count, sizeof(result_case_ref_t)))
         return false;
 
     return true;
@@ -370,19 +868,48 @@ static bool alloc_runner_result_case_list(test_runner_t *test_runner)
 
 static bool init_test_runner(const char* test_bin_path, test_runner_t *test_runner)
 {
+    test_runner->test_bin_name = basename((char*)test_bin_path);
+    if (UT_FLAG(list))
+        return init_listed_test_runner(test_runner);
+
     if (!init_runner_suite_list(test_runner))
         return false;
+    if (UT_FLAG(time_budget) > 0 && UT_FLAG(order) == DECLARED_ORDER)
+        UT_FLAG(order) = VALUE_ORDER;
+    if (UT_FLAG(order) != DECLARED_ORDER || UT_FLAG(slowest) > 0)
+        UT_FLAG(history) = true;
+    if (UT_FLAG(repeat_stats))
+        UT_FLAG(quiet) = true;
+    if (UT_FLAG(history) && !load_case_history(test_runner))
+        return false;
+    if (strlen(UT_FLAG(changed_files)) > 0)
+        UT_FLAG(coverage_map) = true;
+    if (UT_FLAG(coverage_map) && !init_coverage(test_runner))
+        return false;
+
+    if (strlen(UT_FLAG(benchmark_baseline)) > 0 || strlen(UT_FLAG(benchmark_save)) > 0)
+        UT_FLAG(benchmark) = true;
+    if (strlen(UT_FLAG(benchmark_baseline)) > 0 && !load_benchmark_baseline())
+        return false;
+
+    if (UT_FLAG(shard_count) > 1 && !shard_test_runner(test_runner))
+        return false;
 
     if (UT_FLAG(shuffle))
         shuffle(test_runner);
 
+    if (UT_FLAG(order) != DECLARED_ORDER && !order_test_runner(test_runner))
+        return false;
+
     if (!alloc_runner_result_suite_list(test_runner))
         return false;
 
     if (!alloc_runner_result_case_list(test_runner))
         return false;
 
-    test_runner->test_bin_name = basename((char*)test_bin_path);
+    if (UT_FLAG(repeat_stats) && !init_repeat_stats(test_runner))
+        return false;
+
     return true;
 }
 
@@ -415,36 +942,19 @@ static bool run_setup_teardown(test_type_t test_type, test_type_t setup_teardown
     if (setup_teardown_func == 0)
         return true;
 
-    switch (setup_teardown)
+    if (setup_teardown != SETUP && setup_teardown != TEARDOWN)
     {
-    case SETUP:
-        print_setup_begin(test_type);
-        break;
-    case TEARDOWN:
-        print_teardown_begin(test_type);
-        break;
-    default:
         PRINT_INTERNAL_ERROR("error test_type_t `%d'\n", setup_teardown);
         abort();
     }
 
-    GET_TIME_OF_DAY(begin);
+    report_setup_teardown_begin(test_type, setup_teardown);
+
+    uint64_t begin = get_monotonic_time();
     bool ret = (*setup_teardown_func)();
-    GET_TIME_OF_DAY(end);
-    int time = GET_TIME_PAST(begin, end);
-
-    switch (setup_teardown)
-    {
-    case SETUP:
-        print_setup_end(test_type, ret, time);
-        break;
-    case TEARDOWN:
-        print_teardown_end(test_type, ret, time);
-        break;
-    default:
-        PRINT_INTERNAL_ERROR("error test_type_t `%d'\n", setup_teardown);
-        abort();
-    }
+    uint64_t time = get_monotonic_time() - begin;
+
+    report_setup_teardown_end(test_type, setup_teardown, ret, time);
 
     return ret;
 }
@@ -459,72 +969,146 @@ static bool run_teardown(test_type_t test_type, setup_teardown_func_t teardown)
     return run_setup_teardown(test_type, TEARDOWN, teardown);
 }
 
-static bool match_filter(const char* name, const char* fileter)
+static void clear_case_result(case_result_t *result)
 {
-    switch (*fileter)
-    {
-    case '\0':
-        return *name == '\0';
-    case '?':
-        return *name != '\0' && match_filter(name + 1, fileter + 1);
-    case '*':
-        return (*name != '\0' && match_filter(name + 1, fileter)) || match_filter(name, fileter + 1);
-    default:
-        return *name == *fileter && match_filter(name + 1, fileter + 1);
-    }
+    memset(result, 0, sizeof(*result));
+}
+
+static bool is_case_selected(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    return !is_case_filtered_out(test_suite, test_case) && (test_case->benchmark != NULL) == UT_FLAG(benchmark);
 }
 
-static bool is_filtered_out(const char* name, test_type_t test_type)
+bool begin_test_case(const test_suite_t *test_suite, const test_case_t *test_case)
 {
-    const char* filter;
-    switch (test_type)
+    case_result_t *result = test_case->result;
+    clear_case_result(result);
+    result->accessed = true;
+    if (!is_case_selected(test_suite, test_case))
     {
-    case CASE:
-        filter = UT_FLAG(case_filter);
-        break;
-    case SUITE:
-        filter = UT_FLAG(suite_filter);
-        break;
-    default:
-        PRINT_INTERNAL_ERROR("error test_type_t `%d'\n", test_type);
-        abort();
+        result->is_filtered_out = true;
+        return false;
     }
 
-    if (*filter == '\0')
-        return false;
+    result->is_quarantined = is_case_quarantined(test_suite, test_case);
+    return true;
+}
 
-    if (match_filter(name, filter))
+/* A case --time-budget does not start is left unaccessed, so it is SKIPPED in the result. */
+bool skip_over_budget_case(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    if (UT_FLAG(time_budget) == 0 || !is_case_selected(test_suite, test_case)
+        || fits_time_budget(test_suite, test_case))
         return false;
 
+    clear_case_result(test_case->result);
     return true;
 }
 
-static void clear_case_result(case_result_t *result)
+void exec_test_case(const test_case_t *test_case)
 {
-    memset(result, 0, sizeof(*result));
+    case_result_t *result = test_case->result;
+
+    uint64_t user_begin;
+    uint64_t system_begin;
+    begin_perf_counters();
+    get_cpu_time(&user_begin, &system_begin);
+    uint64_t begin = get_monotonic_time();
+    begin_case_watchdog(test_case);
+    sigjmp_buf *crash_jmp_buf = arm_crash_recovery();
+    begin_alloc_count();
+    if (crash_jmp_buf == NULL || sigsetjmp(*crash_jmp_buf, 1) == 0)
+    {
+        if (test_case->benchmark != NULL)
+            run_benchmark_case(test_case);
+        else
+            test_case->test(result);
+    }
+    else
+    {
+        save_case_crash(test_case);
+    }
+    end_alloc_count(result);
+    disarm_crash_recovery();
+    end_case_watchdog();
+    result->time = get_monotonic_time() - begin;
+    get_cpu_time(&result->user_time, &result->system_time);
+    end_perf_counters(result);
+    result->user_time -= user_begin;
+    result->system_time -= system_begin;
+    result->passed = result->fail_assertion_count > 0 ? false : true;
+    result->assertion_count = result->succ_assertion_count + result->fail_assertion_count;
+}
+
+static bool run_retry_fixture(test_type_t setup_teardown, setup_teardown_func_t func, fixture_result_t *fixture)
+{
+    fixture->setup_teardown = setup_teardown;
+    fixture->passed = true;
+    fixture->time = 0;
+    if (func == 0)
+        return true;
+
+    uint64_t begin = get_monotonic_time();
+    fixture->passed = (*func)();
+    fixture->time = get_monotonic_time() - begin;
+    return fixture->passed;
 }
 
-static void run_test_case(const test_case_t *test_case)
+/*
+ * A failed case runs again right away, up to --retry-failed times, on a fresh fixture: its case teardown and setup
+ * run around every retry, unreported as the case is still open. A retry replaces the result of the failed run, so
+ * a case which passes on retry is FLAKY, one which never does keeps the failures of its last run.
+ * If the teardown or setup of a retry fails, it is returned in `fixture' to be reported after the case in place of
+ * the case teardown, which has run already, and the suite stops as on a failed case setup.
+ */
+bool retry_test_case(const test_suite_t *test_suite, const test_case_t *test_case, fixture_result_t *fixture)
 {
     case_result_t *result = test_case->result;
-    clear_case_result(result);
-    result->accessed = true;
-    if (is_filtered_out(test_case->name, CASE))
+    setup_teardown_func_t case_setup = *test_suite->case_setup;
+    setup_teardown_func_t case_teardown = *test_suite->case_teardown;
+    int retry_count = 0;
+    bool fixture_passed = true;
+    while (!result->passed && retry_count < UT_FLAG(retry_failed) && test_case->benchmark == NULL)
     {
-        result->is_filtered_out = true;
-        return;
+        if (!run_retry_fixture(TEARDOWN, case_teardown, fixture) || !run_retry_fixture(SETUP, case_setup, fixture))
+        {
+            fixture_passed = false;
+            break;
+        }
+
+        bool is_quarantined = result->is_quarantined;
+        clear_case_result(result);
+        result->accessed = true;
+        result->is_quarantined = is_quarantined;
+        exec_test_case(test_case);
+        retry_count++;
     }
 
-    print_case_begin(test_case);
+    result->retry_count = retry_count;
+    result->is_flaky = result->passed && retry_count > 0;
+    return fixture_passed;
+}
 
-    GET_TIME_OF_DAY(begin);
-    test_case->test(result);
-    GET_TIME_OF_DAY(end);
-    result->time = GET_TIME_PAST(begin, end);
-    result->passed = result->fail_assertion_count > 0 ? false : true;
-    result->assertion_count = result->succ_assertion_count + result->fail_assertion_count;
+/* False if a retry failed its fixture, which is reported here, and the case teardown must not run again. */
+static bool run_test_case(const test_suite_t *test_suite, const test_case_t *test_case)
+{
+    if (!begin_test_case(test_suite, test_case))
+        return true;
+
+    report_case_begin(test_suite, test_case);
+    exec_test_case(test_case);
+    fixture_result_t fixture;
+    bool fixture_passed = retry_test_case(test_suite, test_case, &fixture);
+    if (test_case->benchmark != NULL)
+        compare_benchmark_baseline(test_suite, test_case);
+    report_case_end(test_suite, test_case);
 
-    print_case_end(test_case);
+    if (!fixture_passed)
+    {
+        report_setup_teardown_begin(CASE, fixture.setup_teardown);
+        report_setup_teardown_end(CASE, fixture.setup_teardown, false, fixture.time);
+    }
+    return fixture_passed;
 }
 
 static void clear_suite_result(suite_result_t *result)
@@ -532,14 +1116,14 @@ static void clear_suite_result(suite_result_t *result)
     memset(result, 0, sizeof(*result));
 }
 
-static void calc_suite_case_result(suite_result_t *suite_result, const case_result_t *case_result)
+void calc_suite_case_result(suite_result_t *suite_result, const case_result_t *case_result)
 {
-    if (case_result->is_filtered_out)
+    if (!case_result->accessed || case_result->is_filtered_out)
         return;
 
     suite_result->case_count++;
 
-    if (!case_result->passed)
+    if (!case_result->passed && !case_result->is_quarantined)
         suite_result->passed = false;
 
     suite_result->assertion_count += case_result->assertion_count;
@@ -557,58 +1141,86 @@ static void filter_out_suite_case(const test_suite_t *test_suite)
     }
 }
 
+static bool run_suite_cases(const test_suite_t *test_suite)
+{
+    int i;
+    test_case_t** case_list = test_suite->case_list;
+    suite_result_t *result = test_suite->result;
+    for (i = 0; i < test_suite->case_count; i++)
+    {
+        if (skip_over_budget_case(test_suite, case_list[i]))
+            continue;
+
+        begin_case_coverage();
+        if (!run_setup(CASE, *test_suite->case_setup))
+            return false;
+
+        bool fixture_passed = run_test_case(test_suite, case_list[i]);
+        calc_suite_case_result(result, case_list[i]->result);
+        if (!fixture_passed)
+            return false;
+
+        if (!run_teardown(CASE, *test_suite->case_teardown))
+            return false;
+        end_case_coverage(test_suite, case_list[i]);
+    }
+
+    return true;
+}
+
 static bool run_test_suite(const test_suite_t *test_suite)
 {
     suite_result_t *result = test_suite->result;
     clear_suite_result(result);
     result->accessed = true;
 
-    if (is_filtered_out(test_suite->name, SUITE))
+    if (is_suite_filtered_out(test_suite))
     {
         filter_out_suite_case(test_suite);
         return true;
     }
 
     result->passed = true;
-    print_suite_begin(test_suite);
+    report_suite_begin(test_suite);
     if (!run_setup(SUITE, *test_suite->suite_setup))
         goto RUN_SUITE_FAILED;
 
-    int i;
-    test_case_t** case_list = test_suite->case_list;
-    for (i = 0; i < test_suite->case_count; i++)
-    {
-        if (!run_setup(CASE, *test_suite->case_setup))
-            goto RUN_SUITE_FAILED;
-
-        run_test_case(case_list[i]);
-        calc_suite_case_result(result, case_list[i]->result);
-
-        if (!run_teardown(CASE, *test_suite->case_teardown))
-            goto RUN_SUITE_FAILED;
-    }
+    /* Benchmarks are measured alone, a concurrent case would distort them, and gcov counters are per process. */
+    bool ret;
+    if (UT_FLAG(benchmark) || is_recording_coverage())
+        ret = run_suite_cases(test_suite);
+    else if (UT_FLAG(jobs) > 1 || *test_suite->isolated)
+        ret = run_suite_cases_in_workers(test_suite);
+    else if (UT_FLAG(threads) > 1 && *test_suite->thread_safe)
+        ret = run_suite_cases_in_threads(test_suite);
+    else
+        ret = run_suite_cases(test_suite);
+    if (!ret)
+        goto RUN_SUITE_FAILED;
 
     if (!run_teardown(SUITE, *test_suite->suite_teardown))
         goto RUN_SUITE_FAILED;
-    print_suite_end(test_suite);
+    report_suite_end(test_suite);
     return true;
 
 RUN_SUITE_FAILED:
     result->passed = false;
-    print_suite_end(test_suite);
+    report_suite_end(test_suite);
     return false;
 }
 
 static void clear_runner_result(runner_result_t *result)
 {
-    char (*succ_suite_list)[MAX_STR_LEN] = result->succ_suite_list;
-    char (*fail_suite_list)[MAX_STR_LEN] = result->fail_suite_list;
-    char (*skip_suite_list)[MAX_STR_LEN] = result->skip_suite_list;
-    char (*filtered_out_suite_list)[MAX_STR_LEN] = result->filtered_out_suite_list;
-    char (*succ_case_list)[MAX_STR_LEN] = result->succ_case_list;
-    char (*fail_case_list)[MAX_STR_LEN] = result->fail_case_list;
-    char (*skip_case_list)[MAX_STR_LEN] = result->skip_case_list;
-    char (*filtered_out_case_list)[MAX_STR_LEN] = result->filtered_out_case_list;
+    int *succ_suite_list = result->succ_suite_list;
+    int *fail_suite_list = result->fail_suite_list;
+    int *skip_suite_list = result->skip_suite_list;
+    int *filtered_out_suite_list = result->filtered_out_suite_list;
+    result_case_ref_t *succ_case_list = result->succ_case_list;
+    result_case_ref_t *fail_case_list = result->fail_case_list;
+    result_case_ref_t *skip_case_list = result->skip_case_list;
+    result_case_ref_t *filtered_out_case_list = result->filtered_out_case_list;
+    result_case_ref_t *flaky_case_list = result->flaky_case_list;
+    result_case_ref_t *quarantined_case_list = result->quarantined_case_list;
 
     memset(result, 0, sizeof(*result));
 
@@ -620,6 +1232,8 @@ static void clear_runner_result(runner_result_t *result)
     result->fail_case_list = fail_case_list;
     result->skip_case_list = skip_case_list;
     result->filtered_out_case_list = filtered_out_case_list;
+    result->flaky_case_list = flaky_case_list;
+    result->quarantined_case_list = quarantined_case_list;
 }
 
 static void calc_runner_suite_result(runner_result_t *runner_result, const suite_result_t *suite_result)
@@ -637,14 +1251,16 @@ static void calc_runner_suite_result(runner_result_t *runner_result, const suite
     runner_result->time += suite_result->time;
 }
 
-static bool run_test_runner(const test_runner_t *test_runner)
+static bool run_test_runner(const test_runner_t *test_runner, int repeat)
 {
     runner_result_t *result = test_runner->result;
     clear_runner_result(result);
+    reset_failure_arena(test_runner);
     result->accessed = true;
     result->passed = true;
+    begin_time_budget();
 
-    print_runner_begin(test_runner);
+    report_runner_begin(test_runner, repeat);
     if (!run_setup(RUNNER, *test_runner->setup))
         goto RUN_UT_FAILED;
 
@@ -660,11 +1276,11 @@ static bool run_test_runner(const test_runner_t *test_runner)
 
     if (!run_teardown(RUNNER, *test_runner->teardown))
         goto RUN_UT_FAILED;
-    print_runner_end(test_runner, *test_runner->teardown);
+    report_runner_end(test_runner);
     return true;
 
 RUN_UT_FAILED:
-    print_runner_end(test_runner, *test_runner->teardown);
+    report_runner_end(test_runner);
     return false;
 }
 
@@ -683,7 +1299,15 @@ static void reset_suite_result(suite_result_t *result)
     result->time = 0;
 }
 
-static void calc_runner_suite_case_final_result(runner_result_t *runner_result, const test_suite_t *test_suite)
+static void add_result_case_ref(result_case_ref_t *list, int *count, int suite_index, int case_index)
+{
+    list[*count].suite_index = suite_index;
+    list[*count].case_index = case_index;
+    (*count)++;
+}
+
+static void calc_runner_suite_case_final_result(runner_result_t *runner_result, const test_suite_t *test_suite,
+                                                int suite_index)
 {
     suite_result_t *suite_result = test_suite->result;
 
@@ -695,28 +1319,36 @@ static void calc_runner_suite_case_final_result(runner_result_t *runner_result,
         if (!case_result->accessed)
         {
             suite_result->skip_case_count++;
-            snprintf(runner_result->skip_case_list[runner_result->skip_case_count++], MAX_STR_LEN, "%s.%s",
-                    test_suite->name, case_list[i]->name);
+            add_result_case_ref(runner_result->skip_case_list, &runner_result->skip_case_count, suite_index, i);
             continue;
         }
         if (case_result->is_filtered_out)
         {
             suite_result->filtered_out_case_count++;
-            snprintf(runner_result->filtered_out_case_list[runner_result->filtered_out_case_count++],
-                    MAX_STR_LEN, "%s.%s", test_suite->name, case_list[i]->name);
+            add_result_case_ref(runner_result->filtered_out_case_list, &runner_result->filtered_out_case_count,
+                                suite_index, i);
             continue;
         }
-        if (case_result->passed)
+        if (case_result->passed && case_result->is_flaky)
+        {
+            suite_result->flaky_case_count++;
+            add_result_case_ref(runner_result->flaky_case_list, &runner_result->flaky_case_count, suite_index, i);
+        }
+        else if (case_result->passed)
         {
             suite_result->succ_case_count++;
-            snprintf(runner_result->succ_case_list[runner_result->succ_case_count++], MAX_STR_LEN, "%s.%s",
-                    test_suite->name, case_list[i]->name);
+            add_result_case_ref(runner_result->succ_case_list, &runner_result->succ_case_count, suite_index, i);
+        }
+        else if (case_result->is_quarantined)
+        {
+            suite_result->quarantined_case_count++;
+            add_result_case_ref(runner_result->quarantined_case_list, &runner_result->quarantined_case_count,
+                                suite_index, i);
         }
         else
         {
             suite_result->fail_case_count++;
-            snprintf(runner_result->fail_case_list[runner_result->fail_case_count++], MAX_STR_LEN, "%s.%s",
-                    test_suite->name, case_list[i]->name);
+            add_result_case_ref(runner_result->fail_case_list, &runner_result->fail_case_count, suite_index, i);
         }
 
         suite_result->succ_assertion_count += case_result->succ_assertion_count;
@@ -726,35 +1358,32 @@ static void calc_runner_suite_case_final_result(runner_result_t *runner_result,
     }
 }
 
-static void calc_runner_suite_final_result(runner_result_t *runner_result, const test_suite_t *test_suite)
+static void calc_runner_suite_final_result(runner_result_t *runner_result, const test_suite_t *test_suite,
+                                           int suite_index)
 {
     suite_result_t *suite_result = test_suite->result;
     reset_suite_result(suite_result);
     suite_result->case_count = test_suite->case_count;
     runner_result->case_count += suite_result->case_count;
 
-    calc_runner_suite_case_final_result(runner_result, test_suite);
+    calc_runner_suite_case_final_result(runner_result, test_suite, suite_index);
 
     if (!suite_result->accessed)
     {
-        snprintf(runner_result->skip_suite_list[runner_result->skip_suite_count++],
-                MAX_STR_LEN, "%s", test_suite->name);
+        runner_result->skip_suite_list[runner_result->skip_suite_count++] = suite_index;
         return;
     }
 
     if (suite_result->is_filtered_out)
     {
-        snprintf(runner_result->filtered_out_suite_list[runner_result->filtered_out_suite_count++],
-                MAX_STR_LEN, "%s", test_suite->name);
+        runner_result->filtered_out_suite_list[runner_result->filtered_out_suite_count++] = suite_index;
         return;
     }
 
     if (suite_result->passed)
-        snprintf(runner_result->succ_suite_list[runner_result->succ_suite_count++],
-                MAX_STR_LEN, "%s", test_suite->name);
+        runner_result->succ_suite_list[runner_result->succ_suite_count++] = suite_index;
     else
-        snprintf(runner_result->fail_suite_list[runner_result->fail_suite_count++],
-                MAX_STR_LEN, "%s", test_suite->name);
+        runner_result->fail_suite_list[runner_result->fail_suite_count++] = suite_index;
 
     runner_result->succ_assertion_count += suite_result->succ_assertion_count;
     runner_result->fail_assertion_count += suite_result->fail_assertion_count;
@@ -774,21 +1403,75 @@ static void calc_ut_result(const test_runner_t *test_runner)
     int i;
     test_suite_t** suite_list = test_runner->suite_list;
     for (i = 0; i < test_runner->suite_count; i++)
-        calc_runner_suite_final_result(result, suite_list[i]);
+        calc_runner_suite_final_result(result, suite_list[i], i);
+}
+
+static const test_suite_t* find_case_suite(const test_runner_t *test_runner, const test_case_t *test_case)
+{
+    int i;
+    for (i = 0; i < test_runner->suite_count; i++)
+    {
+        const test_suite_t *test_suite = test_runner->suite_list[i];
+        int j;
+        for (j = 0; j < test_suite->case_count; j++)
+        {
+            if (test_suite->case_list[j] == test_case)
+                return test_suite;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * A timed out case cannot be taken back from the thread stuck in it, so the run ends on the watchdog thread. The
+ * case, its suite and the runner are reported as they stand, later suites as skipped, and the process exits with
+ * neither teardowns nor atexit handlers, which could wait on the stuck thread. Only the console is flushed, the
+ * report files are closed with the runner result, and fflush(NULL) would wait on the stdout the stuck thread holds.
+ * The history of the repeats done before is saved. `replay' is for a pool case, which has not reported its begin.
+ */
+void abort_timed_out_run(const test_case_t *test_case, bool replay)
+{
+    const test_suite_t *test_suite = find_case_suite(&_test_runner_, test_case);
+    if (test_suite != NULL)
+    {
+        if (replay)
+            report_case_replay(test_suite, test_case);
+        else
+            report_case_timeout(test_suite, test_case);
+        calc_suite_case_result(test_suite->result, test_case->result);
+        report_suite_end(test_suite);
+        calc_runner_suite_result(_test_runner_.result, test_suite->result);
+    }
+
+    _test_runner_.result->passed = false;
+    report_runner_end(&_test_runner_);
+    calc_ut_result(&_test_runner_);
+    report_runner_result(&_test_runner_);
+    drain_report_queue();
+    save_case_history();
+    fflush(stdout);
+    fflush(stderr);
+    _exit(EXIT_FAILURE);
+}
+
+static void abort_timed_out_case(const test_case_t *test_case)
+{
+    abort_timed_out_run(test_case, false);
 }
 
 void save_assertion_info(case_result_t *result, const char* file, int line, const char* expected, const char* actual,
                          const char* msg, ...)
 {
-    result->file = file;
-    result->line = line;
-    snprintf(result->expected, sizeof(result->expected), "%s", expected);
-    snprintf(result->actual, sizeof(result->actual), "%s", actual);
-
+    char user_msg[MAX_STR_LEN];
     va_list args;
     va_start(args, msg);
-    vsnprintf(result->user_msg, sizeof(result->user_msg), msg, args);
+    vsnprintf(user_msg, sizeof(user_msg), msg, args);
     va_end(args);
+
+    add_assertion_failure(result, file, line, expected, actual, user_msg);
+
+    assertion_failure_t failure = {NULL, file, line, expected, actual, user_msg};
+    report_assertion_failure(&failure);
 }
 
 bool ut_init(int argc, char* argv[])
@@ -799,9 +1482,19 @@ bool ut_init(int argc, char* argv[])
     if (!init_ut_flag(argc, argv))
         return false;
 
+    if (!UT_FLAG(list) && !init_filters())
+        return false;
+
     if (!init_test_runner(argv[0], &_test_runner_))
         return false;
 
+    if (!UT_FLAG(list) && !init_reporters())
+        return false;
+
+    if (!UT_FLAG(list) && !init_crash_recovery())
+        return false;
+
+    set_case_timeout_handler(abort_timed_out_case);
     _is_ut_init_successed_ = true;
     return true;
 }
@@ -826,32 +1519,57 @@ bool ut_run(void)
     for (i = 0; i < UT_FLAG(repeat); i++)
     {
         bool ret = true;
-        if (!run_test_runner(&_test_runner_))
+        if (!run_test_runner(&_test_runner_, i))
             ret = false;
 
         calc_ut_result(&_test_runner_);
-        print_ut_result(&_test_runner_);
-        if (UT_FLAG(xml))
-        {
-            if (!print_ut_result_to_xml(&_test_runner_, i))
-                ret = false;
-        }
+        if (UT_FLAG(repeat_stats))
+            update_repeat_stats(&_test_runner_, ret && _test_runner_.result->passed);
+        else if (!report_runner_result(&_test_runner_))
+            ret = false;
+
+        update_case_history(&_test_runner_);
+        if (!ret && !UT_FLAG(keep_going) && !UT_FLAG(repeat_stats))
+            break;
+    }
+
+    /* The history of every repeat is kept in memory and written once, a write costs an fsync(). */
+    if (!save_case_history())
+        return false;
 
-        if (!ret && !UT_FLAG(keep_going))
+    if (UT_FLAG(repeat_stats))
+    {
+        print_repeat_stats(&_test_runner_);
+        if (!save_repeat_stats(&_test_runner_))
             return false;
     }
 
-    return _test_runner_.result->passed;
+    print_slowest_case_history(UT_FLAG(slowest));
+    if (!save_benchmark_baseline(&_test_runner_))
+        return false;
+    if (!save_coverage_map())
+        return false;
+    if (UT_FLAG(repeat_stats))
+        return is_repeat_stats_passed();
+    return (i == UT_FLAG(repeat)) ? _test_runner_.result->passed : false;
 }
 
 void ut_fini(void)
 {
+    fini_reporters();
+    fini_filters();
+    free_benchmark_result(&_test_runner_);
+
     test_suite_t** suite_list = _test_runner_.suite_list;
     int i;
     for (i = 0; i < _test_runner_.suite_count; i++)
-        free(suite_list[i]->case_list);
+    {
+        if (!is_auto_registered_suite(suite_list[i]))
+            free(suite_list[i]->case_list);
+    }
 
-    free(suite_list);
+    if (!is_auto_registered_runner(&_test_runner_))
+        free(suite_list);
 
     runner_result_t *runner_result = _test_runner_.result;
     free(runner_result->succ_suite_list);
@@ -862,4 +1580,13 @@ void ut_fini(void)
     free(runner_result->fail_case_list);
     free(runner_result->skip_case_list);
     free(runner_result->filtered_out_case_list);
+    free(runner_result->flaky_case_list);
+    free(runner_result->quarantined_case_list);
+
+    free_case_history();
+    free_repeat_stats();
+    free_coverage();
+    free_failure_arena();
+    free_benchmark_baseline();
+    close_perf_counters();
 }
@@ -2,7 +2,9 @@
 #define _ZCUT_H_
 
 #include <limits.h>
+#include <setjmp.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -32,28 +34,92 @@ typedef enum test_type_t
     TEARDOWN,
 }test_type_t;
 
+typedef enum perf_counter_t
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTER_COUNT
+}perf_counter_t;
+
+typedef struct assertion_failure_t
+{
+    struct assertion_failure_t  *next;
+    const char*                 file;
+    int                         line;
+    const char*                 expected;
+    const char*                 actual;
+    const char*                 user_msg;
+}assertion_failure_t;
+
 typedef struct case_result_t
 {
-    bool        accessed;
-    bool        is_filtered_out;
-    bool        passed;
-    int         assertion_count;
-    int         succ_assertion_count;
-    int         fail_assertion_count;
-    int         time;
-    const char* file;
-    int         line;
-    char        expected[MAX_STR_LEN];
-    char        actual[MAX_STR_LEN];
-    char        user_msg[MAX_STR_LEN];
+    bool                accessed;
+    bool                is_filtered_out;
+    bool                passed;
+    bool                is_flaky;
+    bool                is_quarantined;
+    bool                is_timed_out;
+    bool                is_crashed;
+    int                 retry_count;
+    int                 assertion_count;
+    int                 succ_assertion_count;
+    int                 fail_assertion_count;
+    uint64_t            time;
+    uint64_t            user_time;
+    uint64_t            system_time;
+    int                 perf_counter_mask;
+    uint64_t            perf_counter_list[PERF_COUNTER_COUNT];
+    uint64_t            alloc_count;
+    uint64_t            alloc_bytes;
+    uint64_t            peak_alloc_bytes;
+    uint64_t            unfreed_alloc_count;
+    uint64_t            unfreed_alloc_bytes;
+    int                 failure_count;
+    assertion_failure_t *failure_list;
+    assertion_failure_t *last_failure;
 }case_result_t;
 
+typedef struct benchmark_result_t
+{
+    uint64_t    iteration_count;
+    int         sample_count;
+    double      *sample_list;
+    double      median;
+    double      mean;
+    double      stddev;
+    double      min;
+    double      p99;
+    bool        compared;
+    double      baseline_median;
+    double      p_value;
+}benchmark_result_t;
+
+/* A named thing cases use, which at most `capacity' of them may hold at once; 0 makes it exclusive, like 1. */
+typedef struct resource_t
+{
+    const char* name;
+    int         capacity;
+}resource_t;
+
+typedef struct resource_list_t
+{
+    const resource_t    *list;
+    int                 count;
+}resource_list_t;
+
 typedef void (*test_body_t)(struct case_result_t *result);
 typedef struct test_case_t
 {
-    const char*     name;
-    test_body_t     test;
-    case_result_t   *result;
+    const char*         name;
+    const char*         file;
+    int                 line;
+    test_body_t         test;
+    case_result_t       *result;
+    benchmark_result_t  *benchmark;
+    int                 *timeout;
+    resource_list_t     *resources;
 }test_case_t;
 
 typedef struct suite_result_t
@@ -66,55 +132,123 @@ typedef struct suite_result_t
     int     fail_case_count;
     int     skip_case_count;
     int     filtered_out_case_count;
+    int     flaky_case_count;
+    int     quarantined_case_count;
     int     assertion_count;
     int     succ_assertion_count;
     int     fail_assertion_count;
-    int     time;
+    uint64_t time;
 }suite_result_t;
 
 typedef bool (*setup_teardown_func_t)(void);
+
+/* One run of a case setup or teardown, which a pool reports after the case. */
+typedef struct fixture_result_t
+{
+    test_type_t setup_teardown;
+    bool        passed;
+    uint64_t    time;
+}fixture_result_t;
+
 typedef test_case_t* (*get_case_func_t)(void);
 typedef struct test_suite_t
 {
     const char*             name;
+    const char*             file;
+    int                     line;
     setup_teardown_func_t   *case_setup;
     setup_teardown_func_t   *case_teardown;
     setup_teardown_func_t   *suite_setup;
     setup_teardown_func_t   *suite_teardown;
+    bool                    *thread_safe;
+    bool                    *isolated;
+    resource_list_t         *resources;
     get_case_func_t         *get_case_func_list;
     int                     case_count;
     test_case_t*            *case_list;
+    test_case_t*            *case_list_end;
     suite_result_t          *result;
 }test_suite_t;
 
+typedef struct result_case_ref_t
+{
+    int     suite_index;
+    int     case_index;
+}result_case_ref_t;
+
+/* Result lists index test_runner_t.suite_list and the case_list of its suites, whose names print them. */
 typedef struct runner_result_t
 {
-    bool    accessed;
-    bool    passed;
-    int     suite_count;
-    int     succ_suite_count;
-    char    (*succ_suite_list)[MAX_STR_LEN];
-    int     fail_suite_count;
-    char    (*fail_suite_list)[MAX_STR_LEN];
-    int     skip_suite_count;
-    char    (*skip_suite_list)[MAX_STR_LEN];
-    int     filtered_out_suite_count;
-    char    (*filtered_out_suite_list)[MAX_STR_LEN];
-    int     case_count;
-    int     succ_case_count;
-    char    (*succ_case_list)[MAX_STR_LEN];
-    int     fail_case_count;
-    char    (*fail_case_list)[MAX_STR_LEN];
-    int     skip_case_count;
-    char    (*skip_case_list)[MAX_STR_LEN];
-    int     filtered_out_case_count;
-    char    (*filtered_out_case_list)[MAX_STR_LEN];
-    int     assertion_count;
-    int     succ_assertion_count;
-    int     fail_assertion_count;
-    int     time;
+    bool                accessed;
+    bool                passed;
+    int                 suite_count;
+    int                 succ_suite_count;
+    int                 *succ_suite_list;
+    int                 fail_suite_count;
+    int                 *fail_suite_list;
+    int                 skip_suite_count;
+    int                 *skip_suite_list;
+    int                 filtered_out_suite_count;
+    int                 *filtered_out_suite_list;
+    int                 case_count;
+    int                 succ_case_count;
+    result_case_ref_t   *succ_case_list;
+    int                 fail_case_count;
+    result_case_ref_t   *fail_case_list;
+    int                 skip_case_count;
+    result_case_ref_t   *skip_case_list;
+    int                 filtered_out_case_count;
+    result_case_ref_t   *filtered_out_case_list;
+    int                 flaky_case_count;
+    result_case_ref_t   *flaky_case_list;
+    int                 quarantined_case_count;
+    result_case_ref_t   *quarantined_case_list;
+    int                 assertion_count;
+    int                 succ_assertion_count;
+    int                 fail_assertion_count;
+    uint64_t            time;
 }runner_result_t;
 
+typedef enum case_order_t
+{
+    DECLARED_ORDER,
+    LONGEST_FIRST_ORDER,
+    FAILED_FIRST_ORDER,
+    VALUE_ORDER
+}case_order_t;
+
+/* Statistics of a case over the repeats of --repeat-stats, times in milliseconds. */
+typedef struct case_stats_t
+{
+    int         run_count;
+    int         pass_count;
+    int         fail_count;
+    int         skip_count;
+    int         flip_count;
+    bool        last_passed;
+    double      min_time;
+    double      max_time;
+    double      mean_time;
+    double      time_m2;
+}case_stats_t;
+
+typedef enum list_format_t
+{
+    TEXT_LIST_FORMAT,
+    JSON_LIST_FORMAT
+}list_format_t;
+
+typedef struct case_history_t
+{
+    char*       name;
+    int         run_count;
+    int         fail_count;
+    int         last_fail_run;
+    unsigned    outcome_bits;
+    double      last_time;
+    double      mean_time;
+}case_history_t;
+
 typedef test_suite_t* (*get_suite_func_t)(void);
 typedef struct test_runner_t
 {
@@ -125,26 +259,88 @@ typedef struct test_runner_t
     get_suite_func_t        *get_suite_func_list;
     int                     suite_count;
     test_suite_t*           *suite_list;
+    test_suite_t*           *suite_list_end;
     runner_result_t         *result;
 }test_runner_t;
 
+/*
+ * Output back-end. Every hook may be NULL. Background reporters get their events from a queue on a thread of their
+ * own, with copied results, and their assertion failures right before the end of the case.
+ */
+typedef struct reporter_t
+{
+    const char* name;
+    bool        background;
+    bool        (*init)(const char* path);
+    void        (*fini)(void);
+    void        (*runner_begin)(const test_runner_t *test_runner, int repeat);
+    void        (*runner_end)(const test_runner_t *test_runner);
+    bool        (*runner_result)(const test_runner_t *test_runner);
+    void        (*suite_begin)(const test_suite_t *test_suite);
+    void        (*suite_end)(const test_suite_t *test_suite, const suite_result_t *result);
+    void        (*case_begin)(const test_suite_t *test_suite, const test_case_t *test_case);
+    void        (*assertion_failure)(const assertion_failure_t *failure);
+    void        (*case_end)(const test_suite_t *test_suite, const test_case_t *test_case, const case_result_t *result);
+    void        (*setup_begin)(test_type_t test_type);
+    void        (*setup_end)(test_type_t test_type, bool passed, uint64_t time);
+    void        (*teardown_begin)(test_type_t test_type);
+    void        (*teardown_end)(test_type_t test_type, bool passed, uint64_t time);
+}reporter_t;
+
 
 #define UT_FLAG(name) ut_flag_##name
+extern bool UT_FLAG(benchmark);
+extern char UT_FLAG(benchmark_baseline)[MAX_STR_LEN];
+extern char UT_FLAG(benchmark_save)[MAX_STR_LEN];
+extern int  UT_FLAG(benchmark_threshold);
+extern int  UT_FLAG(benchmark_time);
 extern bool UT_FLAG(break_on_failure);
+extern bool UT_FLAG(catch_crashes);
 extern char UT_FLAG(case_filter)[MAX_STR_LEN];
+extern char UT_FLAG(changed_files)[MAX_STR_LEN];
+extern bool UT_FLAG(coverage_map);
+extern char UT_FLAG(coverage_map_path)[MAX_STR_LEN];
 extern char UT_FLAG(suite_filter)[MAX_STR_LEN];
+extern char UT_FLAG(filter_file)[MAX_STR_LEN];
+extern char UT_FLAG(quarantine)[MAX_STR_LEN];
 extern bool UT_FLAG(help);
+extern bool UT_FLAG(history);
+extern char UT_FLAG(history_path)[MAX_STR_LEN];
+extern int  UT_FLAG(jobs);
+extern int  UT_FLAG(perf_counters);
 extern bool UT_FLAG(keep_going);
 extern bool UT_FLAG(list);
+extern list_format_t UT_FLAG(list_format);
 extern bool UT_FLAG(no_color);
 extern bool UT_FLAG(no_filtered_out_result);
 extern bool UT_FLAG(highlight);
+extern case_order_t UT_FLAG(order);
+extern bool UT_FLAG(progress);
+extern bool UT_FLAG(quiet);
 extern int  UT_FLAG(repeat);
+extern bool UT_FLAG(repeat_stats);
+extern char UT_FLAG(repeat_stats_path)[MAX_STR_LEN];
+extern char UT_FLAG(reporter)[MAX_STR_LEN];
+extern int  UT_FLAG(retry_failed);
+extern int  UT_FLAG(shard_count);
+extern int  UT_FLAG(shard_index);
+extern bool UT_FLAG(shard_split_suites);
+extern char UT_FLAG(shard_weights)[MAX_STR_LEN];
 extern bool UT_FLAG(shuffle);
+extern int  UT_FLAG(slowest);
+extern int  UT_FLAG(threads);
+extern int  UT_FLAG(time_budget);
+extern int  UT_FLAG(timeout);
 extern bool UT_FLAG(version);
 extern bool UT_FLAG(xml);
 extern char UT_FLAG(xml_path)[MAX_STR_LEN];
 
+extern const reporter_t CONSOLE_REPORTER;
+extern const reporter_t XML_REPORTER;
+extern const reporter_t JUNIT_REPORTER;
+extern const reporter_t JSON_REPORTER;
+extern const reporter_t TAP_REPORTER;
+
 
 #define TEST_NULL   NULL
 #define EMPTY_STR   ""
@@ -153,14 +349,111 @@ extern char UT_FLAG(xml_path)[MAX_STR_LEN];
 
 #define ATTRIBUTE_UNUSED __attribute__((unused))
 
+/*
+ * Defined in a test binary built with --coverage, ZCUT_COVERAGE links the gcov reset and dump functions which
+ * --coverage-map calls. Nothing else refers to them, so the linker would leave them out of libgcov.
+ */
+#ifdef ZCUT_COVERAGE
+void __gcov_reset(void);
+void __gcov_dump(void);
+static void (*const zcut_gcov_func_list[])(void) __attribute__((used)) = {__gcov_reset, __gcov_dump};
+#endif
+
+/*
+ * Auto registration, chosen by defining ZCUT_AUTO_REGISTER before including zcut.h. A case puts a pointer to itself
+ * into the section `zcut_case_<suite>', a suite into `zcut_suite', and the linker gathers them from every object
+ * between __start_<section> and __stop_<section>. The runner uses these sections as its suite and case lists.
+ */
+#define ATTRIBUTE_SECTION(section_name) __attribute__((used, no_reorder, section(#section_name)))
+
+#ifdef ZCUT_AUTO_REGISTER
+#define TEST_CASE(suite_name, case_name)\
+    static void suite_name##_##case_name##_test_body(case_result_t *CASE_RESULT_PARAMETER);\
+    static case_result_t suite_name##_##case_name##_case_result;\
+    static int suite_name##_##case_name##_timeout;\
+    static resource_list_t suite_name##_##case_name##_resources;\
+    static test_case_t suite_name##_##case_name##_test_case =\
+    {\
+        #case_name,\
+        __FILE__,\
+        __LINE__,\
+        suite_name##_##case_name##_test_body,\
+        &suite_name##_##case_name##_case_result,\
+        NULL,\
+        &suite_name##_##case_name##_timeout,\
+        &suite_name##_##case_name##_resources\
+    };\
+    static test_case_t* suite_name##_##case_name##_case_entry ATTRIBUTE_SECTION(zcut_case_##suite_name) =\
+        &suite_name##_##case_name##_test_case;\
+    static void suite_name##_##case_name##_test_body(case_result_t *CASE_RESULT_PARAMETER ATTRIBUTE_UNUSED)
+
+#define BENCHMARK_CASE(suite_name, case_name)\
+    static void suite_name##_##case_name##_test_body(case_result_t *CASE_RESULT_PARAMETER);\
+    static case_result_t suite_name##_##case_name##_case_result;\
+    static benchmark_result_t suite_name##_##case_name##_benchmark_result;\
+    static int suite_name##_##case_name##_timeout;\
+    static resource_list_t suite_name##_##case_name##_resources;\
+    static test_case_t suite_name##_##case_name##_test_case =\
+    {\
+        #case_name,\
+        __FILE__,\
+        __LINE__,\
+        suite_name##_##case_name##_test_body,\
+        &suite_name##_##case_name##_case_result,\
+        &suite_name##_##case_name##_benchmark_result,\
+        &suite_name##_##case_name##_timeout,\
+        &suite_name##_##case_name##_resources\
+    };\
+    static test_case_t* suite_name##_##case_name##_case_entry ATTRIBUTE_SECTION(zcut_case_##suite_name) =\
+        &suite_name##_##case_name##_test_case;\
+    static void suite_name##_##case_name##_test_body(case_result_t *CASE_RESULT_PARAMETER ATTRIBUTE_UNUSED)
+
+#define CASE_TIMEOUT(suite_name, case_name, ms)\
+    static int suite_name##_##case_name##_timeout = ms
+
+#define CASE_RESOURCES(suite_name, case_name, resources...)\
+    static const resource_t suite_name##_##case_name##_resource_list[] = {resources};\
+    static resource_list_t suite_name##_##case_name##_resources = {suite_name##_##case_name##_resource_list,\
+        sizeof(suite_name##_##case_name##_resource_list) / sizeof(resource_t)}
+#else
 #define TEST_CASE(case_name)\
     void case_name##_test_body(case_result_t *CASE_RESULT_PARAMETER);\
     case_result_t case_name##_case_result;\
+    int case_name##_timeout;\
+    resource_list_t case_name##_resources;\
+    test_case_t case_name##_test_case =\
+    {\
+        #case_name,\
+        __FILE__,\
+        __LINE__,\
+        case_name##_test_body,\
+        &case_name##_case_result,\
+        NULL,\
+        &case_name##_timeout,\
+        &case_name##_resources\
+    };\
+    test_case_t* case_name(void)\
+    {\
+        return &case_name##_test_case;\
+    }\
+    void case_name##_test_body(case_result_t *CASE_RESULT_PARAMETER ATTRIBUTE_UNUSED)
+
+#define BENCHMARK_CASE(case_name)\
+    void case_name##_test_body(case_result_t *CASE_RESULT_PARAMETER);\
+    case_result_t case_name##_case_result;\
+    benchmark_result_t case_name##_benchmark_result;\
+    int case_name##_timeout;\
+    resource_list_t case_name##_resources;\
     test_case_t case_name##_test_case =\
     {\
         #case_name,\
+        __FILE__,\
+        __LINE__,\
         case_name##_test_body,\
-        &case_name##_case_result\
+        &case_name##_case_result,\
+        &case_name##_benchmark_result,\
+        &case_name##_timeout,\
+        &case_name##_resources\
     };\
     test_case_t* case_name(void)\
     {\
@@ -168,6 +461,28 @@ extern char UT_FLAG(xml_path)[MAX_STR_LEN];
     }\
     void case_name##_test_body(case_result_t *CASE_RESULT_PARAMETER ATTRIBUTE_UNUSED)
 
+/* Fails the case when it runs longer than `ms' milliseconds, whatever --timeout is. Put before or after the case. */
+#define CASE_TIMEOUT(case_name, ms)\
+    int case_name##_timeout = ms
+
+/* Declares the resources the case uses, as RESOURCE(name) or RESOURCE(name, capacity). Put before or after the case. */
+#define CASE_RESOURCES(case_name, resources...)\
+    static const resource_t case_name##_resource_list[] = {resources};\
+    resource_list_t case_name##_resources =\
+        {case_name##_resource_list, sizeof(case_name##_resource_list) / sizeof(resource_t)}
+#endif
+
+#define RESOURCE(name, capacity...)     {name, capacity + 0}
+
+#define BENCHMARK_LOOP\
+    uint64_t _benchmark_iteration_ = get_benchmark_iteration_count();\
+    while (_benchmark_iteration_-- > 0)
+
+#define PAUSE_TIMING()              pause_benchmark_timing()
+#define RESUME_TIMING()             resume_benchmark_timing()
+#define DO_NOT_OPTIMIZE(value)      __asm__ __volatile__("" : : "g"(value) : "memory")
+#define CLOBBER_MEMORY()            __asm__ __volatile__("" : : : "memory")
+
 #define CASE_SETUP(suite_name)\
     bool suite_name##_case_setup(void);\
     setup_teardown_func_t suite_name##_case_setup_func = suite_name##_case_setup;\
@@ -188,23 +503,77 @@ extern char UT_FLAG(xml_path)[MAX_STR_LEN];
     setup_teardown_func_t suite_name##_suite_teardown_func = suite_name##_suite_teardown;\
     bool suite_name##_suite_teardown(void)
 
+#define THREAD_SAFE_SUITE(suite_name)\
+    bool suite_name##_thread_safe = true
+
+/* Every case of the suite runs in a process of its own, forked from the state SUITE_SETUP left. */
+#define ISOLATED_SUITE(suite_name)\
+    bool suite_name##_isolated = true
+
+/* Resources every case of the suite uses, on top of its own CASE_RESOURCES. */
+#define SUITE_RESOURCES(suite_name, resources...)\
+    static const resource_t suite_name##_resource_list[] = {resources};\
+    resource_list_t suite_name##_resources =\
+        {suite_name##_resource_list, sizeof(suite_name##_resource_list) / sizeof(resource_t)}
+
+#ifdef ZCUT_AUTO_REGISTER
+#define TEST_SUITE(suite_name)\
+    setup_teardown_func_t suite_name##_case_setup_func;\
+    setup_teardown_func_t suite_name##_case_teardown_func;\
+    setup_teardown_func_t suite_name##_suite_setup_func;\
+    setup_teardown_func_t suite_name##_suite_teardown_func;\
+    bool suite_name##_thread_safe;\
+    bool suite_name##_isolated;\
+    resource_list_t suite_name##_resources;\
+    extern test_case_t* __start_zcut_case_##suite_name[] __attribute__((weak));\
+    extern test_case_t* __stop_zcut_case_##suite_name[] __attribute__((weak));\
+    suite_result_t suite_name##_suite_result;\
+    test_suite_t suite_name##_test_suite =\
+    {\
+        #suite_name,\
+        __FILE__,\
+        __LINE__,\
+        &suite_name##_case_setup_func,\
+        &suite_name##_case_teardown_func,\
+        &suite_name##_suite_setup_func,\
+        &suite_name##_suite_teardown_func,\
+        &suite_name##_thread_safe,\
+        &suite_name##_isolated,\
+        &suite_name##_resources,\
+        NULL,\
+        0,\
+        __start_zcut_case_##suite_name,\
+        __stop_zcut_case_##suite_name,\
+        &suite_name##_suite_result\
+    };\
+    static test_suite_t* suite_name##_suite_entry ATTRIBUTE_SECTION(zcut_suite) = &suite_name##_test_suite
+#else
 #define TEST_SUITE(suite_name)\
     setup_teardown_func_t suite_name##_case_setup_func;\
     setup_teardown_func_t suite_name##_case_teardown_func;\
     setup_teardown_func_t suite_name##_suite_setup_func;\
     setup_teardown_func_t suite_name##_suite_teardown_func;\
+    bool suite_name##_thread_safe;\
+    bool suite_name##_isolated;\
+    resource_list_t suite_name##_resources;\
     get_case_func_t suite_name##_case_list[];\
     suite_result_t suite_name##_suite_result;\
     test_suite_t suite_name##_test_suite =\
     {\
         #suite_name,\
+        __FILE__,\
+        __LINE__,\
         &suite_name##_case_setup_func,\
         &suite_name##_case_teardown_func,\
         &suite_name##_suite_setup_func,\
         &suite_name##_suite_teardown_func,\
+        &suite_name##_thread_safe,\
+        &suite_name##_isolated,\
+        &suite_name##_resources,\
         suite_name##_case_list,\
         0,\
         NULL,\
+        NULL,\
         &suite_name##_suite_result\
     };\
     test_suite_t* suite_name(void)\
@@ -212,6 +581,7 @@ extern char UT_FLAG(xml_path)[MAX_STR_LEN];
         return &suite_name##_test_suite;\
     }\
     get_case_func_t suite_name##_case_list[]=
+#endif
 
 #define RUNNER_SETUP(void)\
     bool runner_setup(void);\
@@ -223,6 +593,26 @@ extern char UT_FLAG(xml_path)[MAX_STR_LEN];
     setup_teardown_func_t runner_teardown_func = runner_teardown;\
     bool runner_teardown(void)
 
+#ifdef ZCUT_AUTO_REGISTER
+#define TEST_RUNNER(runner_name)\
+    setup_teardown_func_t runner_setup_func;\
+    setup_teardown_func_t runner_teardown_func;\
+    extern test_suite_t* __start_zcut_suite[] __attribute__((weak));\
+    extern test_suite_t* __stop_zcut_suite[] __attribute__((weak));\
+    runner_result_t runner_name##_runner_result;\
+    test_runner_t _test_runner_ =\
+    {\
+        NULL,\
+        #runner_name,\
+        &runner_setup_func,\
+        &runner_teardown_func,\
+        NULL,\
+        0,\
+        __start_zcut_suite,\
+        __stop_zcut_suite,\
+        &runner_name##_runner_result\
+    }
+#else
 #define TEST_RUNNER(runner_name)\
     setup_teardown_func_t runner_setup_func;\
     setup_teardown_func_t runner_teardown_func;\
@@ -237,9 +627,11 @@ extern char UT_FLAG(xml_path)[MAX_STR_LEN];
         runner_suite_list,\
         0,\
         NULL,\
+        NULL,\
         &runner_name##_runner_result\
     };\
     get_suite_func_t runner_suite_list[]=
+#endif
 
 
 #define FORMAT_BOOL(actual, compare, expected)\
@@ -282,8 +674,9 @@ extern char UT_FLAG(xml_path)[MAX_STR_LEN];
         }\
     }
 
+/* With --catch-crashes every assertion is traced first, so that a crash report shows the last ones reached. */
 #define ASSERTION(is_return, condition, actual, compare, expected, format, msg...)\
-    if ((condition))\
+    if ((!UT_FLAG(catch_crashes) || trace_assertion(__FILE__, __LINE__, #condition)) && (condition))\
     {\
         CASE_RESULT_PARAMETER->succ_assertion_count++;\
     }\
@@ -293,10 +686,9 @@ extern char UT_FLAG(xml_path)[MAX_STR_LEN];
         char expected_str[MAX_STR_LEN];\
         char actual_str[MAX_STR_LEN];\
         format(actual, compare, expected);\
-        print_assertion_info(__FILE__, __LINE__, expected_str, actual_str, EMPTY_STR msg);\
+        save_assertion_info(CASE_RESULT_PARAMETER, __FILE__, __LINE__, expected_str, actual_str, EMPTY_STR msg);\
         if (UT_FLAG(break_on_failure))\
             abort();\
-        save_assertion_info(CASE_RESULT_PARAMETER, __FILE__, __LINE__, expected_str, actual_str, EMPTY_STR msg);\
         if (is_return)\
             return;\
     }
@@ -355,13 +747,161 @@ extern char UT_FLAG(xml_path)[MAX_STR_LEN];
 #define ASSERT_STR_IC_GT(actual, expected, msg...) TEST_STR_IC(RETURN, actual, >, expected, msg)
 #define ASSERT_STR_IC_GE(actual, expected, msg...) TEST_STR_IC(RETURN, actual, >=, expected, msg)
 
+#define TEST_PERF(is_return, counter, compare, expected, block...)\
+    {\
+        int64_t counter = (int64_t)read_perf_counter(PERF_##counter);\
+        block;\
+        counter = (int64_t)read_perf_counter(PERF_##counter) - counter;\
+        if (is_perf_counter_open(PERF_##counter))\
+        {\
+            ASSERTION(is_return, counter compare expected, counter, compare, expected, FORMAT_INT)\
+        }\
+    }
+#define EXPECT_PERF_LE(counter, expected, block...) TEST_PERF(NO_RETURN, counter, <=, expected, block)
+#define ASSERT_PERF_LE(counter, expected, block...) TEST_PERF(RETURN, counter, <=, expected, block)
+
+/* The failure names the checked code, `zcut_alloc_block_' of TEST_ALLOC_COUNT, rather than the counter. */
+#define FORMAT_ALLOC_COUNT(actual, compare, expected)\
+    snprintf(expected_str, MAX_STR_LEN, "allocations of `%s' %s %lld", zcut_alloc_block_, #compare,\
+             (long long)(expected));\
+    snprintf(actual_str, MAX_STR_LEN, "allocations of `%s' == %lld", zcut_alloc_block_, (long long)actual)
 
+#define TEST_ALLOC_COUNT(is_return, compare, expected, block...)\
+    {\
+        const char* zcut_alloc_block_ = #block;\
+        int64_t zcut_alloc_count_ = (int64_t)get_alloc_count();\
+        block;\
+        zcut_alloc_count_ = (int64_t)get_alloc_count() - zcut_alloc_count_;\
+        ASSERTION(is_return, zcut_alloc_count_ compare expected, zcut_alloc_count_, compare, expected,\
+                  FORMAT_ALLOC_COUNT)\
+    }
+#define EXPECT_NO_ALLOC(block...)                   TEST_ALLOC_COUNT(NO_RETURN, ==, 0, block)
+#define ASSERT_NO_ALLOC(block...)                   TEST_ALLOC_COUNT(RETURN, ==, 0, block)
+#define EXPECT_ALLOC_COUNT_LE(expected, block...)   TEST_ALLOC_COUNT(NO_RETURN, <=, expected, block)
+#define ASSERT_ALLOC_COUNT_LE(expected, block...)   TEST_ALLOC_COUNT(RETURN, <=, expected, block)
+
+
+bool trace_assertion(const char* file, int line, const char* condition);
 void save_assertion_info(case_result_t *result, const char* file, int line, const char* expected, const char* actual,
                          const char* msg, ...);
 bool ut_init(int argc, char* argv[]);
 bool ut_run(void);
 void ut_fini(void);
 
+uint64_t get_monotonic_time(void);
+void get_cpu_time(uint64_t *user_time, uint64_t *system_time);
+bool begin_test_case(const test_suite_t *test_suite, const test_case_t *test_case);
+bool skip_over_budget_case(const test_suite_t *test_suite, const test_case_t *test_case);
+void exec_test_case(const test_case_t *test_case);
+bool retry_test_case(const test_suite_t *test_suite, const test_case_t *test_case, fixture_result_t *fixture);
+void calc_suite_case_result(suite_result_t *suite_result, const case_result_t *case_result);
+const test_suite_t* get_listed_suite(const test_runner_t *test_runner, int suite_index);
+const test_case_t* get_listed_case(const test_suite_t *test_suite, int case_index);
+
+int  get_auto_job_count(void);
+bool run_suite_cases_in_workers(const test_suite_t *test_suite);
+bool run_suite_cases_in_threads(const test_suite_t *test_suite);
+
+uint64_t get_benchmark_iteration_count(void);
+void pause_benchmark_timing(void);
+void resume_benchmark_timing(void);
+void run_benchmark_case(const test_case_t *test_case);
+void free_benchmark_result(const test_runner_t *test_runner);
+bool load_benchmark_baseline(void);
+void compare_benchmark_baseline(const test_suite_t *test_suite, const test_case_t *test_case);
+bool save_benchmark_baseline(const test_runner_t *test_runner);
+void free_benchmark_baseline(void);
+
+bool parse_perf_counters(const char* value, int *mask);
+const char* get_perf_counter_name(perf_counter_t counter);
+void begin_perf_counters(void);
+void end_perf_counters(case_result_t *result);
+bool is_perf_counter_open(perf_counter_t counter);
+uint64_t read_perf_counter(perf_counter_t counter);
+void close_perf_counters(void);
+
+void begin_alloc_count(void);
+void end_alloc_count(case_result_t *result);
+uint64_t get_alloc_count(void);
+
+void add_assertion_failure(case_result_t *result, const char* file, int line, const char* expected,
+                           const char* actual, const char* user_msg);
+void reset_failure_arena(const test_runner_t *test_runner);
+void free_failure_arena(void);
+
+bool init_repeat_stats(const test_runner_t *test_runner);
+void free_repeat_stats(void);
+void update_repeat_stats(const test_runner_t *test_runner, bool passed);
+const case_stats_t* get_case_stats(int suite_index, int case_index);
+int  get_repeat_stats_count(void);
+bool is_repeat_stats_passed(void);
+double get_case_stats_stddev(const case_stats_t *stats);
+double get_case_stats_flaky_rate(const case_stats_t *stats);
+bool save_repeat_stats(const test_runner_t *test_runner);
+
+bool init_filters(void);
+void fini_filters(void);
+bool is_suite_filtered_out(const test_suite_t *test_suite);
+bool is_case_filtered_out(const test_suite_t *test_suite, const test_case_t *test_case);
+bool is_case_quarantined(const test_suite_t *test_suite, const test_case_t *test_case);
+
+bool init_coverage(const test_runner_t *test_runner);
+bool is_recording_coverage(void);
+bool is_case_impacted(const test_suite_t *test_suite, const test_case_t *test_case);
+void begin_case_coverage(void);
+void end_case_coverage(const test_suite_t *test_suite, const test_case_t *test_case);
+bool save_coverage_map(void);
+void free_coverage(void);
+
+typedef void (*timeout_handler_t)(const test_case_t *test_case);
+timeout_handler_t set_case_timeout_handler(timeout_handler_t handler);
+void begin_case_watchdog(const test_case_t *test_case);
+void end_case_watchdog(void);
+void abort_timed_out_run(const test_case_t *test_case, bool replay);
+
+bool init_crash_recovery(void);
+sigjmp_buf* arm_crash_recovery(void);
+void disarm_crash_recovery(void);
+void save_case_crash(const test_case_t *test_case);
+
+bool has_suite_resources(const test_suite_t *test_suite);
+bool acquire_case_resources(const test_suite_t *test_suite, const test_case_t *test_case);
+void release_case_resources(const test_suite_t *test_suite, const test_case_t *test_case);
+void free_case_resources(void);
+
+bool shard_test_runner(test_runner_t *test_runner);
+
+bool load_case_history(const test_runner_t *test_runner);
+const case_history_t* find_case_history(const test_suite_t *test_suite, const test_case_t *test_case);
+void update_case_history(const test_runner_t *test_runner);
+bool save_case_history(void);
+void free_case_history(void);
+void print_slowest_case_history(int count);
+bool order_test_runner(test_runner_t *test_runner);
+uint64_t get_case_expected_time(const test_suite_t *test_suite, const test_case_t *test_case);
+void begin_time_budget(void);
+bool fits_time_budget(const test_suite_t *test_suite, const test_case_t *test_case);
+
+bool parse_reporters(const char* value);
+bool init_reporters(void);
+void fini_reporters(void);
+void drain_report_queue(void);
+void report_runner_begin(const test_runner_t *test_runner, int repeat);
+void report_runner_end(const test_runner_t *test_runner);
+bool report_runner_result(const test_runner_t *test_runner);
+void report_suite_begin(const test_suite_t *test_suite);
+void report_suite_end(const test_suite_t *test_suite);
+void report_case_begin(const test_suite_t *test_suite, const test_case_t *test_case);
+void report_case_end(const test_suite_t *test_suite, const test_case_t *test_case);
+void report_case_replay(const test_suite_t *test_suite, const test_case_t *test_case);
+void report_case_timeout(const test_suite_t *test_suite, const test_case_t *test_case);
+void report_assertion_failure(const assertion_failure_t *failure);
+void report_setup_teardown_begin(test_type_t test_type, test_type_t setup_teardown);
+void report_setup_teardown_end(test_type_t test_type, test_type_t setup_teardown, bool passed, uint64_t time);
+FILE* open_report_file(const char* path, const char* suffix, const test_runner_t *test_runner, int repeat);
+bool close_report_file(FILE *file);
+void write_report_str(FILE *file, const char* string);
+
 void print_help(void);
 void print_version(void);
 void print_runner_begin(const test_runner_t *test_runner);
@@ -370,14 +910,16 @@ void print_suite_begin(const test_suite_t *test_suite);
 void print_suite_end(const test_suite_t *test_suite);
 void print_case_begin(const test_case_t *test_case);
 void print_case_end(const test_case_t *test_case);
+void print_benchmark_result(const test_case_t *test_case);
 void print_setup_begin(test_type_t test_type);
-void print_setup_end(test_type_t test_type, bool passed, int time);
+void print_setup_end(test_type_t test_type, bool passed, uint64_t time);
 void print_teardown_begin(test_type_t test_type);
-void print_teardown_end(test_type_t test_type, bool passed, int time);
+void print_teardown_end(test_type_t test_type, bool passed, uint64_t time);
 void print_assertion_info(const char* file, int line, const char* expected, const char* actual, const char* msg, ...);
 void print_ut_list(const test_runner_t *test_runner);
 void print_ut_result(const test_runner_t *test_runner);
-bool print_ut_result_to_xml(const test_runner_t *test_runner, int repeat);
+void print_slowest_case_list(const case_history_t* const *case_history_list, int count);
+void print_repeat_stats(const test_runner_t *test_runner);
 
 void print_ut_init_no_called_error(void);
 void print_ut_init_error(void);
@@ -385,6 +927,12 @@ void print_ut_flag_int_type_warning(const char* flag, const char* value, int def
 void print_ut_flag_int_value_warning(const char* flag, int value, int min, int max, int default_value);
 void print_ut_flag_int_type_error(const char* option, const char* value);
 void print_ut_flag_int_value_error(const char* option, int value, int min, int max);
+void print_ut_flag_str_value_warning(const char* flag, const char* value, const char* default_value);
+void print_ut_flag_str_value_error(const char* option, const char* value);
+void print_ut_flag_conflict_error(const char* option, const char* other_option);
+void set_print_muted(bool muted);
+void open_spare_console(void);
+void take_stuck_console(void);
 void print_non_option_error(int optind, int argc, char* argv[]);
 void print_error(const char* file, const char* function, int line, const char* msg, ...);
 
@@ -0,0 +1,58 @@
+#include <zcut.h>
+
+/**
+ * test_alloc_suite
+ */
+static int sum(const int *list, int count)
+{
+    int total = 0;
+    int i;
+    for (i = 0; i < count; i++)
+        total += list[i];
+    return total;
+}
+
+TEST_CASE(test_no_alloc)
+{
+    int list[] = {1, 2, 3};
+    int total = 0;
+    EXPECT_NO_ALLOC(total = sum(list, 3));
+    EXPECT_EQ(total, 6);
+}
+
+TEST_CASE(test_alloc_count)
+{
+    char* str = NULL;
+    EXPECT_ALLOC_COUNT_LE(1, str = strdup("zcut"));
+    EXPECT_NO_ALLOC(str[0] = 'Z');
+    free(str);
+}
+
+TEST_CASE(test_unexpected_alloc)
+{
+    void* buf = NULL;
+    EXPECT_NO_ALLOC(buf = malloc(64));
+    free(buf);
+}
+
+TEST_CASE(test_leak)
+{
+    void* leaked = malloc(100);
+    EXPECT_TRUE(leaked != NULL, "the unfreed block shows up in the ALLOC line and the XML report");
+}
+
+TEST_SUITE(test_alloc_suite)
+{
+    test_no_alloc,
+    test_alloc_count,
+    test_unexpected_alloc,
+    test_leak,
+    TEST_NULL
+};
+
+
+TEST_RUNNER(test_alloc)
+{
+    test_alloc_suite,
+    TEST_NULL
+};
@@ -0,0 +1,34 @@
+#define ZCUT_AUTO_REGISTER
+#include <zcut.h>
+
+/**
+ * test_auto_suite, its cases are also in test_auto_register_suite.c
+ */
+SUITE_SETUP(test_auto_suite)
+{
+    return true;
+}
+
+TEST_CASE(test_auto_suite, test_passed)
+{
+    EXPECT_TRUE(true);
+}
+
+TEST_CASE(test_auto_suite, test_failed)
+{
+    EXPECT_EQ(0, 1);
+}
+
+TEST_SUITE(test_auto_suite);
+
+
+/**
+ * test_empty_auto_suite
+ */
+TEST_SUITE(test_empty_auto_suite);
+
+
+/**
+ * runner, the suites of every linked object are found without a list.
+ */
+TEST_RUNNER(test_auto_register);
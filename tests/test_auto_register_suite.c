@@ -0,0 +1,31 @@
+#define ZCUT_AUTO_REGISTER
+#include <zcut.h>
+
+/**
+ * test_auto_suite, cases added from another file.
+ */
+TEST_CASE(test_auto_suite, test_from_other_file)
+{
+    EXPECT_STR_EQ("a", "a");
+}
+
+
+/**
+ * test_other_file_suite
+ */
+TEST_CASE(test_other_file_suite, test_passed)
+{
+    EXPECT_TRUE(true);
+}
+
+BENCHMARK_CASE(test_other_file_suite, test_benchmark)
+{
+    int sum = 0;
+    BENCHMARK_LOOP
+    {
+        sum++;
+        DO_NOT_OPTIMIZE(sum);
+    }
+}
+
+TEST_SUITE(test_other_file_suite);
@@ -0,0 +1,82 @@
+#include <zcut.h>
+
+/**
+ * test_benchmark_suite
+ */
+static char _buf_[4096];
+
+TEST_CASE(test_buf_size)
+{
+    EXPECT_EQ(sizeof(_buf_), 4096, "benchmarks are skipped, run with `--benchmark' to measure them");
+}
+
+TEST_CASE(test_strlen_instructions)
+{
+    int len = 0;
+    EXPECT_PERF_LE(INSTRUCTIONS, 20000, len = (int)strlen(_buf_); DO_NOT_OPTIMIZE(len));
+    EXPECT_EQ(len, 0, "run with `--perf-counters' to count the instructions");
+}
+
+BENCHMARK_CASE(benchmark_strlen)
+{
+    BENCHMARK_LOOP
+    {
+        DO_NOT_OPTIMIZE(strlen(_buf_));
+    }
+}
+
+BENCHMARK_CASE(benchmark_memset)
+{
+    BENCHMARK_LOOP
+    {
+        memset(_buf_, 'a', sizeof(_buf_) - 1);
+        CLOBBER_MEMORY();
+    }
+}
+
+BENCHMARK_CASE(benchmark_sort_pause_timing)
+{
+    int list[64];
+    BENCHMARK_LOOP
+    {
+        PAUSE_TIMING();
+        int i;
+        for (i = 0; i < 64; i++)
+            list[i] = 64 - i;
+        RESUME_TIMING();
+
+        int j;
+        for (i = 1; i < 64; i++)
+        {
+            int value = list[i];
+            for (j = i; j > 0 && list[j - 1] > value; j--)
+                list[j] = list[j - 1];
+            list[j] = value;
+        }
+        DO_NOT_OPTIMIZE(list[0]);
+    }
+    EXPECT_EQ(list[0], 1);
+}
+
+BENCHMARK_CASE(benchmark_one_operation_body)
+{
+    DO_NOT_OPTIMIZE(_buf_[0]);
+}
+
+TEST_SUITE(test_benchmark_suite)
+{
+    test_buf_size,
+    test_strlen_instructions,
+    benchmark_strlen,
+    benchmark_memset,
+    benchmark_sort_pause_timing,
+    benchmark_one_operation_body,
+    TEST_NULL
+};
+
+
+TEST_RUNNER(test_benchmark)
+{
+    test_benchmark_suite,
+    TEST_NULL
+};
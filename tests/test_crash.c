@@ -0,0 +1,43 @@
+#include <zcut.h>
+
+/**
+ * test_crash_suite
+ */
+TEST_CASE(test_segv)
+{
+    int* volatile ptr = NULL;
+    EXPECT_TRUE(true, "run with `--catch-crashes' to recover from the crash below");
+    EXPECT_EQ(*ptr, 0);
+}
+
+TEST_CASE(test_passed_after_segv)
+{
+    EXPECT_TRUE(true);
+}
+
+TEST_CASE(test_abort)
+{
+    EXPECT_STR_EQ("zcut", "zcut");
+    abort();
+}
+
+TEST_CASE(test_passed_after_abort)
+{
+    EXPECT_TRUE(true);
+}
+
+TEST_SUITE(test_crash_suite)
+{
+    test_segv,
+    test_passed_after_segv,
+    test_abort,
+    test_passed_after_abort,
+    TEST_NULL
+};
+
+
+TEST_RUNNER(test_crash)
+{
+    test_crash_suite,
+    TEST_NULL
+};
@@ -0,0 +1,57 @@
+#include <zcut.h>
+
+/**
+ * test_isolated_suite
+ */
+static int _index_[4];
+static int _index_count_;
+
+SUITE_SETUP(test_isolated_suite)
+{
+    int i;
+    for (i = 0; i < 4; i++)
+        _index_[_index_count_++] = i * i;
+    return true;
+}
+
+TEST_CASE(test_change_index)
+{
+    _index_[0] = 100;
+    _index_count_ = 1;
+    EXPECT_EQ(_index_[0], 100);
+}
+
+TEST_CASE(test_index_unchanged)
+{
+    EXPECT_EQ(_index_count_, 4, "every case starts from the state SUITE_SETUP built");
+    EXPECT_EQ(_index_[0], 0);
+}
+
+TEST_CASE(test_exit)
+{
+    EXPECT_EQ(_index_[3], 9);
+    exit(1);
+}
+
+TEST_CASE(test_after_exit)
+{
+    EXPECT_EQ(_index_count_, 4, "the exit only cost the process of the case before");
+}
+
+ISOLATED_SUITE(test_isolated_suite);
+
+TEST_SUITE(test_isolated_suite)
+{
+    test_change_index,
+    test_index_unchanged,
+    test_exit,
+    test_after_exit,
+    TEST_NULL
+};
+
+
+TEST_RUNNER(test_isolated)
+{
+    test_isolated_suite,
+    TEST_NULL
+};
@@ -0,0 +1,52 @@
+#include <zcut.h>
+
+/**
+ * test_thread_safe_suite
+ */
+TEST_CASE(test_thread_safe_passed)
+{
+    EXPECT_TRUE(true);
+}
+
+TEST_CASE(test_thread_safe_failed)
+{
+    EXPECT_EQ(0, 1, "run with `-t N' to execute cases on N threads");
+}
+
+TEST_CASE(test_thread_safe_str)
+{
+    EXPECT_STR_EQ("a", "a");
+}
+
+CASE_SETUP(test_thread_safe_suite)
+{
+    return true;
+}
+
+THREAD_SAFE_SUITE(test_thread_safe_suite);
+
+TEST_SUITE(test_thread_safe_suite)
+{
+    test_thread_safe_passed,
+    test_thread_safe_failed,
+    test_thread_safe_str,
+    TEST_NULL
+};
+
+
+/**
+ * test_serial_suite
+ */
+TEST_SUITE(test_serial_suite)
+{
+    test_thread_safe_passed,
+    TEST_NULL
+};
+
+
+TEST_RUNNER(test_parallel)
+{
+    test_thread_safe_suite,
+    test_serial_suite,
+    TEST_NULL
+};
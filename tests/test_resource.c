@@ -0,0 +1,144 @@
+#include <unistd.h>
+#include <zcut.h>
+
+/*
+ * The counters see the cases of other threads with `-t N' only, -j workers each count their own.
+ */
+static int _port_user_count_;
+static int _db_user_count_;
+static int _scratch_dir_user_count_;
+static int _gpu_user_count_;
+static volatile bool _is_gpu_exclusive_;
+
+static int hold_resource(int *user_count, int ms)
+{
+    int count = __sync_add_and_fetch(user_count, 1);
+    usleep(ms * 1000);
+    __sync_sub_and_fetch(user_count, 1);
+    return count;
+}
+
+static int use_resource(int *user_count)
+{
+    return hold_resource(user_count, 20);
+}
+
+/**
+ * test_resource_suite
+ */
+CASE_RESOURCES(test_port_first, RESOURCE("port"));
+TEST_CASE(test_port_first)
+{
+    EXPECT_EQ(use_resource(&_port_user_count_), 1, "run with `-t N' to run the cases at once");
+}
+
+CASE_RESOURCES(test_port_second, RESOURCE("port"));
+TEST_CASE(test_port_second)
+{
+    EXPECT_EQ(use_resource(&_port_user_count_), 1);
+}
+
+CASE_RESOURCES(test_db_first, RESOURCE("db", 2));
+TEST_CASE(test_db_first)
+{
+    EXPECT_LE(use_resource(&_db_user_count_), 2);
+}
+
+CASE_RESOURCES(test_db_second, RESOURCE("db", 2));
+TEST_CASE(test_db_second)
+{
+    EXPECT_LE(use_resource(&_db_user_count_), 2);
+}
+
+CASE_RESOURCES(test_db_and_port, RESOURCE("db", 2), RESOURCE("port"));
+TEST_CASE(test_db_and_port)
+{
+    EXPECT_LE(use_resource(&_db_user_count_), 2);
+    EXPECT_EQ(use_resource(&_port_user_count_), 1);
+}
+
+TEST_CASE(test_no_resource)
+{
+    EXPECT_TRUE(true, "a case without resources is never held back");
+}
+
+THREAD_SAFE_SUITE(test_resource_suite);
+
+TEST_SUITE(test_resource_suite)
+{
+    test_port_first,
+    test_port_second,
+    test_db_first,
+    test_db_second,
+    test_db_and_port,
+    test_no_resource,
+    TEST_NULL
+};
+
+
+/**
+ * test_suite_resource_suite
+ */
+TEST_CASE(test_scratch_dir_first)
+{
+    EXPECT_EQ(use_resource(&_scratch_dir_user_count_), 1);
+}
+
+TEST_CASE(test_scratch_dir_second)
+{
+    EXPECT_EQ(use_resource(&_scratch_dir_user_count_), 1);
+}
+
+THREAD_SAFE_SUITE(test_suite_resource_suite);
+SUITE_RESOURCES(test_suite_resource_suite, RESOURCE("scratch_dir"));
+
+TEST_SUITE(test_suite_resource_suite)
+{
+    test_scratch_dir_first,
+    test_scratch_dir_second,
+    TEST_NULL
+};
+
+
+/**
+ * test_capacity_suite
+ */
+CASE_RESOURCES(test_gpu_shared, RESOURCE("gpu", 2));
+TEST_CASE(test_gpu_shared)
+{
+    EXPECT_FALSE(_is_gpu_exclusive_, "a case sharing the resource must not join its exclusive holder");
+    EXPECT_LE(use_resource(&_gpu_user_count_), 2);
+}
+
+TEST_CASE(test_no_gpu)
+{
+    usleep(40 * 1000);
+    EXPECT_TRUE(true, "with `-t 2' test_gpu_shared is stolen while test_gpu_exclusive runs");
+}
+
+CASE_RESOURCES(test_gpu_exclusive, RESOURCE("gpu"));
+TEST_CASE(test_gpu_exclusive)
+{
+    _is_gpu_exclusive_ = true;
+    EXPECT_EQ(hold_resource(&_gpu_user_count_, 100), 1);
+    _is_gpu_exclusive_ = false;
+}
+
+THREAD_SAFE_SUITE(test_capacity_suite);
+
+TEST_SUITE(test_capacity_suite)
+{
+    test_gpu_shared,
+    test_no_gpu,
+    test_gpu_exclusive,
+    TEST_NULL
+};
+
+
+TEST_RUNNER(test_resource)
+{
+    test_resource_suite,
+    test_suite_resource_suite,
+    test_capacity_suite,
+    TEST_NULL
+};
@@ -0,0 +1,50 @@
+#include <unistd.h>
+#include <zcut.h>
+
+/**
+ * test_timeout_suite
+ */
+CASE_TIMEOUT(test_within_timeout, 1000);
+TEST_CASE(test_within_timeout)
+{
+    usleep(10 * 1000);
+    EXPECT_TRUE(true);
+}
+
+/* Stuck with the lock of stdout held, as in a printf() into a full pipe: the timeout is reported all the same. */
+CASE_TIMEOUT(test_timed_out_printing, 100);
+TEST_CASE(test_timed_out_printing)
+{
+    flockfile(stdout);
+    printf("waiting for the reply");
+    usleep(500 * 1000);
+    funlockfile(stdout);
+}
+
+TEST_CASE(test_after_timeout)
+{
+    EXPECT_TRUE(true);
+}
+
+CASE_TIMEOUT(test_timed_out, 100);
+TEST_CASE(test_timed_out)
+{
+    EXPECT_TRUE(true, "run with `-j N' to go on with the next case after the timeout");
+    usleep(500 * 1000);
+}
+
+TEST_SUITE(test_timeout_suite)
+{
+    test_within_timeout,
+    test_timed_out_printing,
+    test_after_timeout,
+    test_timed_out,
+    TEST_NULL
+};
+
+
+TEST_RUNNER(test_timeout)
+{
+    test_timeout_suite,
+    TEST_NULL
+};